@@ -6,6 +6,7 @@
 #include <QDebug>
 
 #include <src/libslic3r/Geometry.hpp>
+#include <src/libslic3r/IslandIndex.hpp>
 
 
 /*
@@ -288,8 +289,7 @@ void GCodeExporter::CalWipingPoints() {
 	if (printconfig_.ooze_prevention && print_->extruders().size() > 1) {
 		Points skirt_points;
 		for (auto entity : print_->skirt.entities) {
-			auto loop = dynamic_cast<ExtrusionLoop*>(entity);
-			for (auto point : loop->as_polyline().points) {
+			for (auto point : entity->as_polyline().points) {
 				skirt_points.push_back(point);
 			}
 		}
@@ -652,13 +652,16 @@ void GCodeExporter::ProcessLayer(Layer* layer, Points& copies, std::ofstream& fo
 		//<extruder_id, [island0, island1,island2...]>: ÿextruderӦislands
 		std::unordered_map<int, islands> by_extruder;
 		
-		//layer_slicesbounding-box
-		std::vector<BoundingBox> layer_slices_bb;
-		for (auto expolygon: layer->slices.expolygons) {
-			layer_slices_bb.push_back(expolygon.contour.bounding_box());
-		}
+		//layer_slicesĿռڲҰentityisland
+		IslandIndex slices_index(layer->slices.expolygons);
 
 		int slices_count = layer->slices.count() - 1;
+		//entityisland: һfirst pointslice
+		//ʱһislandòûsliceʱ-1
+		auto island_of = [&](const Point& point) {
+			int i = slices_index.find(point);
+			return (i < 0) ? slices_count : i;
+		};
 		for (int region_id = 0; region_id < print_->regions.size(); region_id++) {
 			if(region_id >= layer->regions.size())	continue;
 			LayerRegion* layer_region = layer->regions[region_id];
@@ -673,27 +676,20 @@ void GCodeExporter::ProcessLayer(Layer* layer, Points& copies, std::ofstream& fo
 					by_extruder[extruder_id].resize(slices_count + 1);
 				}
 				for (auto* perimeter_coll : layer_region->perimeters.entities) {
-					if (const ExtrusionLoop* loop = dynamic_cast<ExtrusionLoop*>(perimeter_coll)) {
-						for (int i = 0; i <= slices_count; i++) {
-							if (i == slices_count ||
-								(layer_slices_bb[i].contains(loop->first_point())
-									&& layer->slices.expolygons[i].contour.contains(loop->first_point()))) {
-								by_extruder[extruder_id][i]["perimeter"][region_id].append(*loop);
-								break;
-							}
+					if (perimeter_coll->is_loop()) {
+						const ExtrusionLoop* loop = static_cast<const ExtrusionLoop*>(perimeter_coll);
+						int i = island_of(loop->first_point());
+						if (i >= 0) {
+							by_extruder[extruder_id][i]["perimeter"][region_id].append(*loop);
 						}
 					}
 					else {
-						ExtrusionEntityCollection* perimeter_collection = dynamic_cast<ExtrusionEntityCollection*>(perimeter_coll);
+						ExtrusionEntityCollection* perimeter_collection = static_cast<ExtrusionEntityCollection*>(perimeter_coll);
 						if (perimeter_collection->empty())
 							continue;
-						for (int i = 0; i <= slices_count; i++) {
-							if (i == slices_count ||
-								(layer_slices_bb[i].contains(perimeter_collection->first_point())
-									&& layer->slices.expolygons[i].contour.contains(perimeter_collection->first_point()))) {
-								by_extruder[extruder_id][i]["perimeter"][region_id].append(*perimeter_collection);
-								break;
-							}
+						int i = island_of(perimeter_collection->first_point());
+						if (i >= 0) {
+							by_extruder[extruder_id][i]["perimeter"][region_id].append(*perimeter_collection);
 						}
 					}
 				}
@@ -704,12 +700,13 @@ void GCodeExporter::ProcessLayer(Layer* layer, Points& copies, std::ofstream& fo
 			//üеÿһһinfill surface
 			for (ExtrusionEntity* entity : layer_region->fills.entities) {
 				bool is_solid_infill = false;
-				ExtrusionEntityCollection* entity_collection = dynamic_cast<ExtrusionEntityCollection*>(entity);
-				if (const ExtrusionPath* infill_path = dynamic_cast<ExtrusionPath*>(entity_collection->entities[0])) {
-					is_solid_infill = infill_path->is_solid_infill();
+				ExtrusionEntityCollection* entity_collection = static_cast<ExtrusionEntityCollection*>(entity);
+				const ExtrusionEntity* first_entity = entity_collection->entities[0];
+				if (first_entity->is_loop()) {
+					is_solid_infill = static_cast<const ExtrusionLoop*>(first_entity)->is_solid_infill();
 				}
-				else if (const ExtrusionLoop* infill_loop = dynamic_cast<ExtrusionLoop*>(entity_collection->entities[0])) {
-					is_solid_infill = infill_loop->is_solid_infill();
+				else if (!first_entity->is_collection()) {
+					is_solid_infill = static_cast<const ExtrusionPath*>(first_entity)->is_solid_infill();
 				}
 				int extruder_id = is_solid_infill ?
 					print_region->config.solid_infill_extruder - 1 :
@@ -717,13 +714,9 @@ void GCodeExporter::ProcessLayer(Layer* layer, Points& copies, std::ofstream& fo
 				if (by_extruder[extruder_id].empty()) {
 					by_extruder[extruder_id].resize(slices_count + 1);
 				}
-				for (int i = 0; i <= slices_count; i++) {
-					if (i == slices_count ||
-						(layer_slices_bb[i].contains(entity_collection->first_point())
-							&& layer->slices.expolygons[i].contour.contains(entity_collection->first_point()))) {
-						by_extruder[extruder_id][i]["infill"][region_id].append(*entity_collection);
-						break;
-					}
+				int i = island_of(entity_collection->first_point());
+				if (i >= 0) {
+					by_extruder[extruder_id][i]["infill"][region_id].append(*entity_collection);
 				}
 			}
 		}
@@ -891,8 +884,7 @@ std::string GCodeExporter::ExtrudeBrim(Layer* layer) {
 		gcodegen_.set_origin(Pointf(0, 0));
 		gcodegen_.avoid_crossing_perimeters.use_external_mp = true;
 		for (auto brim_entity : print_->brim.entities) {
-			ExtrusionLoop* path = dynamic_cast<ExtrusionLoop*>(brim_entity);
-			gcode += gcodegen_.extrude(*path, "brim", object->config.support_material_speed);
+			gcode += gcodegen_.extrude(*brim_entity, "brim", object->config.support_material_speed);
 		}
 
 		brim_done_ = true;
@@ -939,7 +931,7 @@ std::string GCodeExporter::ExtrudeSkirt(Layer* layer) {
 				Flow layer_skirt_flow = skirt_flow;
 				layer_skirt_flow.height = layer->height;
 				double mm3_per_mm = layer_skirt_flow.mm3_per_mm();
-				ExtrusionLoop* casted_loop = dynamic_cast<ExtrusionLoop*>(loop);
+				ExtrusionLoop* casted_loop = static_cast<ExtrusionLoop*>(loop);
 				for (auto& path : casted_loop->paths) {
 					path.height = layer->height;
 					path.mm3_per_mm = mm3_per_mm;
@@ -972,7 +964,7 @@ std::string GCodeExporter::ExtrudeSupportMaterial(SupportLayer* support_layer) {
 		support_layer->support_interface_fills.chained_path_from(gcodegen_.last_pos(), entity_collection.get(), 0);
 
 		for (auto entity : entity_collection->entities) {
-			ExtrusionPath* path = dynamic_cast<ExtrusionPath*>(entity);
+			ExtrusionPath* path = static_cast<ExtrusionPath*>(entity);
 			gcode += gcodegen_.extrude_path(*path, "support material interface",
 				object->config.get_abs_value("support_material_interface_speed"));
 		}
@@ -988,7 +980,7 @@ std::string GCodeExporter::ExtrudeSupportMaterial(SupportLayer* support_layer) {
 		support_layer->support_fills.chained_path_from(gcodegen_.last_pos(), entity_collection.get(), 0);
 
 		for (auto entity : entity_collection->entities) {
-			ExtrusionPath* path = dynamic_cast<ExtrusionPath*>(entity);
+			ExtrusionPath* path = static_cast<ExtrusionPath*>(entity);
 			gcode += gcodegen_.extrude_path(*path, "support material",
 				object->config.get_abs_value("support_material_speed"));
 		}
@@ -1014,18 +1006,15 @@ std::string GCodeExporter::ExtrudePerimeters(std::unordered_map<int, ExtrusionEn
 // 			gcode += gcodegen_.extrude(*entity, "perimeter", -1);
 // 		}
 		for (ExtrusionEntity* entity : entity_collection.entities) {
-			if (const ExtrusionPath* path = dynamic_cast<ExtrusionPath*>(entity)) {
-				gcode += gcodegen_.extrude(*path, "perimeter", -1);
-			}
-			else if (const ExtrusionLoop* loop = dynamic_cast<ExtrusionLoop*>(entity)) {
-				gcode += gcodegen_.extrude(*loop, "perimeter", -1);
-			}
-			else {
-				ExtrusionEntityCollection* casted_collection = dynamic_cast<ExtrusionEntityCollection*>(entity);
+			if (entity->is_collection()) {
+				ExtrusionEntityCollection* casted_collection = static_cast<ExtrusionEntityCollection*>(entity);
 				for (ExtrusionEntity* casted_entity : casted_collection->entities) {
 					gcode += gcodegen_.extrude(*casted_entity, "perimeter", -1);
 				}
 			}
+			else {
+				gcode += gcodegen_.extrude(*entity, "perimeter", -1);
+			}
 		}
 	}
 	return gcode;
@@ -1048,20 +1037,17 @@ std::string GCodeExporter::ExtrudeInfills(std::unordered_map<int, ExtrusionEntit
 		ExtrusionEntityCollection* chained_collection = new ExtrusionEntityCollection;
 		infill_collection.chained_path_from(gcodegen_.last_pos(), chained_collection, 0);
 		for (ExtrusionEntity* entity : chained_collection->entities) {
-			if (const ExtrusionPath* path = dynamic_cast<ExtrusionPath*>(entity)) {
-				gcode += gcodegen_.extrude(*path, "infill", -1);
-			}
-			else if (const ExtrusionLoop* loop = dynamic_cast<ExtrusionLoop*>(entity)) {
-				gcode += gcodegen_.extrude(*loop, "infill", -1);
-			}
-			else {
+			if (entity->is_collection()) {
 				ExtrusionEntityCollection* further_chained_collection = new ExtrusionEntityCollection;
-				ExtrusionEntityCollection* entity_collection = dynamic_cast<ExtrusionEntityCollection*>(entity);
+				ExtrusionEntityCollection* entity_collection = static_cast<ExtrusionEntityCollection*>(entity);
 				entity_collection->chained_path_from(gcodegen_.last_pos(), further_chained_collection, 0);
 				for (ExtrusionEntity* path : further_chained_collection->entities) {
 					gcode += gcodegen_.extrude(*path, "infill", -1);
 				}
 			}
+			else {
+				gcode += gcodegen_.extrude(*entity, "infill", -1);
+			}
 		}
 		//delete chained_collection;
 	}
@@ -32,7 +32,7 @@
 HippoPrinter::HippoPrinter(QWidget *parent)
 	: QMainWindow(parent),
 	need_arrange_(false),force_autocenter_(true),
-	processed_(false)
+	processed_(false), process_id_(0)
 {
 	print_ = new Print();
 	model_ = new Model();
@@ -60,7 +60,11 @@ HippoPrinter::HippoPrinter(QWidget *parent)
 	process_progressbar_->setRange(0, 100);
 	process_progressbar_->setValue(0);
 	statusbar_->addPermanentWidget(process_progressbar_);
-	print_->SetStatusBar(statusbar_,process_progressbar_);
+
+	//ȿں̨߳и£ͨźתGUI߳
+	print_->SetStatusCallback([this](int percentage, const std::string& status) {
+		emit ProcessStatusChanged(percentage, QString::fromStdString(status));
+	});
 
 	if (!isMaximized()) {
 		showMaximized();
@@ -70,6 +74,11 @@ HippoPrinter::HippoPrinter(QWidget *parent)
 }
 
 
+HippoPrinter::~HippoPrinter() {
+	CancelProcess();
+}
+
+
 void HippoPrinter::InitActions() {
 
 	/*ļ˵µĲ*/
@@ -279,6 +288,13 @@ void HippoPrinter::InitConnections() {
 
 	connect(save_GCode_action_, &QAction::triggered, this, &HippoPrinter::ExportGCode);
 
+	//̨ĽȺź
+	connect(this, &HippoPrinter::ProcessStatusChanged, this, &HippoPrinter::UpdateProcessStatus, Qt::QueuedConnection);
+	connect(this, &HippoPrinter::ProcessFinished, this, &HippoPrinter::OnProcessFinished, Qt::QueuedConnection);
+
+	//ӡı
+	connect(print_config_widget_, &PrintConfigWidget::ConfigChanged, this, &HippoPrinter::OnConfigChanged);
+
 	//лTabҳ
 	connect(central_tabwidget_, &QTabWidget::currentChanged, this, &HippoPrinter::SwitchTab);
 
@@ -309,7 +325,7 @@ void HippoPrinter::SwitchTab() {
 	int current_tab_index = central_tabwidget_->currentIndex();
 
 	if (current_tab_index == 1) {
-		if (!processed_) {
+		if (!processed_ && !process_thread_.joinable()) {
 			StartProcess();
 		}
 		else {
@@ -335,6 +351,9 @@ void HippoPrinter::SwitchTab() {
 
 
 void HippoPrinter::LoadFile(char* file_name) {
+	//޸ModelPrint֮ǰҪֹ̨ͣ
+	CancelProcess();
+
 	Pointf bed_center = bed_shape_.center();
 	Pointf bed_size = bed_shape_.size();
 
@@ -422,15 +441,124 @@ void HippoPrinter::PrintProcess() {
 *	ʼд
 */
 void HippoPrinter::StartProcess() {
+	//ȡڽеĴֻ̨̣֤һ߳ڷPrint
+	CancelProcess();
+
 	print_->apply_config(dynamic_config_);
 	if (model_->objects.empty()) {
+		export_file_.clear();
 		OnProcessCompleted();
 		return;
 	}
-	print_->Process();
 
-	OnProcessCompleted();
-	qDebug() << "finished";
+	//нֹԤؼPrint󣬺̨̻߳ɾؽеLayer
+	toolpath_3d_slider_->setEnabled(false);
+	toolpath_2d_slider_->setEnabled(false);
+	toolpath_plane_widget_->SetProcessing(true);
+
+	//ȴGCodeļڱδɺɺ̵̨߳
+	exporting_file_ = export_file_;
+	export_file_.clear();
+	std::string export_file = exporting_file_.toLatin1().data();
+
+	int process_id = ++process_id_;
+	process_thread_ = std::thread([this, process_id, export_file]() mutable {
+		bool completed = true;
+		try {
+			print_->Process();
+			if (!export_file.empty())
+				print_->ExportGCode(&export_file[0]);
+		}
+		catch (CanceledException&) {
+			completed = false;
+		}
+		emit ProcessFinished(process_id, completed);
+	});
+}
+
+
+/*
+ *	ȡ̨̣߳ȴһȡ˳
+ */
+void HippoPrinter::CancelProcess() {
+	if (process_thread_.joinable()) {
+		print_->Cancel();
+		process_thread_.join();
+		toolpath_plane_widget_->SetProcessing(false);
+
+		//ȡĴ̼ȴGCodeٽ
+		if (!exporting_file_.isEmpty() || !export_file_.isEmpty()) {
+			exporting_file_.clear();
+			export_file_.clear();
+			statusbar_->showMessage(QString::fromLocal8Bit("GCodeȡ"));
+		}
+	}
+	print_->ResetCancel();
+}
+
+
+/*
+ *	״̬ͽGUI߳е
+ */
+void HippoPrinter::UpdateProcessStatus(int percentage, QString status) {
+	process_progressbar_->setValue(percentage);
+	statusbar_->showMessage(status);
+}
+
+
+/*
+ *	̨߳̽
+ */
+void HippoPrinter::OnProcessFinished(int process_id, bool completed) {
+	//ѾȡȴĴ
+	if (process_id != process_id_) return;
+
+	if (process_thread_.joinable()) {
+		process_thread_.join();
+	}
+	toolpath_plane_widget_->SetProcessing(false);
+
+	toolpath_3d_slider_->setEnabled(true);
+	toolpath_2d_slider_->setEnabled(true);
+
+	QString exported_file = exporting_file_;
+	exporting_file_.clear();
+
+	if (completed) {
+		OnProcessCompleted();
+		qDebug() << "finished";
+
+		if (!exported_file.isEmpty()) {
+			QMessageBox::information(this,
+				QString::fromLocal8Bit("ʾ"),
+				QString::fromLocal8Bit("GCodeļɹ"));
+		}
+	}
+
+	//GCodeΪĴ̽
+	if (!export_file_.isEmpty()) {
+		StartProcess();
+	}
+}
+
+
+/*
+ *	ӡı䣬ڽеĴѾʱҪȡ
+ */
+void HippoPrinter::OnConfigChanged() {
+	if (process_thread_.joinable()) {
+		CancelProcess();
+		toolpath_3d_slider_->setEnabled(true);
+		toolpath_2d_slider_->setEnabled(true);
+		process_progressbar_->setValue(0);
+		statusbar_->showMessage("Processing canceled");
+	}
+	processed_ = false;
+
+	//Ԥӡ·ʹµĲ
+	if (central_tabwidget_->currentIndex() == 1) {
+		StartProcess();
+	}
 }
 
 
@@ -485,10 +613,11 @@ void HippoPrinter::OnProcessCompleted() {
 	//toolpath_3d_slider_->setMaximum(toolpath_preview_widget_->layer_values_.size());
 	toolpath_3d_slider_->setValue(toolpath_3d_slider_->maximum());
 
-	//toolpath_plane_widget_->ReloadVolumes();
+	toolpath_plane_widget_->ReloadVolumes();
 	toolpath_2d_slider_->setMaximum(layer_values_.size());
 	toolpath_2d_slider_->setValue(toolpath_2d_slider_->maximum());
-	toolpath_plane_widget_->update();
+	//SliderֵûиıʱᷢźţѡǰĴӡ·
+	toolpath_plane_widget_->SetLayerZ(toolpath_2d_slider_->value());
 }
 
 
@@ -497,11 +626,13 @@ void HippoPrinter::ExportGCode() {
 		QString::fromLocal8Bit("GCodeļ"),
 		"",
 		"*.gcode");
-	if (!file_name.isNull()) {
-		print_->apply_config(dynamic_config_);
-		print_->ExportGCode(file_name.toLatin1().data());
-		QMessageBox::information(this, 
-			QString::fromLocal8Bit("ʾ"),
-			QString::fromLocal8Bit("GCodeļɹ"));
+	if (file_name.isNull()) return;
+
+	//GCodeں̨߳ɺ͵ڽеĴ̲ȡɺٵ
+	export_file_ = file_name;
+	if (process_thread_.joinable()) {
+		statusbar_->showMessage(QString::fromLocal8Bit("ɺ󵼳GCode"));
+		return;
 	}
+	StartProcess();
 }
\ No newline at end of file
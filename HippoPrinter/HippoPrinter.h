@@ -5,6 +5,7 @@
 #include <QtWidgets/QMainWindow>
 #include <QStatusBar>
 #include <QProgressBar>
+#include <thread>
 //#include "ui_mainwindow.h"
 
 
@@ -37,6 +38,7 @@ class HippoPrinter : public QMainWindow
 
 public:
 	HippoPrinter(QWidget *parent = Q_NULLPTR);
+	~HippoPrinter();
 
 
 	//Ui::MainWindowClass ui;
@@ -113,10 +115,21 @@ private:
 	QScrollArea* config_scrollarea_;
 
 		
+signals:
+	//̷̨߳ĴȺźţQueuedConnectionķʽGUI߳д
+	void ProcessStatusChanged(int percentage, QString status);
+	void ProcessFinished(int process_id, bool completed);
+
 private slots:
 	void StartProcess();
 	void ExportGCode();
 
+	void UpdateProcessStatus(int percentage, QString status);
+	void OnProcessFinished(int process_id, bool completed);
+
+	//ӡı䣬ȡڽеĴ
+	void OnConfigChanged();
+
 private:
 	void LoadFile(char* file_name);
 
@@ -137,6 +150,9 @@ private:
 
 	void PrintProcess();
 
+	//ȡȴ̨߳̽
+	void CancelProcess();
+
 
 private:
 	Model* model_;		//Model
@@ -150,6 +166,11 @@ private:
 
 	bool processed_;		//ǷѾɴӡ·
 
+	std::thread process_thread_;	//ɴӡ·ĺ̨߳
+	int process_id_;		//ǰ̨ıţںȡĴ̷ź
+	QString export_file_;		//ȴGCodeļһδɺ󵼳
+	QString exporting_file_;	//ǰ̨ɺ󵼳GCodeļ
+
 	//<layer_id, print_z>ÿһӦprint_z
 	std::map<int, double> layer_values_;		
 
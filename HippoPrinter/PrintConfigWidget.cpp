@@ -23,6 +23,20 @@ PrintConfigWidget::PrintConfigWidget(DynamicPrintConfig* config, QWidget * paren
 
 	InitMainLayout();
 
+	//ڸؼ޸config_֪֮ͨӡѾı
+	for (QSpinBox* spinbox : findChildren<QSpinBox*>()) {
+		connect(spinbox, static_cast<void(QSpinBox::*)(int)>(&QSpinBox::valueChanged),
+			this, &PrintConfigWidget::ConfigChanged);
+	}
+	for (QDoubleSpinBox* spinbox : findChildren<QDoubleSpinBox*>()) {
+		connect(spinbox, static_cast<void(QDoubleSpinBox::*)(double)>(&QDoubleSpinBox::valueChanged),
+			this, &PrintConfigWidget::ConfigChanged);
+	}
+	for (QComboBox* combobox : findChildren<QComboBox*>()) {
+		connect(combobox, static_cast<void(QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+			this, &PrintConfigWidget::ConfigChanged);
+	}
+
 	setStyleSheet(
 		"QGroupBox{font:14pt \"΢ź\"; background:rgba(197,197,197,75%); padding:5px;margin:0px;min-width:10px;}"
 		"QWidget{font:11pt \"΢ź\";}"
@@ -123,6 +137,19 @@ void PrintConfigWidget::InitGeneralSettting() {
 	});
 
 
+	///Ӧߵؿؼģͱб̶ԶĲ
+	QLabel* adaptive_slicing_label = new QLabel(QString::fromLocal8Bit("Ӧ:"));
+	QComboBox* adaptive_slicing_combobox = new QComboBox();
+	adaptive_slicing_combobox->addItem(QString::fromLocal8Bit(""));
+	adaptive_slicing_combobox->addItem(QString::fromLocal8Bit(""));
+	adaptive_slicing_combobox->setCurrentIndex(1);	//Ĭֵ
+	config_->optptr("adaptive_slicing", true)->set(*(config_->def->get("adaptive_slicing")->default_value));
+	connect(adaptive_slicing_combobox, static_cast<void(QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+		[=](int index) {
+		config_->option("adaptive_slicing")->set(ConfigOptionBool(index == 0));
+	});
+
+
 	///ǲؿؼ
 	QLabel* perimeters_label = new QLabel(QString::fromLocal8Bit("ǲ:"));
 	QSpinBox* perimeter_spinbox = new QSpinBox();
@@ -185,11 +212,13 @@ void PrintConfigWidget::InitGeneralSettting() {
 	general_config_layout->addWidget(layer_height_spinbox, 0, 1);
 	general_config_layout->addWidget(first_layer_height_label, 1, 0);
 	general_config_layout->addWidget(first_layer_height_spinbox, 1, 1);
-	general_config_layout->addWidget(perimeters_label, 2, 0);
-	general_config_layout->addWidget(perimeter_spinbox, 2, 1);
-	general_config_layout->addWidget(solid_layer_label, 3, 0);
-	general_config_layout->addWidget(top_solid_spinbox, 3, 1);
-	general_config_layout->addWidget(bottom_solid_spinbox, 4, 1);
+	general_config_layout->addWidget(adaptive_slicing_label, 2, 0);
+	general_config_layout->addWidget(adaptive_slicing_combobox, 2, 1);
+	general_config_layout->addWidget(perimeters_label, 3, 0);
+	general_config_layout->addWidget(perimeter_spinbox, 3, 1);
+	general_config_layout->addWidget(solid_layer_label, 4, 0);
+	general_config_layout->addWidget(top_solid_spinbox, 4, 1);
+	general_config_layout->addWidget(bottom_solid_spinbox, 5, 1);
 	
 	//ò
 	general_groupbox_->setLayout(general_config_layout);
@@ -455,6 +484,7 @@ void PrintConfigWidget::InitSupportSetting() {
 	support_pattern_combobox_->addItem(QString::fromLocal8Bit("reclinear grid"));
 	support_pattern_combobox_->addItem(QString::fromLocal8Bit("honeycomb"));
 	support_pattern_combobox_->addItem(QString::fromLocal8Bit("pillars"));
+	support_pattern_combobox_->addItem(QString::fromLocal8Bit("tree"));
 	support_pattern_combobox_->setCurrentIndex(3);
 	config_->optptr("support_material_pattern", true)->set(*(config_->def->get("support_material_pattern")->default_value));
 	connect(support_pattern_combobox_, static_cast<void(QComboBox::*)(int)>(&QComboBox::currentIndexChanged), 
@@ -469,6 +499,9 @@ void PrintConfigWidget::InitSupportSetting() {
 		case 2:
 			config_->option("support_material_pattern")->set(ConfigOptionEnum<SupportMaterialPattern>(smpHoneycomb));
 			break;
+		case 4:
+			config_->option("support_material_pattern")->set(ConfigOptionEnum<SupportMaterialPattern>(smpTree));
+			break;
 		default:
 			config_->option("support_material_pattern")->set(ConfigOptionEnum<SupportMaterialPattern>(smpPillars));
 			break;
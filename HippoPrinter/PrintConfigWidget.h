@@ -36,6 +36,10 @@ public:
 
 	
 
+signals:
+	//һӡı
+	void ConfigChanged();
+
 private slots:
 	void ValidateSupport(int valid);
 	void ChangeBedShape();
@@ -11,7 +11,7 @@
 #include <src/libslic3r/ExPolygonCollection.hpp>
 ToolpathPlaneWidget::ToolpathPlaneWidget(Slic3r::Print* print,
 	std::map<int,double>* layer_values,QGLWidget* parent)
-	:QGLWidget(parent),scale_(1),offset_(0,0),old_pos_(0,0),left_pressed_(false)
+	:QGLWidget(parent),scale_(1),offset_(0,0),old_pos_(0,0),left_pressed_(false),processing_(false)
 	{
 	layer_values_ = layer_values;
 	print_ = print;
@@ -61,12 +61,13 @@ void ToolpathPlaneWidget::paintGL() {
 	glEnable(GL_LIGHTING);
 	DrawBedShape();
 
-	if (layers_.empty())	return;
+	if (processing_ || layers_.empty())	return;
 
 	//glEnable(GL_LIGHTING);
 	BoundingBox bb;
 	// draw slice contour
-	for (Layer* layer : layers_) {
+	for (const LayerToolpaths* toolpaths : layers_) {
+		Layer* layer = toolpaths->layer;
 		if(abs(layer->print_z - offset_z_ ) < EPSILON)
 			continue;
 
@@ -95,22 +96,22 @@ void ToolpathPlaneWidget::paintGL() {
 	}
 
 
-	for (Layer* layer : layers_) {
-		PrintObject* print_object = layer->object();
-		double print_z = layer->print_z;
+	for (const LayerToolpaths* toolpaths : layers_) {
+		PrintObject* print_object = toolpaths->layer->object();
+		double print_z = toolpaths->layer->print_z;
 
 		
-		for (LayerRegion* region : layer->regions) {
+		for (size_t region_id = 0; region_id < toolpaths->layer->regions.size(); region_id++) {
 			//draw perimeters
 			if (print_object->state.is_done(posPerimeters)) {
 				glColor3f(0.7, 0, 0);
-				DrawEntity(region->perimeters, print_z, print_object);
+				DrawEntity(toolpaths->perimeters[region_id], print_z, print_object);
 			}
 
 			//draw infills
 			if (print_object->state.is_done(posInfill)) {
 				glColor3f(0, 0, 0.7);
-				DrawEntity(region->fills, print_z, print_object);
+				DrawEntity(toolpaths->fills[region_id], print_z, print_object);
 			}
 		}
 	}
@@ -135,15 +136,58 @@ void ToolpathPlaneWidget::resizeGL(int w, int h) {
 	ZoomToBed();
 }
 
+/*
+ *	½PrintObjectlayersprint_zչÿһĴӡ·
+ *	ػʱֱʹչĴӡ·ٱExtrusionEntity
+ */
 void ToolpathPlaneWidget::ReloadVolumes() {
+	layers_.clear();
+	layers_z_.clear();
+	toolpaths_.clear();
+	for (PrintObject* object : print_->objects) {
+		LayerIntervals layers_z;
+		std::vector<LayerToolpaths> object_toolpaths(object->layers.size());
+		for (size_t layer_id = 0; layer_id < object->layers.size(); layer_id++) {
+			Layer* layer = object->layers[layer_id];
+			layers_z.append(layer->print_z, layer->print_z);
+
+			LayerToolpaths& toolpaths = object_toolpaths[layer_id];
+			toolpaths.layer = layer;
+			toolpaths.perimeters.resize(layer->regions.size());
+			toolpaths.fills.resize(layer->regions.size());
+			for (size_t region_id = 0; region_id < layer->regions.size(); region_id++) {
+				if (object->state.is_done(posPerimeters)) {
+					toolpaths.perimeters[region_id].append(layer->regions[region_id]->perimeters);
+				}
+				if (object->state.is_done(posInfill)) {
+					toolpaths.fills[region_id].append(layer->regions[region_id]->fills);
+				}
+			}
+		}
+		layers_z_.push_back(layers_z);
+		toolpaths_.push_back(std::move(object_toolpaths));
+	}
+}
+
 
+/*
+ *	̨̻߳ɾؽLayerڼlayers_print_zҲٻƴӡ·
+ */
+void ToolpathPlaneWidget::SetProcessing(bool processing) {
+	processing_ = processing;
+	if (processing_) {
+		layers_.clear();
+		layers_z_.clear();
+		toolpaths_.clear();
+	}
+	update();
 }
 
 
 void ToolpathPlaneWidget::SetLayerZ(int layer_z) {
-	double offset_z = (*layer_values_)[layer_z];
+	if (processing_)	return;
 
-	layers_.clear();
+	double offset_z = (*layer_values_)[layer_z];
 
 	double max_layer_height = print_->max_allowed_layer_height();
 
@@ -165,20 +209,28 @@ void ToolpathPlaneWidget::SetLayerZ(int layer_z) {
 
 	bool interlaced = has_support_material || infill_every_layer;
 
+	//objectlayer仯ʱ½print_z
+	bool reload = (layers_z_.size() != print_->objects.size());
+	for (size_t i = 0; !reload && i < print_->objects.size(); i++) {
+		reload = (layers_z_[i].size() != print_->objects[i]->layers.size());
+	}
+	if (reload) {
+		ReloadVolumes();
+	}
+	layers_.clear();
+
 	//Ҫsupport material
-	for (PrintObject* object : print_->objects) {
-		for (Layer* layer : object->layers) {
-			if (interlaced) {
-				if (offset_z > (layer->print_z - max_layer_height - EPSILON) &&
-					(offset_z <= (layer->print_z + EPSILON)) ){
-					layers_.push_back(layer);
-				}
-			}
-			else {
-				if (abs(layer->print_z - offset_z) < EPSILON) {
-					layers_.push_back(layer);
-				}
-			}
+	for (size_t i = 0; i < print_->objects.size(); i++) {
+		PrintObject* object = print_->objects[i];
+		std::vector<int> layer_ids;
+		if (interlaced) {
+			layer_ids = layers_z_[i].overlapping(offset_z - EPSILON, offset_z + max_layer_height + EPSILON);
+		}
+		else {
+			layer_ids = layers_z_[i].overlapping(offset_z - EPSILON, offset_z + EPSILON);
+		}
+		for (int layer_id : layer_ids) {
+			layers_.push_back(&toolpaths_[i][layer_id]);
 		}
 	}
 
@@ -191,37 +243,22 @@ void ToolpathPlaneWidget::SetLayerZ(int layer_z) {
 
 
 /*
- *	ƴӡ·ΪExtrusionEntityCollection, ExtrusionPath, ExtrusionLoop
+ *	չĴӡ·еpath
  */
-void ToolpathPlaneWidget::DrawEntity(ExtrusionEntity& entity, double print_z,
+void ToolpathPlaneWidget::DrawEntity(const FlatExtrusions& flat, double print_z,
 	PrintObject* print_object) {
-	if (typeid(entity) == typeid(ExtrusionEntityCollection)) {
-		ExtrusionEntityCollection& entity_collection = 
-			dynamic_cast<ExtrusionEntityCollection&>(entity);
-		for (ExtrusionEntity* temp_entity : entity_collection.entities) {
-			DrawEntity(*temp_entity, print_z, print_object);
-		}
-		return;
-	}
-	else if (typeid(entity) == typeid(ExtrusionPath)) {
-		ExtrusionPath& temp_path = dynamic_cast<ExtrusionPath&>(entity);
-		DrawPath(temp_path, print_z, print_object);
-	}
-	else {
-		ExtrusionLoop& loop = dynamic_cast<ExtrusionLoop&>(entity);
-		for (ExtrusionPath& path : loop.paths) {
-			DrawPath(path, print_z, print_object);
-		}
+	for (size_t path = 0; path < flat.paths_count(); ++path) {
+		DrawPath(flat.path_begin(path), flat.path_end(path), print_z, print_object);
 	}
 	glFlush();
 }
 
 
 /*
- *	Polyline,·
+ *	[begin, end)Χڵĵɵ·
  */
-void ToolpathPlaneWidget::DrawPath(ExtrusionPath& path, double print_z, 
-	PrintObject* print_object) {
+void ToolpathPlaneWidget::DrawPath(Points::const_iterator begin, Points::const_iterator end,
+	double print_z, PrintObject* print_object) {
 
 	if (abs(print_z - offset_z_) >= EPSILON) {
 		glColor3f(0.8, 0.8, 0.8);
@@ -229,27 +266,27 @@ void ToolpathPlaneWidget::DrawPath(ExtrusionPath& path, double print_z,
 
 	glLineWidth(1);
 
+	if (begin == end)	return;
+
 	if (print_object != nullptr) {
 		for (auto& copy : print_object->_shifted_copies) {
 			glPushMatrix();
 			glTranslated(unscale(copy.x),unscale(copy.y), 0);
 
-			Lines lines = path.polyline.lines();
 			glBegin(GL_LINES);
-			for (Line& line : lines) {
-				glVertex2d(unscale(line.a.x),unscale(line.a.y));
-				glVertex2d(unscale(line.b.x),unscale(line.b.y));
+			for (Points::const_iterator point = begin + 1; point != end; ++point) {
+				glVertex2d(unscale((point - 1)->x),unscale((point - 1)->y));
+				glVertex2d(unscale(point->x),unscale(point->y));
 			}
 			glEnd();
 			glPopMatrix();
 		}
 	}
 	else {
-		Lines lines = path.polyline.lines();
 		glBegin(GL_LINES);
-		for (Line& line : lines) {
-			glVertex2d(unscale(line.a.x),unscale(line.a.y));
-			glVertex2d(unscale(line.b.x),unscale(line.b.y));
+		for (Points::const_iterator point = begin + 1; point != end; ++point) {
+			glVertex2d(unscale((point - 1)->x),unscale((point - 1)->y));
+			glVertex2d(unscale(point->x),unscale(point->y));
 		}
 		glEnd();
 
@@ -9,6 +9,7 @@
 
 
 #include <src/libslic3r/Print.hpp>
+#include <src/libslic3r/LayerIntervals.hpp>
 
 class ToolpathPlaneWidget:public QGLWidget
 {
@@ -21,8 +22,8 @@ private:
 	void initializeGL();
 	void paintGL();
 	void resizeGL(int w, int h);
-	void DrawEntity(ExtrusionEntity& entity,double print_z,PrintObject* print_object);
-	void DrawPath(ExtrusionPath& path,double print_z, PrintObject* print_object);
+	void DrawEntity(const FlatExtrusions& flat,double print_z,PrintObject* print_object);
+	void DrawPath(Points::const_iterator begin, Points::const_iterator end,double print_z, PrintObject* print_object);
 
 
 	void wheelEvent(QWheelEvent *event);
@@ -38,6 +39,9 @@ private:
 public:
 	void ReloadVolumes();
 
+	//̴̨߳Printڼ䲻еLayerʼʱѡLayer
+	void SetProcessing(bool processing);
+
 
 
 public slots:
@@ -52,7 +56,17 @@ private:
 
 	BoundingBoxf bed_shape_;	//Bounding Box
 	
-	LayerPtrs layers_;		//ؼʾ
+	//һLayerĴӡ·ÿregionperimetersfillsڴɺֻչһ
+	struct LayerToolpaths {
+		Layer* layer;
+		std::vector<FlatExtrusions> perimeters;
+		std::vector<FlatExtrusions> fills;
+	};
+
+	bool processing_;		//̨߳ǷڴPrint
+	std::vector<const LayerToolpaths*> layers_;		//ؼʾ
+	std::vector<LayerIntervals> layers_z_;	//PrintObjectlayersprint_z
+	std::vector<std::vector<LayerToolpaths>> toolpaths_;	//PrintObjectÿһĴӡ·
 	double offset_z_;		//Zƫֵ
 	std::map<int, double>* layer_values_;
 
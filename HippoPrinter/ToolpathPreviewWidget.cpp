@@ -291,54 +291,53 @@ void ToolpathPreviewWidget::LoadPrintObjectToolpaths(const PrintObject* object)
 	//ֱÿһϵÿһreigionڵĴӡ·ӽ
 	for (Layer* layer : layers) {
 		coordf_t top_z = layer->print_z;
+
+		//ÿregionĴӡ·ֻչһΣɸƷ
+		std::vector<FlatExtrusions> perimeters(layer->regions.size());
+		std::vector<FlatExtrusions> fills(layer->regions.size());
+		for (size_t region_id = 0; region_id < layer->regions.size(); region_id++) {
+			if (object->state.is_done(posPerimeters)) {
+				perimeters[region_id].append(layer->regions[region_id]->perimeters);
+			}
+			if (object->state.is_done(posInfill)) {
+				fills[region_id].append(layer->regions[region_id]->fills);
+			}
+		}
+
 		for (auto& copy : object->_shifted_copies) {
-			for (LayerRegion* region : layer->regions) {
+			for (size_t region_id = 0; region_id < layer->regions.size(); region_id++) {
+				LayerRegion* region = layer->regions[region_id];
+
 				//perimters·
 				if (object->state.is_done(posPerimeters)) {
 					 int color_index = color_toolpaths_by_extruder ?
 						 (region->region()->config.perimeter_extruder - 1) % 4 : 0;
-					//AddScenevolume(region->perimeters, top_z, copy, color, bbox);
-					AddScenevolume(region->perimeters, top_z, copy, color_index, bbox);
+					AddScenevolume(perimeters[region_id], 0, perimeters[region_id].entities.size(),
+						top_z, copy, color_index, bbox);
 				}
 
 				//Infill·
 				if (object->state.is_done(posInfill)) {
+					const FlatExtrusions& flat = fills[region_id];
 					int color_index = color_toolpaths_by_extruder ?
 						(region->region()->config.infill_extruder - 1) % 4 : 1;
 					if (color_toolpaths_by_extruder&&
 						region->region()->config.infill_extruder != region->region()->config.solid_infill_extruder) {
-					
-						ExtrusionEntityCollection solid_entities;
-						ExtrusionEntityCollection non_solid_entities;
-
-						//solidnon-solid infillʹòͬɫʾ
-						for (ExtrusionEntity* entity : region->fills.entities) {
-							if (entity->is_loop()) {
-								ExtrusionLoop* loop = dynamic_cast<ExtrusionLoop*>(entity);
-								if (loop->is_solid_infill()) {
-									solid_entities.append(*entity);
-								}
-								else {
-									non_solid_entities.append(*entity);
-								}
-							}
-							else {
-								ExtrusionPath* path = dynamic_cast<ExtrusionPath*>(entity);
-								if (path->is_solid_infill()) {
-									solid_entities.append(*entity);
-								}
-								else {
-									non_solid_entities.append(*entity);
-								}
-							}
-						}
+						int solid_color_index = (region->region()->config.solid_infill_extruder - 1) % 4;
 
-						AddScenevolume(non_solid_entities, top_z, copy, color_index, bbox);
-						color_index = (region->region()->config.solid_infill_extruder - 1) % 4;
-						AddScenevolume(solid_entities, top_z, copy, color_index, bbox);
+						//ɫvolume¼һƫƣʹûжӦinfill
+						AddScenevolume(flat, 0, 0, top_z, copy, color_index, bbox);
+						AddScenevolume(flat, 0, 0, top_z, copy, solid_color_index, bbox);
+
+						//fillsеÿһentityΪһsurfacecollection
+						//еpathsolidnon-solid infillʹòͬɫʾ
+						for (size_t entity = 1; entity < flat.entities.size(); entity = flat.entities[entity].last_entity) {
+							AddScenevolume(flat, entity, flat.entities[entity].last_entity, top_z, copy,
+								flat.is_solid_infill(entity) ? solid_color_index : color_index, bbox);
+						}
 					}
 					else {
-						AddScenevolume(region->fills, top_z, copy, color_index, bbox);
+						AddScenevolume(flat, 0, flat.entities.size(), top_z, copy, color_index, bbox);
 					}
 				}
 			}
@@ -360,19 +359,21 @@ void ToolpathPreviewWidget::LoadPrintObjectToolpaths(const PrintObject* object)
 		return x->print_z < y->print_z;
 	});
 
+	if (!object->state.is_done(posSupportMaterial)) return;
+
 	for (SupportLayer* support_layer : support_layers) {
 		coordf_t top_z = support_layer->print_z;
+		FlatExtrusions support_fills(support_layer->support_fills);
+		FlatExtrusions support_interface_fills(support_layer->support_interface_fills);
 		for (auto& copy : object->_shifted_copies) {
-			if (object->state.is_done(posSupportMaterial)) {
-				int color_index = color_toolpaths_by_extruder ?
-					(support_layer->object()->config.support_material_extruder - 1) % 4 : 2;
-				AddScenevolume(support_layer->support_fills, top_z, copy, color_index, bbox);
-
-				color_index = color_toolpaths_by_extruder ?
-					(support_layer->object()->config.support_material_interface_extruder - 1) % 4 : 3;
-				AddScenevolume(support_layer->support_interface_fills, top_z, copy, color_index, bbox);
-			}
-			
+			int color_index = color_toolpaths_by_extruder ?
+				(support_layer->object()->config.support_material_extruder - 1) % 4 : 2;
+			AddScenevolume(support_fills, 0, support_fills.entities.size(), top_z, copy, color_index, bbox);
+
+			color_index = color_toolpaths_by_extruder ?
+				(support_layer->object()->config.support_material_interface_extruder - 1) % 4 : 3;
+			AddScenevolume(support_interface_fills, 0, support_interface_fills.entities.size(),
+				top_z, copy, color_index, bbox);
 		}
 	}
 }
@@ -383,8 +384,8 @@ void ToolpathPreviewWidget::LoadPrintObjectToolpaths(const PrintObject* object)
  *  Ѿڸcolor_indexӦSceneVolume󣬾ֱqverts
  *  ǰڸcolor_indexӦSceneVolumeµSceneVolume
  */
-void ToolpathPreviewWidget::AddScenevolume(ExtrusionEntityCollection& entities, double top_z,
-	const Point& copy,int color_index,BoundingBoxf3& bbox) {
+void ToolpathPreviewWidget::AddScenevolume(const FlatExtrusions& flat, size_t first_entity, size_t last_entity,
+	double top_z, const Point& copy,int color_index,BoundingBoxf3& bbox) {
 
 	//ǰѾڸcolor_indexӦĶֱqvertstverts
 	if (color_volumes_.find(color_index) != color_volumes_.end()) {
@@ -394,7 +395,7 @@ void ToolpathPreviewWidget::AddScenevolume(ExtrusionEntityCollection& entities,
 		
 
 		//ExtrustionEntityתΪqvertstvertsӵǰvolume
-		ExtrusionEntityToVerts(entities, top_z, copy, volume);
+		ExtrusionEntityToVerts(flat, first_entity, last_entity, top_z, copy, volume);
 
 		//<top_z, [qverts_offset,tverts_offset]>
 		//print_zӦqvertstvertsƫƣڻSceneVolumeһ
@@ -413,7 +414,7 @@ void ToolpathPreviewWidget::AddScenevolume(ExtrusionEntityCollection& entities,
 		
 
 		//ExtrusionEntityתΪqvertstvertsӵ½Volumeй
-		ExtrusionEntityToVerts(entities, top_z, copy, volume);
+		ExtrusionEntityToVerts(flat, first_entity, last_entity, top_z, copy, volume);
 
 		//<print_z,[qverts_offset, tverts_offset]>
 		//print_zӦqvertstvertsƫƣڻSceneVolumeһ
@@ -428,57 +429,44 @@ void ToolpathPreviewWidget::AddScenevolume(ExtrusionEntityCollection& entities,
 
 
 /*
- *	ExtrusionEntityתΪvertsӵvolume
+ *	FlatExtrusions[first_entity, last_entity)entityתΪvertsӵvolume
  *	top_zextrusiontop height
- *  copyǰPrintObjectoffset,ҪԴӡ·Polylineƫ
+ *  copyǰPrintObjectoffset,ҪԴӡ·ƫ
  *	volumeǰSceneVolumeExtrusionEntityתĽ洢ڸö
  */
-void ToolpathPreviewWidget::ExtrusionEntityToVerts(ExtrusionEntity& entity, coordf_t top_z,
-	const Point& copy, SceneVolume& volume) {
+void ToolpathPreviewWidget::ExtrusionEntityToVerts(const FlatExtrusions& flat, size_t first_entity,
+	size_t last_entity, coordf_t top_z, const Point& copy, SceneVolume& volume) {
 	std::vector<double> widths;
 	std::vector<double> heights;
-	bool closed = false;
 	Lines lines;
 
-	//Ķ̬ΪExtrusionEntityCollectionÿһentityֱв
-	if (typeid(entity) == typeid(ExtrusionEntityCollection)) {
-		ExtrusionEntityCollection& entity_collection = dynamic_cast<ExtrusionEntityCollection&>(entity);
-		for (ExtrusionEntity* temp_entity : entity_collection.entities) {
-			ExtrusionEntityToVerts(*temp_entity, top_z, copy, volume);
+	//˳еpathloopcollectionֻpathķΧ
+	for (size_t entity = first_entity; entity < last_entity; ++entity) {
+		const FlatExtrusions::Entity& flat_entity = flat.entities[entity];
+		if (flat_entity.type == FlatExtrusions::feCollection) {
+			continue;
 		}
-		return;
-	}
-	//ǰĶ̬ΪExtrusionPathʹPolylineverts
-	else if (typeid(entity) == typeid(ExtrusionPath)) {
-		ExtrusionPath& path = dynamic_cast<ExtrusionPath&>(entity);
-		Slic3r::Polyline polyline = path.polyline;
-		polyline.remove_duplicate_points();
-		polyline.translate(copy);
-		lines = polyline.lines();
-		widths.clear();		widths.insert(widths.end(), lines.size(), path.width);
-		heights.clear();	heights.insert(heights.end(), lines.size(), path.height);
-		closed = 0;
-	}
-	//ǰӡĶ̬ΪExtrusionLooppolylineverts
-	else {
-		widths.clear(); heights.clear(); lines.clear(); closed = true;
-		ExtrusionLoop loop = dynamic_cast<ExtrusionLoop&>(entity);
-
-		for (ExtrusionPath& path : loop.paths) {
-			Slic3r::Polyline polyline = path.polyline;
-			polyline.remove_duplicate_points();
-			polyline.translate(copy);
-			Lines path_lines = polyline.lines();
-
-			lines.insert(lines.end(), path_lines.begin(), path_lines.end());
-			widths.insert(widths.end(), path_lines.size(), path.width);
-			heights.insert(heights.end(), path_lines.size(), path.height);
+		//pathloopĵvertsloopΪպϵ
+		//ֱɵķΧƽƺlinesظĵ
+		widths.clear(); heights.clear(); lines.clear();
+		for (size_t path = flat_entity.first_path; path < flat_entity.last_path; ++path) {
+			Points::const_iterator point = flat.path_begin(path);
+			Points::const_iterator end = flat.path_end(path);
+			if (point == end) continue;
+			Point last = *point;
+			for (++point; point != end; ++point) {
+				if (point->coincides_with(last)) continue;
+				lines.push_back(Line(last, *point));
+				lines.back().translate(copy.x, copy.y);
+				last = *point;
+			}
+			widths.resize(lines.size(), flat.widths[path]);
+			heights.resize(lines.size(), flat.heights[path]);
 		}
+		//extrusion entityתΪqvertstvertsvolume
+		_3DScene::_extrusionentity_to_verts_do(lines, widths, heights, flat_entity.type == FlatExtrusions::feLoop,
+			top_z, copy, &volume.qverts_, &volume.tverts_);
 	}
-	//extrusion entityתΪqvertstvertsvolume
-	_3DScene::_extrusionentity_to_verts_do(lines, widths, heights, closed,
-		top_z, copy, &volume.qverts_, &volume.tverts_);
-
 }
 
 
@@ -104,13 +104,13 @@ private:
 	void InitActions();
 
 
-// 	// ExtrusionEntityΪµvolume
-	void AddScenevolume(ExtrusionEntityCollection& entities, coordf_t top_z,
-		const Point& copy, int color_index, BoundingBoxf3& bbox);
+// 	// FlatExtrusions[first_entity, last_entity)entityΪµvolume
+	void AddScenevolume(const FlatExtrusions& flat, size_t first_entity, size_t last_entity,
+		coordf_t top_z, const Point& copy, int color_index, BoundingBoxf3& bbox);
 
 	//extrusion entiti תΪverts
-	void ExtrusionEntityToVerts(ExtrusionEntity& entity, coordf_t top_z,
-		const Point& copy, SceneVolume& volume);
+	void ExtrusionEntityToVerts(const FlatExtrusions& flat, size_t first_entity, size_t last_entity,
+		coordf_t top_z, const Point& copy, SceneVolume& volume);
 
 
 private:
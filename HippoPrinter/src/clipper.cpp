@@ -390,9 +390,21 @@ bool Orientation(const Path &poly)
 }
 //------------------------------------------------------------------------------
 
+bool Orientation(const IntPoint *poly, size_t size)
+{
+	return Area(poly, size) >= 0;
+}
+//------------------------------------------------------------------------------
+
 double Area(const Path &poly)
 {
-  int size = (int)poly.size();
+  return Area(poly.data(), poly.size());
+}
+//------------------------------------------------------------------------------
+
+double Area(const IntPoint *poly, size_t count)
+{
+  int size = (int)count;
   if (size < 3) return 0;
 
   double a = 0;
@@ -1045,6 +1057,12 @@ TEdge* ClipperBase::ProcessBound(TEdge* E, bool NextIsForward)
 //------------------------------------------------------------------------------
 
 bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
+{
+  return AddPath(pg.data(), pg.size(), PolyTyp, Closed);
+}
+//------------------------------------------------------------------------------
+
+bool ClipperBase::AddPath(const IntPoint *pg, size_t size, PolyType PolyTyp, bool Closed)
 {
 #ifdef use_lines
   if (!Closed && PolyTyp == ptClip)
@@ -1054,7 +1072,7 @@ bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
 	throw clipperException("AddPath: Open paths have been disabled.");
 #endif
 
-  int highI = (int)pg.size() -1;
+  int highI = (int)size -1;
   if (Closed) while (highI > 0 && (pg[highI] == pg[0])) --highI;
   while (highI > 0 && (pg[highI] == pg[highI -1])) --highI;
   if ((Closed && highI < 2) || (!Closed && highI < 1)) return false;
@@ -171,7 +171,9 @@ private:
 };
 
 bool Orientation(const Path &poly);
+bool Orientation(const IntPoint *poly, size_t size);
 double Area(const Path &poly);
+double Area(const IntPoint *poly, size_t size);
 int PointInPolygon(const IntPoint &pt, const Path &path);
 
 void SimplifyPolygon(const Path &in_poly, Paths &out_polys, PolyFillType fillType = pftEvenOdd);
@@ -223,6 +225,8 @@ public:
   ClipperBase();
   virtual ~ClipperBase();
   virtual bool AddPath(const Path &pg, PolyType PolyTyp, bool Closed);
+  //the path as an array of points, e.g. when held by a container other than Path
+  bool AddPath(const IntPoint *pg, size_t size, PolyType PolyTyp, bool Closed);
   bool AddPaths(const Paths &ppg, PolyType PolyTyp, bool Closed);
   virtual void Clear();
   IntRect GetBounds();
@@ -34,6 +34,7 @@ class BoundingBoxBase
     void offset(coordf_t delta);
     PointClass center() const;
     bool contains(const PointClass &point) const;
+    bool overlap(const BoundingBoxBase<PointClass> &other) const;
 };
 
 template <class PointClass>
@@ -1,6 +1,7 @@
 #include "BridgeDetector.hpp"
 #include "ClipperUtils.hpp"
 #include "Geometry.hpp"
+#include "ThreadPool.hpp"
 #include <algorithm>
 
 namespace Slic3r {
@@ -14,12 +15,24 @@ BridgeDetector::BridgeDetector(const ExPolygon &_expolygon, const ExPolygonColle
         for detecting anchors */
     Polygons grown = offset(this->expolygon, this->extrusion_width);
     
+    /*  only the lower slices close to the bridge can make anchors, supporting edges or
+        support the edges in unsupported_edges(): the mitered offsets below reach at most
+        3 extrusion widths out and the closing merges slices less than one width apart,
+        so slices farther than 5 widths can't change anything. Skipping them saves
+        offsetting the whole layer below for every bridge. */
+    BoundingBox near_bb = this->expolygon.contour.bounding_box();
+    near_bb.offset(5 * this->extrusion_width);
+    Polygons near_lower_slices;
+    for (const ExPolygon &e : _lower_slices.expolygons)
+        if (near_bb.overlap(e.contour.bounding_box()))
+            append_to(near_lower_slices, (Polygons)e);
+    
     // remove narrow gaps from lower slices
     // (this is only needed as long as we use clipped test lines for angle detection
     // and we check their endpoints: when endpoint fall in the gap we'd get false
     // negatives)
     this->lower_slices.expolygons = offset2_ex(
-        _lower_slices,
+        near_lower_slices,
         +this->extrusion_width/2,
         -this->extrusion_width/2
     );
@@ -35,6 +48,7 @@ BridgeDetector::BridgeDetector(const ExPolygon &_expolygon, const ExPolygonColle
     // detect anchors as intersection between our bridge expolygon and the lower slices
     // safety offset required to avoid Clipper from detecting empty intersection while Boost actually found some edges
     this->_anchors = intersection_ex(grown, this->lower_slices, true);
+    this->_anchor_index.build(this->_anchors);
     
     #if 0
     {
@@ -106,69 +120,58 @@ BridgeDetector::detect_angle()
             candidates.push_back(BridgeDirection(angle));
     }
     
-    const coord_t line_increment = this->extrusion_width;
-    bool have_coverage = false;
-    for (BridgeDirection &candidate : candidates) {
-        Polygons my_clip_area = clip_area;
-        ExPolygons my_anchors = this->_anchors;
-        
-        // rotate everything - the center point doesn't matter
-        for (Polygon &p : my_clip_area)
-            p.rotate(-candidate.angle, Point(0,0));
-        for (ExPolygon &e : my_anchors)
-            e.rotate(-candidate.angle, Point(0,0));
-    
-        // generate lines in this direction
-        BoundingBox bb;
-        for (const ExPolygon &e : my_anchors)
-            bb.merge(e.bounding_box());
-        
-        Lines lines;
-        for (coord_t y = bb.min.y; y <= bb.max.y; y += line_increment)
-            lines.push_back(Line(Point(bb.min.x, y), Point(bb.max.x, y)));
-        
-        const Lines clipped_lines = intersection_ln(lines, my_clip_area);
+    /*  every candidate is evaluated in two steps, both run in parallel over the candidates:
+        first the test lines are clipped and the ones anchored at both ends are kept, which
+        also bounds the coverage by the area of their extrusions; then the covered area is
+        computed, in descending order of the bound and only until the candidates left can
+        no longer change the choice below */
+    parallel_for(size_t(0), candidates.size(), [this, &clip_area, &candidates](size_t i) {
+        this->_anchored_lines(clip_area, &candidates[i]);
+    });
+    
+    std::vector<size_t> by_bound(candidates.size());
+    for (size_t i = 0; i < by_bound.size(); ++ i)
+        by_bound[i] = i;
+    std::stable_sort(by_bound.begin(), by_bound.end(), [&candidates](size_t i1, size_t i2) {
+        return candidates[i1].max_coverage > candidates[i2].max_coverage;
+    });
+    
+    // candidates sorted by coverage - most coverage first, ties in the order of the angles
+    std::vector<size_t> sorted;
+    size_t i_best = 0;
+    const size_t batch = std::max<size_t>(4, 2 * ThreadPool::instance().size());
+    for (size_t evaluated = 0; evaluated < by_bound.size(); ) {
+        const size_t end = std::min(by_bound.size(), evaluated + batch);
+        parallel_for(evaluated, end, [this, &clip_area, &candidates, &by_bound](size_t k) {
+            this->_coverage(clip_area, &candidates[by_bound[k]]);
+        }, 1);
+        sorted.insert(sorted.end(), by_bound.begin() + evaluated, by_bound.begin() + end);
+        evaluated = end;
+        std::sort(sorted.begin(), sorted.end(), [&candidates](size_t i1, size_t i2) {
+            return candidates[i1].coverage > candidates[i2].coverage
+                || (candidates[i1].coverage == candidates[i2].coverage && i1 < i2);
+        });
         
-        for (const Line &line : clipped_lines) {
-            // skip any line not having both endpoints within anchors
-            if (!Slic3r::Geometry::contains(my_anchors, line.a)
-                || !Slic3r::Geometry::contains(my_anchors, line.b))
-                continue;
-            
-            candidate.max_length = std::max(candidate.max_length, line.length());
-            // Calculate coverage as actual covered area, because length of centerlines
-            // is not accurate enough when such lines are slightly skewed and not parallel
-            // to the sides; calculating area will compute them as triangles.
-            // TODO: use a faster algorithm for computing covered area by using a sweep line
-            // instead of intersecting many lines.
-            candidate.coverage += Slic3r::Geometry::area(intersection(
-                my_clip_area,
-                offset((Polyline)line, +this->extrusion_width/2)
-            ));
-        }
-        if (candidate.coverage > 0) have_coverage = true;
+        // if any other direction is within extrusion width of coverage, prefer it if shorter
+        // TODO: There are two options here - within width of the angle with most coverage, or within width of the currently perferred?
+        i_best = 0;
+        size_t i = 1;
+        for (; i < sorted.size() && candidates[sorted[i_best]].coverage - candidates[sorted[i]].coverage < this->extrusion_width; ++ i)
+            if (candidates[sorted[i]].max_length < candidates[sorted[i_best]].max_length)
+                i_best = i;
         
-        #if 0
-        std::cout << "angle = "  << Slic3r::Geometry::rad2deg(candidate.angle)
-            << "; coverage = "   << candidate.coverage
-            << "; max_length = " << candidate.max_length
-            << std::endl;
-        #endif
+        /*  the search above stopped at candidate i: the candidates not evaluated yet,
+            whose coverage can't reach the one of i, would be sorted after it and can't
+            be chosen */
+        if (i < sorted.size() && evaluated < by_bound.size()
+            && candidates[by_bound[evaluated]].max_coverage < candidates[sorted[i]].coverage)
+            break;
     }
     
     // if no direction produced coverage, then there's no bridge direction
-    if (!have_coverage) return false;
-    
-    // sort directions by coverage - most coverage first
-    std::sort(candidates.begin(), candidates.end());
-    
-    // if any other direction is within extrusion width of coverage, prefer it if shorter
-    // TODO: There are two options here - within width of the angle with most coverage, or within width of the currently perferred?
-    size_t i_best = 0;
-    for (size_t i = 1; i < candidates.size() && candidates[i_best].coverage - candidates[i].coverage < this->extrusion_width; ++ i)
-        if (candidates[i].max_length < candidates[i_best].max_length)
-            i_best = i;
+    if (candidates[sorted.front()].coverage <= 0) return false;
     
+    i_best = sorted[i_best];
     this->angle = candidates[i_best].angle;
     
     if (this->angle >= PI) this->angle -= PI;
@@ -180,6 +183,141 @@ BridgeDetector::detect_angle()
     return true;
 }
 
+void
+BridgeDetector::_anchored_lines(const Polygons &clip_area, BridgeDirection* candidate) const
+{
+    Polygons my_clip_area = clip_area;
+    ExPolygons my_anchors = this->_anchors;
+    
+    // rotate everything - the center point doesn't matter
+    for (Polygon &p : my_clip_area)
+        p.rotate(-candidate->angle, Point(0,0));
+    for (ExPolygon &e : my_anchors)
+        e.rotate(-candidate->angle, Point(0,0));
+    
+    // generate lines in this direction
+    BoundingBox bb;
+    for (const ExPolygon &e : my_anchors)
+        bb.merge(e.bounding_box());
+    
+    const coord_t line_increment = this->extrusion_width;
+    Lines lines;
+    for (coord_t y = bb.min.y; y <= bb.max.y; y += line_increment)
+        lines.push_back(Line(Point(bb.min.x, y), Point(bb.max.x, y)));
+    
+    const Lines clipped_lines = intersection_ln(lines, my_clip_area);
+    
+    for (const Line &line : clipped_lines) {
+        // skip any line not having both endpoints within anchors
+        if (!this->_anchored(my_anchors, candidate->angle, line.a)
+            || !this->_anchored(my_anchors, candidate->angle, line.b))
+            continue;
+        
+        candidate->max_length = std::max(candidate->max_length, line.length());
+        candidate->anchored_lines.push_back(line);
+        // the extrusion of the line is a length x extrusion_width rectangle,
+        // with a unit of margin on each side for the rounding of the offset
+        candidate->max_coverage += (line.length() + 2) * (this->extrusion_width + 2);
+    }
+}
+
+void
+BridgeDetector::_coverage(const Polygons &clip_area, BridgeDirection* candidate) const
+{
+    if (candidate->anchored_lines.empty()) return;
+    
+    Polygons my_clip_area = clip_area;
+    for (Polygon &p : my_clip_area)
+        p.rotate(-candidate->angle, Point(0,0));
+    
+    for (const Line &line : candidate->anchored_lines) {
+        // Calculate coverage as actual covered area, because length of centerlines
+        // is not accurate enough when such lines are slightly skewed and not parallel
+        // to the sides; calculating area will compute them as triangles.
+        // TODO: use a faster algorithm for computing covered area by using a sweep line
+        // instead of intersecting many lines.
+        candidate->coverage += Slic3r::Geometry::area(intersection(
+            my_clip_area,
+            offset((Polyline)line, +this->extrusion_width/2)
+        ));
+    }
+    
+    #if 0
+    std::cout << "angle = "  << Slic3r::Geometry::rad2deg(candidate->angle)
+        << "; coverage = "   << candidate->coverage
+        << "; max_length = " << candidate->max_length
+        << std::endl;
+    #endif
+}
+
+// point is in the frame rotated by -angle, as are rotated_anchors
+bool
+BridgeDetector::_anchored(const ExPolygons &rotated_anchors, double angle, const Point &point) const
+{
+    Point unrotated = point;
+    unrotated.rotate(angle, Point(0,0));
+    BoundingBox bb;
+    bb.merge(unrotated);
+    std::vector<size_t> anchors;
+    this->_anchor_index.query(bb, &anchors);
+    for (size_t idx : anchors)
+        if (rotated_anchors[idx].contains(point))
+            return true;
+    return false;
+}
+
+void
+BridgeDetector::AnchorIndex::build(const ExPolygons &anchors)
+{
+    this->_bboxes.clear();
+    this->_cells.clear();
+    this->_bb = BoundingBox();
+    for (const ExPolygon &anchor : anchors) {
+        // the rotation of the anchors and of the query points back to this frame
+        // moves them by a unit or two, don't miss them because of that
+        BoundingBox bb = anchor.contour.bounding_box();
+        bb.offset(SCALED_EPSILON);
+        this->_bboxes.push_back(bb);
+        this->_bb.merge(bb);
+    }
+    if (anchors.empty()) return;
+    
+    // about 2 x 2 cells per anchor, at most 32 x 32
+    const coord_t size = std::max(this->_bb.max.x - this->_bb.min.x, this->_bb.max.y - this->_bb.min.y);
+    const int cells = std::min(32, 2 * int(ceil(sqrt(double(anchors.size())))));
+    this->_cell_size = std::max<coord_t>(1, size / cells + 1);
+    this->_columns = int((this->_bb.max.x - this->_bb.min.x) / this->_cell_size) + 1;
+    this->_rows    = int((this->_bb.max.y - this->_bb.min.y) / this->_cell_size) + 1;
+    this->_cells.assign(this->_columns * this->_rows, std::vector<size_t>());
+    for (size_t idx = 0; idx < this->_bboxes.size(); ++ idx) {
+        const BoundingBox &bb = this->_bboxes[idx];
+        for (int row = int((bb.min.y - this->_bb.min.y) / this->_cell_size); row <= int((bb.max.y - this->_bb.min.y) / this->_cell_size); ++ row)
+            for (int column = int((bb.min.x - this->_bb.min.x) / this->_cell_size); column <= int((bb.max.x - this->_bb.min.x) / this->_cell_size); ++ column)
+                this->_cells[row * this->_columns + column].push_back(idx);
+    }
+}
+
+void
+BridgeDetector::AnchorIndex::query(const BoundingBox &bb, std::vector<size_t>* anchors) const
+{
+    anchors->clear();
+    if (this->_cells.empty() || ! this->_bb.overlap(bb)) return;
+    
+    const int column_min = std::max(0, int((bb.min.x - this->_bb.min.x) / this->_cell_size));
+    const int column_max = std::min(this->_columns - 1, int((bb.max.x - this->_bb.min.x) / this->_cell_size));
+    const int row_min    = std::max(0, int((bb.min.y - this->_bb.min.y) / this->_cell_size));
+    const int row_max    = std::min(this->_rows - 1, int((bb.max.y - this->_bb.min.y) / this->_cell_size));
+    for (int row = row_min; row <= row_max; ++ row)
+        for (int column = column_min; column <= column_max; ++ column)
+            for (size_t idx : this->_cells[row * this->_columns + column])
+                if (this->_bboxes[idx].overlap(bb))
+                    anchors->push_back(idx);
+    
+    // anchors spanning several cells were found more than once
+    std::sort(anchors->begin(), anchors->end());
+    anchors->erase(std::unique(anchors->begin(), anchors->end()), anchors->end());
+}
+
 Polygons
 BridgeDetector::coverage() const
 {
@@ -205,17 +343,28 @@ BridgeDetector::coverage(double angle) const
         e.get_trapezoids2(&trapezoids, PI/2.0);
     
     // get anchors, convert them to Polygons and rotate them too
-    Polygons anchors;
+    std::vector<Polygons> anchors;
     for (const ExPolygon &anchor : this->_anchors) {
         Polygons pp = anchor;
         for (Polygon &p : pp)
             p.rotate(PI/2.0 - angle, Point(0,0));
-        append_to(anchors, pp);
+        anchors.push_back(pp);
     }
     
-    Polygons covered;
-    for (const Polygon &trapezoid : trapezoids) {
-        Lines supported = intersection_ln(trapezoid.lines(), anchors);
+    // the trapezoids are independent, test them in parallel against the anchors around them
+    std::vector<char> supported_trapezoids(trapezoids.size(), false);
+    parallel_for(size_t(0), trapezoids.size(), [this, angle, &trapezoids, &anchors, &supported_trapezoids](size_t idx) {
+        const Polygon &trapezoid = trapezoids[idx];
+        Polygon unrotated = trapezoid;
+        unrotated.rotate(-(PI/2.0 - angle), Point(0,0));
+        std::vector<size_t> near;
+        this->_anchor_index.query(unrotated.bounding_box(), &near);
+        if (near.empty()) return;
+        Polygons near_anchors;
+        for (size_t anchor_idx : near)
+            append_to(near_anchors, anchors[anchor_idx]);
+        
+        Lines supported = intersection_ln(trapezoid.lines(), near_anchors);
         
         // not nice, we need a more robust non-numeric check
         for (size_t i = 0; i < supported.size(); ++i) {
@@ -225,8 +374,12 @@ BridgeDetector::coverage(double angle) const
             }
         }
 
-        if (supported.size() >= 2) covered.push_back(trapezoid);        
-    }
+        supported_trapezoids[idx] = supported.size() >= 2;
+    });
+    
+    Polygons covered;
+    for (size_t idx = 0; idx < trapezoids.size(); ++ idx)
+        if (supported_trapezoids[idx]) covered.push_back(trapezoids[idx]);
     
     // merge trapezoids and rotate them back
     covered = union_(covered);
@@ -2,6 +2,7 @@
 #define slic3r_BridgeDetector_hpp_
 
 #include "libslic3r.h"
+#include "BoundingBox.hpp"
 #include "ExPolygon.hpp"
 #include "ExPolygonCollection.hpp"
 #include <string>
@@ -12,7 +13,7 @@ class BridgeDetector {
 public:
     // The non-grown hole.
     ExPolygon expolygon;
-    // Lower slices, all regions.
+    // Lower slices, all regions, close to the bridge.
     ExPolygonCollection lower_slices;
     // Scaled extrusion width of the infill.
     coord_t extrusion_width;
@@ -33,18 +34,40 @@ private:
     // Closed polygons representing the supporting areas.
     ExPolygons _anchors;
     
+    // Uniform grid over the bounding boxes of the anchors, telling which anchors may contain
+    // a point or touch a box. Built once in the unrotated frame and shared by all the
+    // candidate angles of detect_angle() and by coverage().
+    class AnchorIndex {
+        public:
+        void build(const ExPolygons &anchors);
+        // Indices (ascending) of the anchors whose bounding box overlaps bb.
+        void query(const BoundingBox &bb, std::vector<size_t>* anchors) const;
+        
+        private:
+        std::vector<BoundingBox> _bboxes;
+        BoundingBox _bb;
+        coord_t _cell_size;
+        int _columns, _rows;
+        std::vector< std::vector<size_t> > _cells;
+    };
+    AnchorIndex _anchor_index;
+    
     class BridgeDirection {
         public:
-        BridgeDirection(double a = -1.) : angle(a), coverage(0.), max_length(0.) {}
-        // the best direction is the one causing most lines to be bridged (thus most coverage)
-        bool operator<(const BridgeDirection &other) const {
-            // Initial sort by coverage only - comparator must obey strict weak ordering
-            return this->coverage > other.coverage;
-        };
+        BridgeDirection(double a = -1.) : angle(a), coverage(0.), max_length(0.), max_coverage(0.) {}
         double angle;
+        // the best direction is the one causing most lines to be bridged (thus most coverage)
         double coverage;
         double max_length;
+        // test lines (in the rotated frame) having both endpoints within anchors
+        Lines anchored_lines;
+        // upper bound of coverage: the total area of the extrusions of anchored_lines
+        double max_coverage;
     };
+    
+    void _anchored_lines(const Polygons &clip_area, BridgeDirection* candidate) const;
+    void _coverage(const Polygons &clip_area, BridgeDirection* candidate) const;
+    bool _anchored(const ExPolygons &rotated_anchors, double angle, const Point &point) const;
 };
 
 }
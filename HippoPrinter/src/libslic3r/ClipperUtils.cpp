@@ -1,5 +1,8 @@
 #include "ClipperUtils.hpp"
 #include "Geometry.hpp"
+#include "BoundingBox.hpp"
+#include <algorithm>
+#include <numeric>
 
 namespace Slic3r {
 
@@ -35,8 +38,14 @@ T
 ClipperPath_to_Slic3rMultiPoint(const ClipperLib::Path &input)
 {
     T retval;
+#ifdef use_xyz
+    retval.points.reserve(input.size());
     for (ClipperLib::Path::const_iterator pit = input.begin(); pit != input.end(); ++pit)
         retval.points.push_back(Point( (*pit).X, (*pit).Y ));
+#else
+    const Point* points = ClipperPoints_to_Slic3rPoints(input);
+    retval.points.assign(points, points + input.size());
+#endif
     return retval;
 }
 template Polygon ClipperPath_to_Slic3rMultiPoint<Polygon>(const ClipperLib::Path &input);
@@ -46,6 +55,7 @@ T
 ClipperPaths_to_Slic3rMultiPoints(const ClipperLib::Paths &input)
 {
     T retval;
+    retval.reserve(input.size());
     for (ClipperLib::Paths::const_iterator it = input.begin(); it != input.end(); ++it)
         retval.push_back(ClipperPath_to_Slic3rMultiPoint<typename T::value_type>(*it));
     return retval;
@@ -54,25 +64,26 @@ ClipperPaths_to_Slic3rMultiPoints(const ClipperLib::Paths &input)
 ExPolygons
 ClipperPaths_to_Slic3rExPolygons(const ClipperLib::Paths &input)
 {
-    // init Clipper
-    ClipperLib::Clipper clipper;
-    clipper.Clear();
-    
     // perform union
-    clipper.AddPaths(input, ClipperLib::ptSubject, true);
-    ClipperLib::PolyTree polytree;
-    clipper.Execute(ClipperLib::ctUnion, polytree, ClipperLib::pftEvenOdd, ClipperLib::pftEvenOdd);  // offset results work with both EvenOdd and NonZero
+    ClipperContext::Lease context;
+    context->union_paths(input, ClipperLib::pftEvenOdd, &context->polytree);  // offset results work with both EvenOdd and NonZero
     
     // write to ExPolygons object
-    return PolyTreeToExPolygons(polytree);
+    return PolyTreeToExPolygons(context->polytree);
 }
 
 ClipperLib::Path
 Slic3rMultiPoint_to_ClipperPath(const MultiPoint &input)
 {
     ClipperLib::Path retval;
+#ifdef use_xyz
+    retval.reserve(input.points.size());
     for (Points::const_iterator pit = input.points.begin(); pit != input.points.end(); ++pit)
         retval.push_back(ClipperLib::IntPoint( (*pit).x, (*pit).y ));
+#else
+    const ClipperLib::IntPoint* points = Slic3rPoints_to_ClipperPoints(input.points);
+    retval.assign(points, points + input.points.size());
+#endif
     return retval;
 }
 
@@ -81,10 +92,13 @@ ClipperLib::Paths
 Slic3rMultiPoints_to_ClipperPaths(const T &input)
 {
     ClipperLib::Paths retval;
+    retval.reserve(input.size());
     for (typename T::const_iterator it = input.begin(); it != input.end(); ++it)
         retval.push_back(Slic3rMultiPoint_to_ClipperPath(*it));
     return retval;
 }
+template ClipperLib::Paths Slic3rMultiPoints_to_ClipperPaths<Polygons>(const Polygons &input);
+template ClipperLib::Paths Slic3rMultiPoints_to_ClipperPaths<Polylines>(const Polylines &input);
 
 void
 scaleClipperPolygons(ClipperLib::Paths &polygons, const double scale)
@@ -97,56 +111,270 @@ scaleClipperPolygons(ClipperLib::Paths &polygons, const double scale)
     }
 }
 
-ClipperLib::Paths
-_offset(const Polygons &polygons, const float delta,
-    double scale, ClipperLib::JoinType joinType, double miterLimit)
+// Slic3r -> Clipper into a reused buffer, scaling on the way and reusing the storage
+// of the buffer's paths as well
+template <class T>
+static void
+read_clipper_paths(const T &input, const double scale, ClipperLib::Paths* paths)
 {
-    // read input
-    ClipperLib::Paths input = Slic3rMultiPoints_to_ClipperPaths(polygons);
-    
-    // scale input
-    scaleClipperPolygons(input, scale);
-    
-    // perform offset
-    ClipperLib::ClipperOffset co;
+    paths->resize(input.size());
+    for (size_t i = 0; i < input.size(); ++i) {
+        const Points &points = input[i].points;
+        ClipperLib::Path &path = (*paths)[i];
+#ifndef use_xyz
+        if (scale == 1) {
+            const ClipperLib::IntPoint* begin = Slic3rPoints_to_ClipperPoints(points);
+            path.assign(begin, begin + points.size());
+            continue;
+        }
+#endif
+        path.resize(points.size());
+        for (size_t j = 0; j < points.size(); ++j) {
+            ClipperLib::IntPoint &pt = path[j];
+            pt.X = points[j].x;
+            pt.Y = points[j].y;
+            if (scale != 1) {
+                pt.X *= scale;
+                pt.Y *= scale;
+            }
+        }
+    }
+}
+
+ClipperContext::Lease::Lease()
+    : _context(&ClipperContext::_thread_context()), _owned(NULL)
+{
+    if (this->_context->_leased)
+        this->_context = this->_owned = new ClipperContext();
+    this->_context->_leased = true;
+}
+
+ClipperContext::Lease::~Lease()
+{
+    this->_context->_leased = false;
+    delete this->_owned;
+}
+
+ClipperContext&
+ClipperContext::_thread_context()
+{
+    static thread_local ClipperContext context;
+    return context;
+}
+
+// the engines as freshly constructed ones, apart from the storage they keep
+ClipperLib::Clipper&
+ClipperContext::_reset_clipper()
+{
+    ClipperLib::Clipper &clipper = *this->_clipper;
+    clipper.Clear();
+    clipper.PreserveCollinear(false);
+    clipper.StrictlySimple(false);
+    clipper.ReverseSolution(false);
+    return clipper;
+}
+
+static inline void clear_solution(ClipperLib::Paths* solution) { solution->clear(); }
+static inline void clear_solution(ClipperLib::PolyTree* solution) { solution->Clear(); }
+
+// A failed operation (on an empty input, for instance) leaves the solution untouched,
+// and possibly some of its sweep state behind in the engine, so the solution is cleared
+// up front and the engine is replaced after a failure.
+template <class T>
+void
+ClipperContext::_execute(ClipperLib::ClipType clipType, T* solution, ClipperLib::PolyFillType fillType)
+{
+    clear_solution(solution);
+    if (!this->_clipper->Execute(clipType, *solution, fillType, fillType))
+        this->_clipper.reset(new ClipperLib::Clipper());
+}
+
+ClipperLib::ClipperOffset&
+ClipperContext::_reset_offsetter(ClipperLib::JoinType joinType, double miterLimit)
+{
+    ClipperLib::ClipperOffset &co = this->_offsetter;
+    co.Clear();
+    co.MiterLimit   = 2.0;
+    co.ArcTolerance = 0.25;
     if (joinType == jtRound) {
         co.ArcTolerance = miterLimit;
     } else {
         co.MiterLimit = miterLimit;
     }
-    co.AddPaths(input, joinType, ClipperLib::etClosedPolygon);
-    ClipperLib::Paths retval;
-    co.Execute(retval, (delta*scale));
+    return co;
+}
+
+// Adds the paths to the engine straight from their points, or copies them first
+// to grow them by the safety offset.
+template <class T>
+void
+ClipperContext::_add_paths(const T &input, ClipperLib::PolyType polyType, bool closed, bool safety_offset_)
+{
+#ifndef use_xyz
+    if (!safety_offset_) {
+        for (typename T::const_iterator it = input.begin(); it != input.end(); ++it)
+            this->_clipper->AddPath(Slic3rPoints_to_ClipperPoints(it->points), it->points.size(), polyType, closed);
+        return;
+    }
+#endif
+    ClipperLib::Paths &paths = (polyType == ClipperLib::ptSubject) ? this->_subject : this->_clip;
+    read_clipper_paths(input, 1, &paths);
+    if (safety_offset_) this->safety_offset(&paths);
+    this->_clipper->AddPaths(paths, polyType, closed);
+}
+
+template <class T>
+ClipperLib::Paths&
+ClipperContext::offset(const T &input, ClipperLib::EndType endType, const float delta,
+    double scale, ClipperLib::JoinType joinType, double miterLimit)
+{
+    // read and scale input
+    read_clipper_paths(input, scale, &this->_subject);
+    
+    // perform offset
+    ClipperLib::ClipperOffset &co = this->_reset_offsetter(joinType, miterLimit);
+    co.AddPaths(this->_subject, joinType, endType);
+    co.Execute(this->output, (delta*scale));
     
     // unscale output
-    scaleClipperPolygons(retval, 1/scale);
-    return retval;
+    scaleClipperPolygons(this->output, 1/scale);
+    return this->output;
 }
+template ClipperLib::Paths& ClipperContext::offset<Polygons>(const Polygons &input, ClipperLib::EndType endType,
+    const float delta, double scale, ClipperLib::JoinType joinType, double miterLimit);
+template ClipperLib::Paths& ClipperContext::offset<Polylines>(const Polylines &input, ClipperLib::EndType endType,
+    const float delta, double scale, ClipperLib::JoinType joinType, double miterLimit);
 
-ClipperLib::Paths
-_offset(const Polylines &polylines, const float delta,
+ClipperLib::Paths&
+ClipperContext::offset2(const Polygons &polygons, const float delta1, const float delta2,
     double scale, ClipperLib::JoinType joinType, double miterLimit)
 {
-    // read input
-    ClipperLib::Paths input = Slic3rMultiPoints_to_ClipperPaths(polylines);
+    // read and scale input
+    read_clipper_paths(polygons, scale, &this->_subject);
     
+    // perform first offset
+    ClipperLib::ClipperOffset &co = this->_reset_offsetter(joinType, miterLimit);
+    co.AddPaths(this->_subject, joinType, ClipperLib::etClosedPolygon);
+    co.Execute(this->_scratch, (delta1*scale));
+    
+    // perform second offset
+    co.Clear();
+    co.AddPaths(this->_scratch, joinType, ClipperLib::etClosedPolygon);
+    co.Execute(this->output, (delta2*scale));
+    
+    // unscale output
+    scaleClipperPolygons(this->output, 1/scale);
+    return this->output;
+}
+
+template <class T>
+void
+ClipperContext::clip(ClipperLib::ClipType clipType, const Polygons &subject,
+    const Polygons &clip, const ClipperLib::PolyFillType fillType, bool safety_offset_, T* retval)
+{
+    // add polygons (the ones to be grown by the safety offset, if any, are copied)
+    this->_reset_clipper();
+    this->_add_paths(subject, ClipperLib::ptSubject, true, safety_offset_ && clipType == ClipperLib::ctUnion);
+    this->_add_paths(clip,    ClipperLib::ptClip,    true, safety_offset_ && clipType != ClipperLib::ctUnion);
+    
+    // perform operation
+    this->_execute(clipType, retval, fillType);
+}
+template void ClipperContext::clip<ClipperLib::Paths>(ClipperLib::ClipType clipType, const Polygons &subject,
+    const Polygons &clip, const ClipperLib::PolyFillType fillType, bool safety_offset_, ClipperLib::Paths* retval);
+template void ClipperContext::clip<ClipperLib::PolyTree>(ClipperLib::ClipType clipType, const Polygons &subject,
+    const Polygons &clip, const ClipperLib::PolyFillType fillType, bool safety_offset_, ClipperLib::PolyTree* retval);
+
+// The Clipper library has difficulties processing overlapping polygons.
+// Namely, the function Clipper::JoinCommonEdges() has potentially a terrible time complexity if the output
+// of the operation is of the PolyTree type.
+// This function implements a following workaround:
+// 1) Peform the Clipper operation with the output to Paths. This method handles overlaps in a reasonable time.
+// 2) Run Clipper Union once again to extract the PolyTree from the result of 1).
+void
+ClipperContext::clip_polytree2(ClipperLib::ClipType clipType, const Polygons &subject,
+    const Polygons &clip, const ClipperLib::PolyFillType fillType, bool safety_offset_,
+    ClipperLib::PolyTree* retval)
+{
+    // add polygons (the ones to be grown by the safety offset, if any, are copied)
+    this->_reset_clipper();
+    this->_add_paths(subject, ClipperLib::ptSubject, true, safety_offset_ && clipType == ClipperLib::ctUnion);
+    this->_add_paths(clip,    ClipperLib::ptClip,    true, safety_offset_ && clipType != ClipperLib::ctUnion);
+    // Perform the operation with the output to the subject buffer.
+    // This pass does not generate a PolyTree, which is a very expensive operation with the current Clipper library
+    // if there are overlapping edges.
+    this->_execute(clipType, &this->_subject, fillType);
+    // Perform an additional Union operation to generate the PolyTree ordering.
+    this->_reset_clipper().AddPaths(this->_subject, ClipperLib::ptSubject, true);
+    this->_execute(ClipperLib::ctUnion, retval, fillType);
+}
+
+void
+ClipperContext::clip(ClipperLib::ClipType clipType, const Polylines &subject,
+    const Polygons &clip, const ClipperLib::PolyFillType fillType, bool safety_offset_,
+    ClipperLib::PolyTree* retval)
+{
+    // add polylines and polygons (the latter copied if grown by the safety offset)
+    this->_reset_clipper();
+    this->_add_paths(subject, ClipperLib::ptSubject, false, false);
+    this->_add_paths(clip,    ClipperLib::ptClip,    true,  safety_offset_);
+    
+    // perform operation
+    this->_execute(clipType, retval, fillType);
+}
+
+void
+ClipperContext::union_paths(const ClipperLib::Paths &input, const ClipperLib::PolyFillType fillType,
+    ClipperLib::PolyTree* retval)
+{
+    ClipperLib::Clipper &clipper = this->_reset_clipper();
+    clipper.AddPaths(input, ClipperLib::ptSubject, true);
+    this->_execute(ClipperLib::ctUnion, retval, fillType);
+}
+
+// ClipperLib::SimplifyPolygons() when not preserving collinear points
+template <class T>
+void
+ClipperContext::simplify(const Polygons &subject, bool preserve_collinear, T* retval)
+{
+    ClipperLib::Clipper &clipper = this->_reset_clipper();
+    clipper.PreserveCollinear(preserve_collinear);
+    clipper.StrictlySimple(true);
+    this->_add_paths(subject, ClipperLib::ptSubject, true, false);
+    this->_execute(ClipperLib::ctUnion, retval, ClipperLib::pftNonZero);
+}
+template void ClipperContext::simplify<ClipperLib::Paths>(const Polygons &subject, bool preserve_collinear,
+    ClipperLib::Paths* retval);
+template void ClipperContext::simplify<ClipperLib::PolyTree>(const Polygons &subject, bool preserve_collinear,
+    ClipperLib::PolyTree* retval);
+
+void
+ClipperContext::safety_offset(ClipperLib::Paths* paths)
+{
     // scale input
-    scaleClipperPolygons(input, scale);
+    scaleClipperPolygons(*paths, CLIPPER_OFFSET_SCALE);
     
-    // perform offset
-    ClipperLib::ClipperOffset co;
-    if (joinType == jtRound) {
-        co.ArcTolerance = miterLimit;
-    } else {
-        co.MiterLimit = miterLimit;
-    }
-    co.AddPaths(input, joinType, ClipperLib::etOpenButt);
-    ClipperLib::Paths retval;
-    co.Execute(retval, (delta*scale));
+    // perform offset (delta = scale 1e-05)
+    ClipperLib::ClipperOffset &co = this->_reset_offsetter(ClipperLib::jtMiter, 2);
+    co.AddPaths(*paths, ClipperLib::jtMiter, ClipperLib::etClosedPolygon);
+    co.Execute(*paths, 10.0 * CLIPPER_OFFSET_SCALE);
     
     // unscale output
-    scaleClipperPolygons(retval, 1/scale);
-    return retval;
+    scaleClipperPolygons(*paths, 1.0/CLIPPER_OFFSET_SCALE);
+}
+
+ClipperLib::Paths
+_offset(const Polygons &polygons, const float delta,
+    double scale, ClipperLib::JoinType joinType, double miterLimit)
+{
+    return ClipperContext::Lease()->offset(polygons, ClipperLib::etClosedPolygon, delta, scale, joinType, miterLimit);
+}
+
+ClipperLib::Paths
+_offset(const Polylines &polylines, const float delta,
+    double scale, ClipperLib::JoinType joinType, double miterLimit)
+{
+    return ClipperContext::Lease()->offset(polylines, ClipperLib::etOpenButt, delta, scale, joinType, miterLimit);
 }
 
 Polygons
@@ -154,10 +382,11 @@ offset(const Polygons &polygons, const float delta,
     double scale, ClipperLib::JoinType joinType, double miterLimit)
 {
     // perform offset
-    ClipperLib::Paths output = _offset(polygons, delta, scale, joinType, miterLimit);
+    ClipperContext::Lease context;
+    context->offset(polygons, ClipperLib::etClosedPolygon, delta, scale, joinType, miterLimit);
     
     // convert into Polygons
-    return ClipperPaths_to_Slic3rMultiPoints<Polygons>(output);
+    return ClipperPaths_to_Slic3rMultiPoints<Polygons>(context->output);
 }
 
 Polygons
@@ -165,10 +394,11 @@ offset(const Polylines &polylines, const float delta,
     double scale, ClipperLib::JoinType joinType, double miterLimit)
 {
     // perform offset
-    ClipperLib::Paths output = _offset(polylines, delta, scale, joinType, miterLimit);
+    ClipperContext::Lease context;
+    context->offset(polylines, ClipperLib::etOpenButt, delta, scale, joinType, miterLimit);
     
     // convert into Polygons
-    return ClipperPaths_to_Slic3rMultiPoints<Polygons>(output);
+    return ClipperPaths_to_Slic3rMultiPoints<Polygons>(context->output);
 }
 
 Surfaces
@@ -194,10 +424,12 @@ offset_ex(const Polygons &polygons, const float delta,
     double scale, ClipperLib::JoinType joinType, double miterLimit)
 {
     // perform offset
-    ClipperLib::Paths output = _offset(polygons, delta, scale, joinType, miterLimit);
+    ClipperContext::Lease context;
+    context->offset(polygons, ClipperLib::etClosedPolygon, delta, scale, joinType, miterLimit);
     
     // convert into ExPolygons
-    return ClipperPaths_to_Slic3rExPolygons(output);
+    context->union_paths(context->output, ClipperLib::pftEvenOdd, &context->polytree);
+    return PolyTreeToExPolygons(context->polytree);
 }
 
 ExPolygons
@@ -211,34 +443,7 @@ ClipperLib::Paths
 _offset2(const Polygons &polygons, const float delta1, const float delta2,
     const double scale, const ClipperLib::JoinType joinType, const double miterLimit)
 {
-    // read input
-    ClipperLib::Paths input = Slic3rMultiPoints_to_ClipperPaths(polygons);
-    
-    // scale input
-    scaleClipperPolygons(input, scale);
-    
-    // prepare ClipperOffset object
-    ClipperLib::ClipperOffset co;
-    if (joinType == jtRound) {
-        co.ArcTolerance = miterLimit;
-    } else {
-        co.MiterLimit = miterLimit;
-    }
-    
-    // perform first offset
-    ClipperLib::Paths output1;
-    co.AddPaths(input, joinType, ClipperLib::etClosedPolygon);
-    co.Execute(output1, (delta1*scale));
-    
-    // perform second offset
-    co.Clear();
-    co.AddPaths(output1, joinType, ClipperLib::etClosedPolygon);
-    ClipperLib::Paths retval;
-    co.Execute(retval, (delta2*scale));
-    
-    // unscale output
-    scaleClipperPolygons(retval, 1/scale);
-    return retval;
+    return ClipperContext::Lease()->offset2(polygons, delta1, delta2, scale, joinType, miterLimit);
 }
 
 Polygons
@@ -246,10 +451,11 @@ offset2(const Polygons &polygons, const float delta1, const float delta2,
     const double scale, const ClipperLib::JoinType joinType, const double miterLimit)
 {
     // perform offset
-    ClipperLib::Paths output = _offset2(polygons, delta1, delta2, scale, joinType, miterLimit);
+    ClipperContext::Lease context;
+    context->offset2(polygons, delta1, delta2, scale, joinType, miterLimit);
     
-    // convert into ExPolygons
-    return ClipperPaths_to_Slic3rMultiPoints<Polygons>(output);
+    // convert into Polygons
+    return ClipperPaths_to_Slic3rMultiPoints<Polygons>(context->output);
 }
 
 ExPolygons
@@ -257,140 +463,69 @@ offset2_ex(const Polygons &polygons, const float delta1, const float delta2,
     const double scale, const ClipperLib::JoinType joinType, const double miterLimit)
 {
     // perform offset
-    ClipperLib::Paths output = _offset2(polygons, delta1, delta2, scale, joinType, miterLimit);
+    ClipperContext::Lease context;
+    context->offset2(polygons, delta1, delta2, scale, joinType, miterLimit);
     
     // convert into ExPolygons
-    return ClipperPaths_to_Slic3rExPolygons(output);
+    context->union_paths(context->output, ClipperLib::pftEvenOdd, &context->polytree);
+    return PolyTreeToExPolygons(context->polytree);
 }
 
 template <class T>
 T
-_clipper_do(const ClipperLib::ClipType clipType, const Polygons &subject, 
+_clipper_do(const ClipperLib::ClipType clipType, const Polygons &subject,
     const Polygons &clip, const ClipperLib::PolyFillType fillType, const bool safety_offset_)
 {
-    // read input
-    ClipperLib::Paths input_subject = Slic3rMultiPoints_to_ClipperPaths(subject);
-    ClipperLib::Paths input_clip    = Slic3rMultiPoints_to_ClipperPaths(clip);
-    
-    // perform safety offset
-    if (safety_offset_) {
-        if (clipType == ClipperLib::ctUnion) {
-            safety_offset(&input_subject);
-        } else {
-            safety_offset(&input_clip);
-        }
-    }
-    
-    // init Clipper
-    ClipperLib::Clipper clipper;
-    clipper.Clear();
-    
-    // add polygons
-    clipper.AddPaths(input_subject, ClipperLib::ptSubject, true);
-    clipper.AddPaths(input_clip,    ClipperLib::ptClip,    true);
-    
-    // perform operation
     T retval;
-    clipper.Execute(clipType, retval, fillType, fillType);
-    return retval;
-}
-
-// The Clipper library has difficulties processing overlapping polygons.
-// Namely, the function Clipper::JoinCommonEdges() has potentially a terrible time complexity if the output
-// of the operation is of the PolyTree type.
-// This function implements a following workaround:
-// 1) Peform the Clipper operation with the output to Paths. This method handles overlaps in a reasonable time.
-// 2) Run Clipper Union once again to extract the PolyTree from the result of 1).
-inline ClipperLib::PolyTree _clipper_do_polytree2(const ClipperLib::ClipType clipType, const Polygons &subject, 
-    const Polygons &clip, const ClipperLib::PolyFillType fillType, const bool safety_offset_)
-{
-    // read input
-    ClipperLib::Paths input_subject = Slic3rMultiPoints_to_ClipperPaths(subject);
-    ClipperLib::Paths input_clip    = Slic3rMultiPoints_to_ClipperPaths(clip);
-    
-    // perform safety offset
-    if (safety_offset_) {
-        if (clipType == ClipperLib::ctUnion) {
-            safety_offset(&input_subject);
-        } else {
-            safety_offset(&input_clip);
-        }
-    }
-    
-    ClipperLib::Clipper clipper;
-    clipper.AddPaths(input_subject, ClipperLib::ptSubject, true);
-    clipper.AddPaths(input_clip,    ClipperLib::ptClip,    true);
-    // Perform the operation with the output to input_subject.
-    // This pass does not generate a PolyTree, which is a very expensive operation with the current Clipper library
-    // if there are overlapping edges.
-    clipper.Execute(clipType, input_subject, fillType, fillType);
-    // Perform an additional Union operation to generate the PolyTree ordering.
-    clipper.Clear();
-    clipper.AddPaths(input_subject, ClipperLib::ptSubject, true);
-    ClipperLib::PolyTree retval;
-    clipper.Execute(ClipperLib::ctUnion, retval, fillType, fillType);
+    ClipperContext::Lease()->clip(clipType, subject, clip, fillType, safety_offset_, &retval);
     return retval;
 }
 
 ClipperLib::PolyTree
-_clipper_do(const ClipperLib::ClipType clipType, const Polylines &subject, 
+_clipper_do(const ClipperLib::ClipType clipType, const Polylines &subject,
     const Polygons &clip, const ClipperLib::PolyFillType fillType,
     const bool safety_offset_)
 {
-    // read input
-    ClipperLib::Paths input_subject = Slic3rMultiPoints_to_ClipperPaths(subject);
-    ClipperLib::Paths input_clip    = Slic3rMultiPoints_to_ClipperPaths(clip);
-    
-    // perform safety offset
-    if (safety_offset_) safety_offset(&input_clip);
-    
-    // init Clipper
-    ClipperLib::Clipper clipper;
-    clipper.Clear();
-    
-    // add polygons
-    clipper.AddPaths(input_subject, ClipperLib::ptSubject, false);
-    clipper.AddPaths(input_clip,    ClipperLib::ptClip,    true);
-    
-    // perform operation
     ClipperLib::PolyTree retval;
-    clipper.Execute(clipType, retval, fillType, fillType);
+    ClipperContext::Lease()->clip(clipType, subject, clip, fillType, safety_offset_, &retval);
     return retval;
 }
 
 Polygons
-_clipper(ClipperLib::ClipType clipType, const Polygons &subject, 
+_clipper(ClipperLib::ClipType clipType, const Polygons &subject,
     const Polygons &clip, bool safety_offset_)
 {
     // perform operation
-    ClipperLib::Paths output = _clipper_do<ClipperLib::Paths>(clipType, subject, clip, ClipperLib::pftNonZero, safety_offset_);
+    ClipperContext::Lease context;
+    context->clip(clipType, subject, clip, ClipperLib::pftNonZero, safety_offset_, &context->output);
     
     // convert into Polygons
-    return ClipperPaths_to_Slic3rMultiPoints<Polygons>(output);
+    return ClipperPaths_to_Slic3rMultiPoints<Polygons>(context->output);
 }
 
 ExPolygons
-_clipper_ex(ClipperLib::ClipType clipType, const Polygons &subject, 
+_clipper_ex(ClipperLib::ClipType clipType, const Polygons &subject,
     const Polygons &clip, bool safety_offset_)
 {
     // perform operation
-    ClipperLib::PolyTree polytree = _clipper_do_polytree2(clipType, subject, clip, ClipperLib::pftNonZero, safety_offset_);
+    ClipperContext::Lease context;
+    context->clip_polytree2(clipType, subject, clip, ClipperLib::pftNonZero, safety_offset_, &context->polytree);
     
     // convert into ExPolygons
-    return PolyTreeToExPolygons(polytree);
+    return PolyTreeToExPolygons(context->polytree);
 }
 
 Polylines
-_clipper_pl(ClipperLib::ClipType clipType, const Polylines &subject, 
+_clipper_pl(ClipperLib::ClipType clipType, const Polylines &subject,
     const Polygons &clip, bool safety_offset_)
 {
     // perform operation
-    ClipperLib::PolyTree polytree = _clipper_do(clipType, subject, clip, ClipperLib::pftNonZero, safety_offset_);
+    ClipperContext::Lease context;
+    context->clip(clipType, subject, clip, ClipperLib::pftNonZero, safety_offset_, &context->polytree);
     
     // convert into Polylines
-    ClipperLib::Paths output;
-    ClipperLib::PolyTreeToPaths(polytree, output);
-    return ClipperPaths_to_Slic3rMultiPoints<Polylines>(output);
+    ClipperLib::PolyTreeToPaths(context->polytree, context->output);
+    return ClipperPaths_to_Slic3rMultiPoints<Polylines>(context->output);
 }
 
 Polylines
@@ -511,22 +646,11 @@ traverse_pt(ClipperLib::PolyNodes &nodes, Polygons* retval)
 Polygons
 simplify_polygons(const Polygons &subject, bool preserve_collinear)
 {
-    // convert into Clipper polygons
-    ClipperLib::Paths input_subject = Slic3rMultiPoints_to_ClipperPaths(subject);
-    
-    ClipperLib::Paths output;
-    if (preserve_collinear) {
-        ClipperLib::Clipper c;
-        c.PreserveCollinear(true);
-        c.StrictlySimple(true);
-        c.AddPaths(input_subject, ClipperLib::ptSubject, true);
-        c.Execute(ClipperLib::ctUnion, output, ClipperLib::pftNonZero, ClipperLib::pftNonZero);
-    } else {
-        ClipperLib::SimplifyPolygons(input_subject, output, ClipperLib::pftNonZero);
-    }
+    ClipperContext::Lease context;
+    context->simplify(subject, preserve_collinear, &context->output);
     
     // convert into Slic3r polygons
-    return ClipperPaths_to_Slic3rMultiPoints<Polygons>(output);
+    return ClipperPaths_to_Slic3rMultiPoints<Polygons>(context->output);
 }
 
 ExPolygons
@@ -536,34 +660,166 @@ simplify_polygons_ex(const Polygons &subject, bool preserve_collinear)
         return union_ex(simplify_polygons(subject, preserve_collinear));
     }
     
-    // convert into Clipper polygons
-    ClipperLib::Paths input_subject = Slic3rMultiPoints_to_ClipperPaths(subject);
-    
-    ClipperLib::PolyTree polytree;
-    
-    ClipperLib::Clipper c;
-    c.PreserveCollinear(true);
-    c.StrictlySimple(true);
-    c.AddPaths(input_subject, ClipperLib::ptSubject, true);
-    c.Execute(ClipperLib::ctUnion, polytree, ClipperLib::pftNonZero, ClipperLib::pftNonZero);
+    ClipperContext::Lease context;
+    context->simplify(subject, preserve_collinear, &context->polytree);
     
     // convert into ExPolygons
-    return PolyTreeToExPolygons(polytree);
+    return PolyTreeToExPolygons(context->polytree);
 }
 
 void safety_offset(ClipperLib::Paths* paths)
 {
-    // scale input
-    scaleClipperPolygons(*paths, CLIPPER_OFFSET_SCALE);
+    ClipperContext::Lease()->safety_offset(paths);
+}
+
+// Numbers the clusters of transitively overlapping bounding boxes (grown by margin) of the
+// subject and clip polygons in the order of their first polygon. Sets cluster[i] to the
+// cluster of polygon i, subject polygons first, or to -1 for the polygons without points.
+// Returns the number of clusters.
+static size_t
+cluster_polygons(const Polygons &subject, const Polygons &clip, coord_t margin, std::vector<int>* cluster)
+{
+    const size_t count = subject.size() + clip.size();
+    std::vector<BoundingBox> boxes(count);
+    std::vector<size_t> order;
+    order.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const Polygon &polygon = (i < subject.size()) ? subject[i] : clip[i - subject.size()];
+        if (polygon.points.empty()) continue;
+        boxes[i] = BoundingBox(polygon.points);
+        boxes[i].min.translate(-margin, -margin);
+        boxes[i].max.translate(margin, margin);
+        order.push_back(i);
+    }
     
-    // perform offset (delta = scale 1e-05)
-    ClipperLib::ClipperOffset co;
-    co.MiterLimit = 2;
-    co.AddPaths(*paths, ClipperLib::jtMiter, ClipperLib::etClosedPolygon);
-    co.Execute(*paths, 10.0 * CLIPPER_OFFSET_SCALE);
+    // union-find over the pairs of overlapping boxes, found by sweeping along x
+    std::vector<size_t> parent(count);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&parent](size_t i) {
+        while (parent[i] != i)
+            i = parent[i] = parent[parent[i]];
+        return i;
+    };
+    std::sort(order.begin(), order.end(),
+        [&boxes](size_t a, size_t b) { return boxes[a].min.x < boxes[b].min.x; });
+    std::vector<size_t> active;
+    for (size_t i : order) {
+        const BoundingBox &box = boxes[i];
+        size_t kept = 0;
+        for (size_t j : active) {
+            // the boxes still to come start right of this one as well
+            if (boxes[j].max.x < box.min.x) continue;
+            active[kept++] = j;
+            if (boxes[j].overlap(box))
+                parent[find(i)] = find(j);
+        }
+        active.resize(kept);
+        active.push_back(i);
+    }
     
-    // unscale output
-    scaleClipperPolygons(*paths, 1.0/CLIPPER_OFFSET_SCALE);
+    cluster->assign(count, -1);
+    for (size_t i : order)
+        (*cluster)[i] = 0;
+    std::vector<int> number(count, -1);
+    size_t clusters = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if ((*cluster)[i] < 0) continue;
+        const size_t root = find(i);
+        if (number[root] < 0) number[root] = int(clusters++);
+        (*cluster)[i] = number[root];
+    }
+    return clusters;
+}
+
+// The safety offset orients all the polygons it grows after the one with the lowest point
+// (see ClipperOffset::FixOrientations()). Returns true if that polygon is oriented the same
+// way in every cluster as in the whole set, that is if the clusters can be grown apart.
+static bool
+same_lowest_orientation(const Polygons &polygons, const int* cluster, size_t clusters)
+{
+    // the lowest point of every cluster (and of the whole set, last), and whether its
+    // polygon is counter-clockwise
+    std::vector<const Point*> lowest(clusters + 1, NULL);
+    std::vector<bool> ccw(clusters + 1, false);
+    for (size_t i = 0; i < polygons.size(); ++i) {
+        if (cluster[i] < 0) continue;
+        const Points &points = polygons[i].points;
+    
+        // ClipperOffset skips the polygons with less than 3 distinct vertices
+        size_t vertices = 0;
+        const Point* low = &points.front();
+        for (size_t j = 0; j < points.size(); ++j) {
+            const Point &prev = points[(j == 0) ? points.size() - 1 : j - 1];
+            if (points[j].x != prev.x || points[j].y != prev.y) ++vertices;
+            if (points[j].y > low->y || (points[j].y == low->y && points[j].x < low->x)) low = &points[j];
+        }
+        if (vertices < 3) continue;
+    
+        const size_t slots[2] = { size_t(cluster[i]), clusters };
+        for (size_t slot : slots) {
+            const Point* &l = lowest[slot];
+            if (l == NULL || low->y > l->y || (low->y == l->y && low->x < l->x)) {
+                l = low;
+                ccw[slot] = polygons[i].is_counter_clockwise();
+            }
+        }
+    }
+    for (size_t i = 0; i < clusters; ++i)
+        if (lowest[i] != NULL && ccw[i] != ccw[clusters]) return false;
+    return true;
+}
+
+template <class T>
+static T
+clipper_clustered(T (*clipper)(ClipperLib::ClipType, const Polygons&, const Polygons&, bool),
+    ClipperLib::ClipType clipType, const Polygons &subject, const Polygons &clip, bool safety_offset_)
+{
+    // The safety offset grows the polygons by 10 units, twice that at the miters, so boxes
+    // closer than that may still merge.
+    std::vector<int> cluster;
+    const size_t clusters = cluster_polygons(subject, clip, safety_offset_ ? 32 : 0, &cluster);
+    if (clusters <= 1
+        || (safety_offset_ && (clipType == ClipperLib::ctUnion
+            ? !same_lowest_orientation(subject, cluster.data(), clusters)
+            : !same_lowest_orientation(clip, cluster.data() + subject.size(), clusters))))
+        return clipper(clipType, subject, clip, safety_offset_);
+    
+    // split the operands by cluster
+    std::vector<Polygons> subjects(clusters), clips(clusters);
+    for (size_t i = 0; i < subject.size(); ++i)
+        if (cluster[i] >= 0)
+            subjects[cluster[i]].push_back(subject[i]);
+    for (size_t i = 0; i < clip.size(); ++i)
+        if (cluster[subject.size() + i] >= 0)
+            clips[cluster[subject.size() + i]].push_back(clip[i]);
+    
+    // A cluster without subject polygons only matters to a union, and one without clip
+    // polygons is all that an intersection removes.
+    std::vector<T> results(clusters);
+    parallel_for(size_t(0), clusters, [&](size_t i) {
+        if (clipType != ClipperLib::ctUnion && subjects[i].empty()) return;
+        if (clipType == ClipperLib::ctIntersection && clips[i].empty()) return;
+        results[i] = clipper(clipType, subjects[i], clips[i], safety_offset_);
+    }, 1);
+    
+    T retval;
+    for (T &result : results)
+        retval.insert(retval.end(), std::make_move_iterator(result.begin()), std::make_move_iterator(result.end()));
+    return retval;
+}
+
+Polygons
+_clipper_clustered(ClipperLib::ClipType clipType, const Polygons &subject,
+    const Polygons &clip, bool safety_offset_)
+{
+    return clipper_clustered<Polygons>(_clipper, clipType, subject, clip, safety_offset_);
+}
+
+ExPolygons
+_clipper_clustered_ex(ClipperLib::ClipType clipType, const Polygons &subject,
+    const Polygons &clip, bool safety_offset_)
+{
+    return clipper_clustered<ExPolygons>(_clipper_ex, clipType, subject, clip, safety_offset_);
 }
 
 }
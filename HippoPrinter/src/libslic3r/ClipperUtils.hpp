@@ -6,6 +6,8 @@
 #include "ExPolygon.hpp"
 #include "Polygon.hpp"
 #include "Surface.hpp"
+#include <cstddef>
+#include <memory>
 
 // import these wherever we're included
 using ClipperLib::jtMiter;
@@ -14,7 +16,7 @@ using ClipperLib::jtSquare;
 
 namespace Slic3r {
 
-// Factor to convert from coord_t (which is int32) to an int64 type used by the Clipper library.
+// Factor to scale coord_t up for the offsets by the Clipper library, to reduce the rounding errors.
 //FIXME Vojtech: Better to use a power of 2 coefficient and to use bit shifts for scaling.
 // How about 2^17=131072?
 // By the way, is the scalling needed at all? Cura runs all the computation with a fixed point precision of 1um, while Slic3r scales to 1nm,
@@ -28,6 +30,19 @@ void AddOuterPolyNodeToExPolygons(ClipperLib::PolyNode& polynode, Slic3r::ExPoly
 void PolyTreeToExPolygons(ClipperLib::PolyTree& polytree, Slic3r::ExPolygons& expolygons);
 //-----------------------------------------------------------
 
+#ifndef use_xyz
+// Without the Z coordinate (use_xyz) ClipperLib::IntPoint shares its layout with Point,
+// so that the points of a path are handed to Clipper and taken back as they are.
+static_assert(sizeof(Slic3r::Point) == sizeof(ClipperLib::IntPoint)
+    && offsetof(Slic3r::Point, x) == offsetof(ClipperLib::IntPoint, X)
+    && offsetof(Slic3r::Point, y) == offsetof(ClipperLib::IntPoint, Y),
+    "Point and ClipperLib::IntPoint have to share their layout");
+inline const ClipperLib::IntPoint* Slic3rPoints_to_ClipperPoints(const Slic3r::Points &points)
+    { return reinterpret_cast<const ClipperLib::IntPoint*>(points.data()); }
+inline const Slic3r::Point* ClipperPoints_to_Slic3rPoints(const ClipperLib::Path &path)
+    { return reinterpret_cast<const Slic3r::Point*>(path.data()); }
+#endif
+
 ClipperLib::Path Slic3rMultiPoint_to_ClipperPath(const Slic3r::MultiPoint &input);
 template <class T>
 ClipperLib::Paths Slic3rMultiPoints_to_ClipperPaths(const T &input);
@@ -39,6 +54,79 @@ Slic3r::ExPolygons ClipperPaths_to_Slic3rExPolygons(const ClipperLib::Paths &inp
 
 void scaleClipperPolygons(ClipperLib::Paths &polygons, const double scale);
 
+// Clipper engines and scratch paths reused by the operations below. Every thread keeps
+// one context, so that the dozens of small operations issued per layer by the perimeter
+// and support generators do not construct the engines and allocate the input and output
+// paths again each time. The results are exactly those of one-shot engines.
+class ClipperContext
+{
+    public:
+    // The context of the calling thread while the lease lives, or a private one
+    // if the context of this thread is leased already further up the stack.
+    class Lease
+    {
+        public:
+        Lease();
+        ~Lease();
+        ClipperContext* operator->() const { return this->_context; };
+        ClipperContext& operator*() const { return *this->_context; };
+        
+        private:
+        ClipperContext* _context;
+        ClipperContext* _owned;
+        
+        Lease(const Lease &);
+        Lease& operator=(const Lease &);
+    };
+    
+    // scratch results, valid until the next operation on the context
+    ClipperLib::Paths output;
+    ClipperLib::PolyTree polytree;
+    
+    // offset of Polygons or Polylines, unscaled result in this->output
+    template <class T>
+    ClipperLib::Paths& offset(const T &input, ClipperLib::EndType endType, const float delta,
+        double scale, ClipperLib::JoinType joinType, double miterLimit);
+    ClipperLib::Paths& offset2(const Slic3r::Polygons &polygons, const float delta1,
+        const float delta2, double scale, ClipperLib::JoinType joinType, double miterLimit);
+    
+    // T is ClipperLib::Paths or ClipperLib::PolyTree
+    template <class T>
+    void clip(ClipperLib::ClipType clipType, const Slic3r::Polygons &subject,
+        const Slic3r::Polygons &clip, const ClipperLib::PolyFillType fillType,
+        bool safety_offset_, T* retval);
+    // same, collecting the result as paths first and ordering it by another union
+    void clip_polytree2(ClipperLib::ClipType clipType, const Slic3r::Polygons &subject,
+        const Slic3r::Polygons &clip, const ClipperLib::PolyFillType fillType,
+        bool safety_offset_, ClipperLib::PolyTree* retval);
+    void clip(ClipperLib::ClipType clipType, const Slic3r::Polylines &subject,
+        const Slic3r::Polygons &clip, const ClipperLib::PolyFillType fillType,
+        bool safety_offset_, ClipperLib::PolyTree* retval);
+    void union_paths(const ClipperLib::Paths &input, const ClipperLib::PolyFillType fillType,
+        ClipperLib::PolyTree* retval);
+    template <class T>
+    void simplify(const Slic3r::Polygons &subject, bool preserve_collinear, T* retval);
+    void safety_offset(ClipperLib::Paths* paths);
+    
+    private:
+    std::unique_ptr<ClipperLib::Clipper> _clipper;
+    ClipperLib::ClipperOffset _offsetter;
+    ClipperLib::Paths _subject, _clip, _scratch;
+    bool _leased;
+    
+    ClipperContext() : _clipper(new ClipperLib::Clipper()), _leased(false) {};
+    ClipperContext(const ClipperContext &);
+    ClipperContext& operator=(const ClipperContext &);
+    
+    ClipperLib::Clipper& _reset_clipper();
+    ClipperLib::ClipperOffset& _reset_offsetter(ClipperLib::JoinType joinType, double miterLimit);
+    template <class T>
+    void _add_paths(const T &input, ClipperLib::PolyType polyType, bool closed, bool safety_offset_);
+    template <class T>
+    void _execute(ClipperLib::ClipType clipType, T* solution, ClipperLib::PolyFillType fillType);
+    static ClipperContext& _thread_context();
+};
+
 // offset Polygons
 ClipperLib::Paths _offset(const Slic3r::Polygons &polygons, const float delta,
     double scale = CLIPPER_OFFSET_SCALE, ClipperLib::JoinType joinType = ClipperLib::jtMiter, 
@@ -221,6 +309,54 @@ Slic3r::ExPolygons simplify_polygons_ex(const Slic3r::Polygons &subject, bool pr
 
 void safety_offset(ClipperLib::Paths* paths);
 
+/* CLUSTERED */
+// Boolean operations for large polygon sets. The polygons of both operands are grouped
+// into clusters of overlapping bounding boxes, the clusters are clipped independently
+// (in parallel), and the ones that cannot add anything to the result, like clip polygons
+// far from any subject polygon, are dropped before reaching Clipper. The result covers the
+// same area as the one of _clipper() / _clipper_ex(), but its polygons may come in
+// another order.
+Slic3r::Polygons _clipper_clustered(ClipperLib::ClipType clipType,
+    const Slic3r::Polygons &subject, const Slic3r::Polygons &clip, bool safety_offset_ = false);
+Slic3r::ExPolygons _clipper_clustered_ex(ClipperLib::ClipType clipType,
+    const Slic3r::Polygons &subject, const Slic3r::Polygons &clip, bool safety_offset_ = false);
+
+inline Slic3r::Polygons
+diff_clustered(const Slic3r::Polygons &subject, const Slic3r::Polygons &clip, bool safety_offset_ = false)
+{
+    return _clipper_clustered(ClipperLib::ctDifference, subject, clip, safety_offset_);
+}
+
+inline Slic3r::ExPolygons
+diff_clustered_ex(const Slic3r::Polygons &subject, const Slic3r::Polygons &clip, bool safety_offset_ = false)
+{
+    return _clipper_clustered_ex(ClipperLib::ctDifference, subject, clip, safety_offset_);
+}
+
+inline Slic3r::Polygons
+intersection_clustered(const Slic3r::Polygons &subject, const Slic3r::Polygons &clip, bool safety_offset_ = false)
+{
+    return _clipper_clustered(ClipperLib::ctIntersection, subject, clip, safety_offset_);
+}
+
+inline Slic3r::ExPolygons
+intersection_clustered_ex(const Slic3r::Polygons &subject, const Slic3r::Polygons &clip, bool safety_offset_ = false)
+{
+    return _clipper_clustered_ex(ClipperLib::ctIntersection, subject, clip, safety_offset_);
+}
+
+inline Slic3r::Polygons
+union_clustered(const Slic3r::Polygons &subject, bool safety_offset_ = false)
+{
+    return _clipper_clustered(ClipperLib::ctUnion, subject, Slic3r::Polygons(), safety_offset_);
+}
+
+inline Slic3r::ExPolygons
+union_clustered_ex(const Slic3r::Polygons &subject, bool safety_offset_ = false)
+{
+    return _clipper_clustered_ex(ClipperLib::ctUnion, subject, Slic3r::Polygons(), safety_offset_);
+}
+
 }
 
 #endif
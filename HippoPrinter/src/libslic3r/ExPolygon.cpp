@@ -112,6 +112,32 @@ ExPolygon::contains(const Point &point) const
     return true;
 }
 
+// contains() for many points at once
+std::vector<bool>
+ExPolygon::contains(const Points &points) const
+{
+    std::vector<size_t> order(points.size());
+    for (size_t k = 0; k < order.size(); ++k) order[k] = k;
+    std::sort(order.begin(), order.end(), [&points](size_t a, size_t b) { return points[a].y < points[b].y; });
+    Points points_by_y;
+    points_by_y.reserve(points.size());
+    for (size_t k : order) points_by_y.push_back(points[k]);
+    
+    std::vector<unsigned char> inside(points.size(), 0);
+    this->contour.toggle_crossings(points_by_y, &inside);
+    std::vector<unsigned char> in_hole;
+    for (Polygons::const_iterator it = this->holes.begin(); it != this->holes.end(); ++it) {
+        in_hole.assign(points.size(), 0);
+        it->toggle_crossings(points_by_y, &in_hole);
+        for (size_t k = 0; k < points.size(); ++k)
+            inside[k] &= (unsigned char)!in_hole[k];
+    }
+    
+    std::vector<bool> result(points.size());
+    for (size_t k = 0; k < order.size(); ++k) result[order[k]] = inside[k] != 0;
+    return result;
+}
+
 // inclusive version of contains() that also checks whether point is on boundaries
 bool
 ExPolygon::contains_b(const Point &point) const
@@ -187,6 +213,13 @@ ExPolygon::simplify(double tolerance, ExPolygons* expolygons) const
 void
 ExPolygon::medial_axis(double max_width, double min_width, ThickPolylines* polylines) const
 {
+    // an identical expolygon was processed lately (typically on the previous layer)
+    Slic3r::Geometry::MedialAxisCache &cache = Slic3r::Geometry::MedialAxisCache::thread_cache();
+    if (const ThickPolylines* cached = cache.find(*this, max_width, min_width)) {
+        polylines->insert(polylines->end(), cached->begin(), cached->end());
+        return;
+    }
+    
     // init helper object
     Slic3r::Geometry::MedialAxis ma(max_width, min_width, this);
     ma.lines = this->lines();
@@ -294,6 +327,7 @@ ExPolygon::medial_axis(double max_width, double min_width, ThickPolylines* polyl
         }
     }
     
+    cache.insert(*this, max_width, min_width, pp);
     polylines->insert(polylines->end(), pp.begin(), pp.end());
 }
 
@@ -29,6 +29,7 @@ class ExPolygon
     bool contains(const Line &line) const;
     bool contains(const Polyline &polyline) const;
     bool contains(const Point &point) const;
+    std::vector<bool> contains(const Points &points) const;
     bool contains_b(const Point &point) const;
     bool has_boundary_point(const Point &point) const;
     BoundingBox bounding_box() const { return this->contour.bounding_box(); };
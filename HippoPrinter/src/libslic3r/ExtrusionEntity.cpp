@@ -4,12 +4,127 @@
 #include "ClipperUtils.hpp"
 #include "Extruder.hpp"
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <limits>
+#include <new>
 #include <sstream>
+#include <stdint.h>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <boost/align/aligned_alloc.hpp>
+#endif
 
 namespace Slic3r {
-    
+
+// Entities of up to 256 bytes are carved, in 16 byte steps, out of 64 kB chunks: each
+// thread takes them one after the other from its current chunk and a chunk goes back
+// to the heap when the last of its blocks is freed, by whatever thread. The freed
+// blocks are not reused. The toolpaths of a layer are made together by the worker
+// processing it and fill whole chunks, which are released when the layer is dropped,
+// as a per-layer arena would be. Tying the memory to the layers explicitly is not
+// possible: entities are cloned and moved between the layers (the copied perimeters
+// and fills, the chaining of the paths, the G-code) and freed from any thread.
+namespace {
+
+const size_t POOL_BLOCK_STEP  = 16;
+const size_t POOL_MAX_BLOCK   = 256;
+// also the alignment of the chunks, for finding the chunk of a block, and the allocation
+// granularity of VirtualAlloc
+const size_t POOL_CHUNK_SIZE  = 64 * 1024;
+
+// at the start of a chunk, followed by the blocks
+struct PoolChunk {
+    // blocks in use, plus one while the chunk is the current one of a thread
+    std::atomic<size_t> refs;
+};
+
+const size_t POOL_HEADER_SIZE = (sizeof(PoolChunk) + POOL_BLOCK_STEP - 1) / POOL_BLOCK_STEP * POOL_BLOCK_STEP;
+
+// VirtualAlloc hands out whole 64 kB aligned regions, while _aligned_malloc, behind
+// aligned_alloc on MSVC, would allocate twice the chunk size to align it
+void* pool_chunk_alloc()
+{
+#ifdef _WIN32
+    return VirtualAlloc(NULL, POOL_CHUNK_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    return boost::alignment::aligned_alloc(POOL_CHUNK_SIZE, POOL_CHUNK_SIZE);
+#endif
+}
+
+void pool_chunk_free(void* memory)
+{
+#ifdef _WIN32
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    boost::alignment::aligned_free(memory);
+#endif
+}
+
+void pool_release(PoolChunk* chunk)
+{
+    if (chunk->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        chunk->~PoolChunk();
+        pool_chunk_free(chunk);
+    }
+}
+
+struct ThreadCache {
+    PoolChunk* chunk;
+    size_t     used;
+    ThreadCache() : chunk(NULL), used(0) {};
+    // the chunk of an exiting thread is freed with its last block
+    ~ThreadCache() {
+        if (this->chunk != NULL)
+            pool_release(this->chunk);
+    };
+};
+
+thread_local ThreadCache thread_cache;
+
+}
+
+void*
+ExtrusionEntity::operator new(size_t size)
+{
+    if (size > POOL_MAX_BLOCK)
+        return ::operator new(size);
+    const size_t block_size = (size + POOL_BLOCK_STEP - 1) / POOL_BLOCK_STEP * POOL_BLOCK_STEP;
+    ThreadCache &cache = thread_cache;
+    if (cache.chunk == NULL || cache.used + block_size > POOL_CHUNK_SIZE) {
+        void* memory = pool_chunk_alloc();
+        if (memory == NULL)
+            throw std::bad_alloc();
+        PoolChunk* chunk = new (memory) PoolChunk();
+        chunk->refs.store(1, std::memory_order_relaxed);
+        if (cache.chunk != NULL)
+            pool_release(cache.chunk);
+        cache.chunk = chunk;
+        cache.used  = POOL_HEADER_SIZE;
+    }
+    cache.chunk->refs.fetch_add(1, std::memory_order_relaxed);
+    void* block = reinterpret_cast<char*>(cache.chunk) + cache.used;
+    cache.used += block_size;
+    return block;
+}
+
+void
+ExtrusionEntity::operator delete(void* ptr, size_t size)
+{
+    if (ptr == NULL)
+        return;
+    if (size > POOL_MAX_BLOCK) {
+        ::operator delete(ptr);
+        return;
+    }
+    pool_release(reinterpret_cast<PoolChunk*>(reinterpret_cast<uintptr_t>(ptr) & ~uintptr_t(POOL_CHUNK_SIZE - 1)));
+}
+
 void
 ExtrusionPath::intersect_expolygons(const ExPolygonCollection &collection, ExtrusionEntityCollection* retval) const
 {
@@ -52,6 +52,12 @@ public:
 	virtual Polyline as_polyline() const = 0;
 	virtual double length() const { return 0; };
 
+	// The entities of the layers are created and destroyed by the million by the threads
+	// working on the layers. They are carved out of per-thread chunks, so the threads do
+	// not contend for the heap, and the chunks are freed as a whole once all their
+	// entities are, so destroying a layer is cheap and gives its memory back.
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr, size_t size);
 };
 
 typedef std::vector<ExtrusionEntity*> ExtrusionEntitiesPtr;
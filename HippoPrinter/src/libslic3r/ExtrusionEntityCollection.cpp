@@ -1,7 +1,7 @@
 #include "ExtrusionEntityCollection.hpp"
+#include "NearestPointIndex.hpp"
 #include <algorithm>
 #include <cmath>
-#include <map>
 
 namespace Slic3r {
 
@@ -49,8 +49,8 @@ ExtrusionEntityCollection::operator ExtrusionPaths() const
 {
 	ExtrusionPaths paths;
 	for (ExtrusionEntitiesPtr::const_iterator it = this->entities.begin(); it != this->entities.end(); ++it) {
-		if (const ExtrusionPath* path = dynamic_cast<const ExtrusionPath*>(*it))
-			paths.push_back(*path);
+		if (!(*it)->is_collection() && !(*it)->is_loop())
+			paths.push_back(*static_cast<const ExtrusionPath*>(*it));
 	}
 	return paths;
 }
@@ -158,15 +158,9 @@ ExtrusionEntityCollection::chained_path_from(Point start_near, ExtrusionEntityCo
 	retval->entities.reserve(this->entities.size());
 	retval->orig_indices.reserve(this->entities.size());
 	
-	// if we're asked to return the original indices, build a map
-	std::map<ExtrusionEntity*,size_t> indices_map;
-	
 	ExtrusionEntitiesPtr my_paths;
-	for (ExtrusionEntitiesPtr::const_iterator it = this->entities.begin(); it != this->entities.end(); ++it) {
-		ExtrusionEntity* entity = (*it)->clone();
-		my_paths.push_back(entity);
-		if (orig_indices != NULL) indices_map[entity] = it - this->entities.begin();
-	}
+	for (ExtrusionEntitiesPtr::const_iterator it = this->entities.begin(); it != this->entities.end(); ++it)
+		my_paths.push_back((*it)->clone());
 	
 	Points endpoints;
 	for (ExtrusionEntitiesPtr::iterator it = my_paths.begin(); it != my_paths.end(); ++it) {
@@ -178,20 +172,21 @@ ExtrusionEntityCollection::chained_path_from(Point start_near, ExtrusionEntityCo
 		}
 	}
 	
-	while (!my_paths.empty()) {
+	NearestPointIndex index(endpoints, NearestPointIndex::tbHighestIndex);
+	while (!index.empty()) {
 		// find nearest point
-		int start_index = start_near.nearest_point_index(endpoints);
-		int path_index = start_index/2;
+		size_t start_index = index.nearest(start_near);
+		size_t path_index = start_index/2;
 		ExtrusionEntity* entity = my_paths.at(path_index);
 		// never reverse loops, since it's pointless for chained path and callers might depend on orientation
 		if (start_index % 2 && !no_reverse && entity->can_reverse()) {
 			entity->reverse();
 		}
-		retval->entities.push_back(my_paths.at(path_index));
-		if (orig_indices != NULL) orig_indices->push_back(indices_map[entity]);
-		my_paths.erase(my_paths.begin() + path_index);
-		endpoints.erase(endpoints.begin() + 2*path_index, endpoints.begin() + 2*path_index + 2);
-		start_near = retval->entities.back()->last_point();
+		retval->entities.push_back(entity);
+		if (orig_indices != NULL) orig_indices->push_back(path_index);
+		index.remove(2*path_index);
+		index.remove(2*path_index + 1);
+		start_near = entity->last_point();
 	}
 }
 
@@ -211,7 +206,7 @@ ExtrusionEntityCollection::items_count() const
 	size_t count = 0;
 	for (ExtrusionEntitiesPtr::const_iterator it = this->entities.begin(); it != this->entities.end(); ++it) {
 		if ((*it)->is_collection()) {
-			ExtrusionEntityCollection* collection = dynamic_cast<ExtrusionEntityCollection*>(*it);
+			const ExtrusionEntityCollection* collection = static_cast<const ExtrusionEntityCollection*>(*it);
 			count += collection->items_count();
 		} else {
 			++count;
@@ -226,7 +221,7 @@ ExtrusionEntityCollection::flatten(ExtrusionEntityCollection* retval) const
 {
 	for (ExtrusionEntitiesPtr::const_iterator it = this->entities.begin(); it != this->entities.end(); ++it) {
 		if ((*it)->is_collection()) {
-			ExtrusionEntityCollection* collection = dynamic_cast<ExtrusionEntityCollection*>(*it);
+			const ExtrusionEntityCollection* collection = static_cast<const ExtrusionEntityCollection*>(*it);
 			retval->append(collection->flatten().entities);
 		} else {
 			retval->append(**it);
@@ -264,5 +259,76 @@ ExtrusionEntityCollection::count()const {
 	return entities.size();
 }
 
+FlatExtrusions::FlatExtrusions(const ExtrusionEntity &entity)
+	: point_offsets(1, 0)
+{
+	this->append(entity);
+}
+
+void
+FlatExtrusions::append(const ExtrusionEntity &entity)
+{
+	const size_t idx = this->entities.size();
+	Entity flat;
+	flat.first_path = this->paths_count();
+	flat.loop_role = elrDefault;
+	flat.no_sort = false;
+	if (entity.is_collection()) {
+		const ExtrusionEntityCollection &collection = static_cast<const ExtrusionEntityCollection&>(entity);
+		flat.type = feCollection;
+		flat.no_sort = collection.no_sort;
+		this->entities.push_back(flat);
+		for (ExtrusionEntitiesPtr::const_iterator it = collection.entities.begin(); it != collection.entities.end(); ++it)
+			this->append(**it);
+	} else if (entity.is_loop()) {
+		const ExtrusionLoop &loop = static_cast<const ExtrusionLoop&>(entity);
+		flat.type = feLoop;
+		flat.loop_role = loop.role;
+		this->entities.push_back(flat);
+		for (ExtrusionPaths::const_iterator path = loop.paths.begin(); path != loop.paths.end(); ++path)
+			this->_append_path(*path);
+	} else {
+		flat.type = fePath;
+		this->entities.push_back(flat);
+		this->_append_path(static_cast<const ExtrusionPath&>(entity));
+	}
+	this->entities[idx].last_path = this->paths_count();
+	this->entities[idx].last_entity = this->entities.size();
+}
+
+void
+FlatExtrusions::_append_path(const ExtrusionPath &path)
+{
+	this->roles.push_back(path.role);
+	this->mm3_per_mm.push_back(path.mm3_per_mm);
+	this->widths.push_back(path.width);
+	this->heights.push_back(path.height);
+	this->points.insert(this->points.end(), path.polyline.points.begin(), path.polyline.points.end());
+	this->point_offsets.push_back(this->points.size());
+}
+
+void
+FlatExtrusions::clear()
+{
+	this->roles.clear();
+	this->mm3_per_mm.clear();
+	this->widths.clear();
+	this->heights.clear();
+	this->point_offsets.assign(1, 0);
+	this->points.clear();
+	this->entities.clear();
+}
+
+bool
+FlatExtrusions::is_solid_infill(size_t entity) const
+{
+	const Entity &flat = this->entities[entity];
+	if (flat.first_path == flat.last_path) return false;
+	const ExtrusionRole role = this->roles[flat.first_path];
+	return role == erBridgeInfill
+		|| role == erSolidInfill
+		|| role == erTopSolidInfill;
+}
+
 }
 
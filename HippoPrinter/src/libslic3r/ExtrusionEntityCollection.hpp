@@ -61,6 +61,63 @@ class ExtrusionEntityCollection : public ExtrusionEntity
 
 };
 
+// Compact, read only copy of a tree of extrusion entities for the consumers walking all
+// the toolpaths of a layer without caring about the entity classes (previews, G-code).
+// The attributes of the paths are stored in parallel arrays and their points in a single
+// buffer. Loops and collections are ranges of paths; the entities are listed depth
+// first, a collection followed by its contents.
+class FlatExtrusions
+{
+	public:
+	enum EntityType {
+		fePath,
+		feLoop,
+		feCollection,
+	};
+	struct Entity {
+		EntityType type;
+		// paths [first_path, last_path) belong to the entity
+		size_t first_path, last_path;
+		// for a collection, entities (this, last_entity) are its contents
+		size_t last_entity;
+		ExtrusionLoopRole loop_role;
+		bool no_sort;
+	};
+
+	// one item per path
+	std::vector<ExtrusionRole> roles;
+	std::vector<double> mm3_per_mm;
+	std::vector<float> widths;
+	std::vector<float> heights;
+	// points of path i are points[point_offsets[i]] to points[point_offsets[i + 1] - 1]
+	std::vector<size_t> point_offsets;
+	Points points;
+	std::vector<Entity> entities;
+
+	FlatExtrusions() : point_offsets(1, 0) {};
+	FlatExtrusions(const ExtrusionEntity &entity);
+	void append(const ExtrusionEntity &entity);
+	void clear();
+	bool empty() const {
+		return this->entities.empty();
+	};
+	size_t paths_count() const {
+		return this->roles.size();
+	};
+	Points::const_iterator path_begin(size_t path) const {
+		return this->points.begin() + this->point_offsets[path];
+	};
+	Points::const_iterator path_end(size_t path) const {
+		return this->points.begin() + this->point_offsets[path + 1];
+	};
+	// Whether the entity is solid infill, judged by its first path as ExtrusionLoop does;
+	// the fill collections hold the paths of a single surface, sharing the role.
+	bool is_solid_infill(size_t entity) const;
+
+	private:
+	void _append_path(const ExtrusionPath &path);
+};
+
 }
 
 #endif
@@ -483,13 +483,13 @@ GCode::extrude(ExtrusionLoop loop, std::string description, double speed)
 std::string
 GCode::extrude(const ExtrusionEntity &entity, std::string description, double speed)
 {
-	if (const ExtrusionPath* path = dynamic_cast<const ExtrusionPath*>(&entity)) {
-		return this->extrude(*path, description, speed);
-	} else if (const ExtrusionLoop* loop = dynamic_cast<const ExtrusionLoop*>(&entity)) {
-		return this->extrude(*loop, description, speed);
-	} else {
+	if (entity.is_collection()) {
 		CONFESS("Invalid argument supplied to extrude()");
 		return "";
+	} else if (entity.is_loop()) {
+		return this->extrude(static_cast<const ExtrusionLoop&>(entity), description, speed);
+	} else {
+		return this->extrude(static_cast<const ExtrusionPath&>(entity), description, speed);
 	}
 }
 
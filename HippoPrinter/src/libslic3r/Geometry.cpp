@@ -2,6 +2,7 @@
 #include "ClipperUtils.hpp"
 #include "ExPolygon.hpp"
 #include "Line.hpp"
+#include "NearestPointIndex.hpp"
 #include "PolylineCollection.hpp"
 #include <src/clipper.hpp>
 #include <algorithm>
@@ -248,20 +249,13 @@ convex_hull(const Polygons &polygons)
 void
 chained_path(const Points &points, std::vector<Points::size_type> &retval, Point start_near)
 {
-    PointConstPtrs my_points;
-    std::map<const Point*,Points::size_type> indices;
-    my_points.reserve(points.size());
-    for (Points::const_iterator it = points.begin(); it != points.end(); ++it) {
-        my_points.push_back(&*it);
-        indices[&*it] = it - points.begin();
-    }
-    
+    NearestPointIndex index(points, NearestPointIndex::tbHighestIndex);
     retval.reserve(points.size());
-    while (!my_points.empty()) {
-        Points::size_type idx = start_near.nearest_point_index(my_points);
-        start_near = *my_points[idx];
-        retval.push_back(indices[ my_points[idx] ]);
-        my_points.erase(my_points.begin() + idx);
+    while (!index.empty()) {
+        size_t idx = index.nearest(start_near);
+        start_near = points[idx];
+        retval.push_back(idx);
+        index.remove(idx);
     }
 }
 
@@ -480,10 +474,22 @@ arrange(size_t total_parts, const Pointf &part_size, coordf_t dist, const Boundi
     return true;
 }
 
+MedialAxis::Workspace&
+MedialAxis::_workspace()
+{
+    static thread_local Workspace workspace;
+    return workspace;
+}
+
 void
 MedialAxis::build(ThickPolylines* polylines)
 {
-    construct_voronoi(this->lines.begin(), this->lines.end(), &this->vd);
+    // same as construct_voronoi(), with the builder and the diagram of this thread
+    boost::polygon::default_voronoi_builder &builder = _workspace().builder;
+    builder.clear();
+    boost::polygon::insert(this->lines.begin(), this->lines.end(), &builder);
+    this->vd.clear();
+    builder.construct(&this->vd);
     
     /*
     // DEBUG: dump all Voronoi edges
@@ -514,16 +520,18 @@ MedialAxis::build(ThickPolylines* polylines)
     // note: this keeps twins, so it inserts twice the number of the valid edges
     this->valid_edges.clear();
     {
-        std::set<const VD::edge_type*> seen_edges;
+        // indexed by the position of the edges in the diagram
+        std::vector<bool> seen_edges(this->vd.edges().size(), false);
+        const edge_t* first_edge = this->vd.edges().empty() ? NULL : &this->vd.edges().front();
         for (VD::const_edge_iterator edge = this->vd.edges().begin(); edge != this->vd.edges().end(); ++edge) {
             // if we only process segments representing closed loops, none if the
             // infinite edges (if any) would be part of our MAT anyway
             if (edge->is_secondary() || edge->is_infinite()) continue;
         
             // don't re-validate twins
-            if (seen_edges.find(&*edge) != seen_edges.end()) continue;  // TODO: is this needed?
-            seen_edges.insert(&*edge);
-            seen_edges.insert(edge->twin());
+            if (seen_edges[&*edge - first_edge]) continue;  // TODO: is this needed?
+            seen_edges[&*edge - first_edge] = true;
+            seen_edges[edge->twin() - first_edge] = true;
             
             if (!this->validate_edge(&*edge)) continue;
             this->valid_edges.insert(&*edge);
@@ -636,18 +644,6 @@ MedialAxis::validate_edge(const VD::edge_type* edge)
         Point( edge->vertex1()->x(), edge->vertex1()->y() )
     );
     
-    // discard edge if it lies outside the supplied shape
-    // this could maybe be optimized (checking inclusion of the endpoints
-    // might give false positives as they might belong to the contour itself)
-    if (this->expolygon != NULL) {
-        if (line.a.coincides_with(line.b)) {
-            // in this case, contains(line) returns a false positive
-            if (!this->expolygon->contains(line.a)) return false;
-        } else {
-            if (!this->expolygon->contains(line)) return false;
-        }
-    }
-    
     // retrieve the original line segments which generated the edge we're checking
     const VD::cell_type* cell_l = edge->cell();
     const VD::cell_type* cell_r = edge->twin()->cell();
@@ -717,6 +713,21 @@ MedialAxis::validate_edge(const VD::edge_type* edge)
     if (w0 > this->max_width && w1 > this->max_width)
         return false;
     
+    // The test above prunes most of the edges when the shape is not thin everywhere,
+    // so the costly inclusion test below (a clipping) now only runs on the edges
+    // passing all the other ones, which does not change the result.
+    // discard edge if it lies outside the supplied shape
+    // this could maybe be optimized (checking inclusion of the endpoints
+    // might give false positives as they might belong to the contour itself)
+    if (this->expolygon != NULL) {
+        if (line.a.coincides_with(line.b)) {
+            // in this case, contains(line) returns a false positive
+            if (!this->expolygon->contains(line.a)) return false;
+        } else {
+            if (!this->expolygon->contains(line)) return false;
+        }
+    }
+    
     this->thickness[edge]         = std::make_pair(w0, w1);
     this->thickness[edge->twin()] = std::make_pair(w1, w0);
     
@@ -740,4 +751,66 @@ MedialAxis::retrieve_endpoint(const VD::cell_type* cell) const
     }
 }
 
+MedialAxisCache&
+MedialAxisCache::thread_cache()
+{
+    static thread_local MedialAxisCache cache;
+    return cache;
+}
+
+size_t
+MedialAxisCache::_hash(const ExPolygon &expolygon, double max_width, double min_width)
+{
+    size_t hash = std::hash<double>()(max_width) ^ (std::hash<double>()(min_width) << 1);
+    const Polygons polygons = expolygon;
+    for (Polygons::const_iterator polygon = polygons.begin(); polygon != polygons.end(); ++polygon) {
+        hash = hash * 31 + polygon->points.size();
+        for (Points::const_iterator point = polygon->points.begin(); point != polygon->points.end(); ++point)
+            hash = (hash * 31 + std::hash<coord_t>()(point->x)) * 31 + std::hash<coord_t>()(point->y);
+    }
+    return hash;
+}
+
+static bool
+same_points(const Polygon &a, const Polygon &b)
+{
+    return a.points.size() == b.points.size() && std::equal(a.points.begin(), a.points.end(), b.points.begin(),
+        [](const Point &p, const Point &q) { return p.coincides_with(q); });
+}
+
+const ThickPolylines*
+MedialAxisCache::find(const ExPolygon &expolygon, double max_width, double min_width) const
+{
+    const size_t hash = _hash(expolygon, max_width, min_width);
+    for (std::vector<Entry>::const_iterator entry = this->_entries.begin(); entry != this->_entries.end(); ++entry) {
+        if (entry->hash != hash || entry->max_width != max_width || entry->min_width != min_width
+            || entry->expolygon.holes.size() != expolygon.holes.size()
+            || !same_points(entry->expolygon.contour, expolygon.contour))
+            continue;
+        bool same = true;
+        for (size_t i = 0; same && i < expolygon.holes.size(); ++i)
+            same = same_points(entry->expolygon.holes[i], expolygon.holes[i]);
+        if (same) return &entry->polylines;
+    }
+    return NULL;
+}
+
+void
+MedialAxisCache::insert(const ExPolygon &expolygon, double max_width, double min_width, const ThickPolylines &polylines)
+{
+    const size_t capacity = 32;
+    Entry entry;
+    entry.hash      = _hash(expolygon, max_width, min_width);
+    entry.expolygon = expolygon;
+    entry.max_width = max_width;
+    entry.min_width = min_width;
+    entry.polylines = polylines;
+    if (this->_entries.size() < capacity) {
+        this->_entries.push_back(entry);
+    } else {
+        this->_entries[this->_next] = entry;
+        this->_next = (this->_next + 1) % capacity;
+    }
+}
+
 } }
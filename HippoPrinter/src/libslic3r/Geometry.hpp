@@ -39,13 +39,20 @@ class MedialAxis {
     double max_width;
     double min_width;
     MedialAxis(double _max_width, double _min_width, const ExPolygon* _expolygon = NULL)
-        : expolygon(_expolygon), max_width(_max_width), min_width(_min_width) {};
+        : expolygon(_expolygon), max_width(_max_width), min_width(_min_width), vd(_workspace().vd) {};
     void build(ThickPolylines* polylines);
     void build(Polylines* polylines);
     
     private:
     typedef voronoi_diagram<double> VD;
-    VD vd;
+    // Voronoi builder and diagram of the current thread, reused from one medial axis
+    // to the next so that their storage does not have to be allocated again
+    struct Workspace {
+        boost::polygon::default_voronoi_builder builder;
+        VD vd;
+    };
+    static Workspace& _workspace();
+    VD &vd;
     std::set<const VD::edge_type*> edges, valid_edges;
     std::map<const VD::edge_type*, std::pair<coordf_t,coordf_t> > thickness;
     void process_edge_neighbors(const VD::edge_type* edge, ThickPolyline* polyline);
@@ -54,6 +61,31 @@ class MedialAxis {
     const Point& retrieve_endpoint(const VD::cell_type* cell) const;
 };
 
+// The medial axes lately computed by the current thread. ExPolygon::medial_axis() only
+// depends on the expolygon and on the widths, and prismatic parts have the same thin
+// regions on many consecutive layers.
+class MedialAxisCache {
+    public:
+    static MedialAxisCache& thread_cache();
+    // the polylines of an identical expolygon with the same widths, or NULL
+    const ThickPolylines* find(const ExPolygon &expolygon, double max_width, double min_width) const;
+    void insert(const ExPolygon &expolygon, double max_width, double min_width, const ThickPolylines &polylines);
+    
+    private:
+    struct Entry {
+        size_t hash;
+        ExPolygon expolygon;
+        double max_width, min_width;
+        ThickPolylines polylines;
+    };
+    // the oldest entry is replaced once the cache is full
+    std::vector<Entry> _entries;
+    size_t _next;
+    
+    MedialAxisCache() : _next(0) {};
+    static size_t _hash(const ExPolygon &expolygon, double max_width, double min_width);
+};
+
 } }
 
 #endif
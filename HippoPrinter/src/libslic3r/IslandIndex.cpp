@@ -0,0 +1,156 @@
+#include "IslandIndex.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Slic3r {
+
+IslandIndex::IslandIndex(const ExPolygons &islands)
+:   _cell_size(1),
+	_columns(0),
+	_rows(0)
+{
+	this->_islands.resize(islands.size());
+	for (size_t idx = 0; idx < islands.size(); ++idx) {
+		Island &island = this->_islands[idx];
+		island.contour = &islands[idx].contour;
+		island.bbox = island.contour->bounding_box();
+		this->_build_bands(&island);
+		this->_bbox.merge(island.bbox);
+	}
+	if (this->_islands.empty()) return;
+
+	// about one island per cell
+	const double width  = double(this->_bbox.max.x) - double(this->_bbox.min.x);
+	const double height = double(this->_bbox.max.y) - double(this->_bbox.min.y);
+	double cell_size = std::sqrt(width * height / this->_islands.size());
+	cell_size = std::max(cell_size, std::max(width, height) / this->_islands.size());
+	this->_cell_size = std::max(coord_t(1), coord_t(std::ceil(cell_size)));
+	this->_columns = int(width  / this->_cell_size) + 1;
+	this->_rows    = int(height / this->_cell_size) + 1;
+
+	// every island is listed in all the cells its bounding box touches, in ascending order
+	std::vector<int> first_column(this->_islands.size()), last_column(this->_islands.size());
+	std::vector<int> first_row(this->_islands.size()), last_row(this->_islands.size());
+	this->_cell_start.assign(size_t(this->_columns) * this->_rows + 1, 0);
+	for (size_t idx = 0; idx < this->_islands.size(); ++idx) {
+		const BoundingBox &bbox = this->_islands[idx].bbox;
+		this->_cell(bbox.min, &first_column[idx], &first_row[idx]);
+		this->_cell(bbox.max, &last_column[idx], &last_row[idx]);
+		for (int row = first_row[idx]; row <= last_row[idx]; ++row)
+			for (int column = first_column[idx]; column <= last_column[idx]; ++column)
+				++this->_cell_start[size_t(row) * this->_columns + column + 1];
+	}
+	for (size_t cell = 1; cell < this->_cell_start.size(); ++cell)
+		this->_cell_start[cell] += this->_cell_start[cell - 1];
+	this->_cell_islands.resize(this->_cell_start.back());
+	std::vector<size_t> next(this->_cell_start.begin(), this->_cell_start.end() - 1);
+	for (size_t idx = 0; idx < this->_islands.size(); ++idx)
+		for (int row = first_row[idx]; row <= last_row[idx]; ++row)
+			for (int column = first_column[idx]; column <= last_column[idx]; ++column)
+				this->_cell_islands[next[size_t(row) * this->_columns + column]++] = int(idx);
+}
+
+void
+IslandIndex::_build_bands(Island* island) const
+{
+	const Points &points = island->contour->points;
+	const size_t count = points.size();
+	island->band_height = 0;
+	// a linear scan is as fast for the small contours
+	if (count < 32) return;
+
+	// About one edge per band, but fewer bands if the long edges would have to be
+	// listed in too many of them.
+	const coord_t min_y = island->bbox.min.y;
+	const double height = double(island->bbox.max.y) - double(min_y) + 1;
+	size_t bands = count;
+	for (;;) {
+		island->band_height = std::max(coord_t(1), coord_t(std::ceil(height / bands)));
+		size_t entries = 0;
+		for (size_t k = 0; k < count; ++k) {
+			const Point &i = points[k];
+			const Point &j = points[(k == 0) ? count - 1 : k - 1];
+			entries += (std::max(i.y, j.y) - min_y) / island->band_height
+				- (std::min(i.y, j.y) - min_y) / island->band_height + 1;
+		}
+		if (entries <= 4 * count || bands == 1) break;
+		bands /= 2;
+	}
+
+	// counting sort of the edges by band
+	const size_t used = size_t((island->bbox.max.y - min_y) / island->band_height) + 1;
+	island->band_start.assign(used + 1, 0);
+	for (size_t k = 0; k < count; ++k) {
+		const Point &i = points[k];
+		const Point &j = points[(k == 0) ? count - 1 : k - 1];
+		const size_t first = size_t((std::min(i.y, j.y) - min_y) / island->band_height);
+		const size_t last  = size_t((std::max(i.y, j.y) - min_y) / island->band_height);
+		for (size_t band = first; band <= last; ++band)
+			++island->band_start[band + 1];
+	}
+	for (size_t band = 1; band < island->band_start.size(); ++band)
+		island->band_start[band] += island->band_start[band - 1];
+	island->edges.resize(island->band_start.back());
+	std::vector<size_t> next(island->band_start.begin(), island->band_start.end() - 1);
+	for (size_t k = 0; k < count; ++k) {
+		const Point &i = points[k];
+		const Point &j = points[(k == 0) ? count - 1 : k - 1];
+		const size_t first = size_t((std::min(i.y, j.y) - min_y) / island->band_height);
+		const size_t last  = size_t((std::max(i.y, j.y) - min_y) / island->band_height);
+		for (size_t band = first; band <= last; ++band)
+			island->edges[next[band]++] = k;
+	}
+}
+
+bool
+IslandIndex::Island::contains(const Point &point) const
+{
+	if (this->band_start.empty())
+		return this->contour->contains(point);
+
+	// Only the edges with min(y) <= point.y < max(y) cross the ray, and they are all
+	// listed in the band of point.y. The crossings are counted exactly like
+	// Polygon::contains() does, in another order, which does not change their parity.
+	if (point.y < this->bbox.min.y || point.y > this->bbox.max.y) return false;
+	const Points &points = this->contour->points;
+	const size_t band = size_t((point.y - this->bbox.min.y) / this->band_height);
+	bool result = false;
+	for (size_t e = this->band_start[band]; e < this->band_start[band + 1]; ++e) {
+		const size_t k = this->edges[e];
+		const Point* i = &points[k];
+		const Point* j = &points[(k == 0) ? points.size() - 1 : k - 1];
+		if ( ((i->y > point.y) != (j->y > point.y))
+			&& ((double)point.x < (double)(j->x - i->x) * (double)(point.y - i->y) / (double)(j->y - i->y) + (double)i->x) )
+			result = !result;
+	}
+	return result;
+}
+
+// cell containing the point, or the nearest cell for the points outside of the grid
+void
+IslandIndex::_cell(const Point &point, int* column, int* row) const
+{
+	const double x = (double(point.x) - double(this->_bbox.min.x)) / this->_cell_size;
+	const double y = (double(point.y) - double(this->_bbox.min.y)) / this->_cell_size;
+	*column = int(std::max(0., std::min(double(this->_columns - 1), std::floor(x))));
+	*row    = int(std::max(0., std::min(double(this->_rows    - 1), std::floor(y))));
+}
+
+int
+IslandIndex::find(const Point &point) const
+{
+	if (this->_islands.empty() || !this->_bbox.contains(point)) return -1;
+
+	int column, row;
+	this->_cell(point, &column, &row);
+	const size_t cell = size_t(row) * this->_columns + column;
+	for (size_t i = this->_cell_start[cell]; i < this->_cell_start[cell + 1]; ++i) {
+		const int idx = this->_cell_islands[i];
+		const Island &island = this->_islands[idx];
+		if (island.bbox.contains(point) && island.contains(point))
+			return idx;
+	}
+	return -1;
+}
+
+}
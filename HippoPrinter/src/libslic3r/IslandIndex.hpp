@@ -0,0 +1,54 @@
+#ifndef slic3r_IslandIndex_hpp_
+#define slic3r_IslandIndex_hpp_
+
+#include "libslic3r.h"
+#include "BoundingBox.hpp"
+#include "ExPolygon.hpp"
+#include <vector>
+
+namespace Slic3r {
+
+// Spatial index over the islands (slices) of a layer answering "which island contains
+// this point" queries, for assigning the extrusions of a layer to its islands. A uniform
+// grid over the layer lists the islands whose bounding box touches each cell, and the
+// edges of every contour are bucketed into horizontal bands, so that a query only tests
+// a few islands and only the edges crossing the height of the point.
+//
+// The result is the same as testing the islands in order with BoundingBox::contains()
+// and then Polygon::contains() on their contour, which uses the same arithmetic.
+class IslandIndex
+{
+	public:
+	IslandIndex(const ExPolygons &islands);
+	// Index of the first island whose contour contains the point, -1 if there is none.
+	int find(const Point &point) const;
+
+	private:
+	struct Island {
+		const Polygon* contour;
+		BoundingBox bbox;
+		// Edge k runs from point k-1 (the last point for k == 0) to point k. The edges
+		// crossing band b are edges[band_start[b] .. band_start[b+1]-1]. The small
+		// contours have no bands and are tested edge by edge.
+		coord_t band_height;
+		std::vector<size_t> band_start;
+		std::vector<size_t> edges;
+
+		bool contains(const Point &point) const;
+	};
+	std::vector<Island> _islands;
+
+	BoundingBox _bbox;
+	coord_t _cell_size;
+	int _columns, _rows;
+	// islands of cell i (in ascending order) are _cell_islands[_cell_start[i] .. _cell_start[i+1]-1]
+	std::vector<size_t> _cell_start;
+	std::vector<int> _cell_islands;
+
+	void _build_bands(Island* island) const;
+	void _cell(const Point &point, int* column, int* row) const;
+};
+
+}
+
+#endif
@@ -7,6 +7,7 @@
 #include "ExtrusionEntityCollection.hpp"
 #include "ExPolygonCollection.hpp"
 #include "PolylineCollection.hpp"
+#include <cstdint>
 #include <boost/thread.hpp>
 
 
@@ -55,12 +56,41 @@ class LayerRegion
     // ordered collection of extrusion paths to fill surfaces
     // (this collection contains only ExtrusionEntityCollection objects)
     ExtrusionEntityCollection fills;
-    
+
+    // slices as produced by PrintObject::Slice(), restored instead of re-slicing
+    // when the perimeters of this layer have to be generated again
+    SurfaceCollection raw_slices;
+
+    // slices (with extra_perimeters) and fill_surfaces as left by make_perimeters(),
+    // restored when only the steps following the perimeters have to be redone
+    SurfaceCollection perimeter_slices;
+    SurfaceCollection perimeter_fill_surfaces;
+
+    // fill_surfaces the current fills were generated from
+    SurfaceCollection filled_surfaces;
+
+    // hash of the inputs and fill_surfaces of the layers (by id) written by the last
+    // PrintObject::DiscoverHorizontalShells() pass over this layer, so that an equal
+    // pass can be replayed instead of being computed again
+    uint64_t shells_key;
+    std::vector<std::pair<size_t, SurfaceCollection> > shells_result;
+
+    // same for the PrintObject::CombineInfill() group whose top layer is this one
+    uint64_t combine_key;
+    std::vector<SurfaceCollection> combine_result;
+
+    // region of another layer whose perimeters (with the thin fills and fill_surfaces),
+    // and fills, were copied to this one by PrintObject::_make_perimeters() and
+    // PrintObject::_infill(), or this region when they were made for it
+    const LayerRegion* perimeters_from;
+    const LayerRegion* fills_from;
+
     Flow flow(FlowRole role, bool bridge = false, double width = -1) const;
     void merge_slices();
     void prepare_fill_surfaces();
     void make_perimeters(const SurfaceCollection &slices, SurfaceCollection* fill_surfaces);
     void make_fill();
+    void copy_fill(const LayerRegion &other);
     void process_external_surfaces();
     double infill_area_threshold() const;
     
@@ -69,8 +99,11 @@ class LayerRegion
     PrintRegion *_region;
     mutable boost::mutex _slices_mutex;
 
+    void _append_thin_fills();
+
     LayerRegion(Layer *layer, PrintRegion *region)
-        : _layer(layer), _region(region) {};
+        : shells_key(0), combine_key(0), perimeters_from(NULL), fills_from(NULL),
+            _layer(layer), _region(region) {};
     ~LayerRegion() {};
 };
 
@@ -0,0 +1,55 @@
+#include "LayerIntervals.hpp"
+#include "Layer.hpp"
+#include <algorithm>
+
+namespace Slic3r {
+
+LayerIntervals::LayerIntervals(const std::vector<coordf_t> &tops)
+{
+	this->_bottoms.reserve(tops.size());
+	this->_tops.reserve(tops.size());
+	this->_max_tops.reserve(tops.size());
+	for (size_t idx = 0; idx < tops.size(); ++idx)
+		this->append((idx == 0) ? 0 : tops[idx - 1], tops[idx]);
+}
+
+LayerIntervals::LayerIntervals(const std::vector<Layer*> &layers)
+{
+	this->_bottoms.reserve(layers.size());
+	this->_tops.reserve(layers.size());
+	this->_max_tops.reserve(layers.size());
+	for (const Layer* layer : layers)
+		this->append(layer->print_z - layer->height, layer->print_z);
+}
+
+void
+LayerIntervals::append(coordf_t bottom, coordf_t top)
+{
+	this->_bottoms.push_back(bottom);
+	this->_tops.push_back(top);
+	this->_max_tops.push_back(this->_max_tops.empty() ? top : std::max(this->_max_tops.back(), top));
+}
+
+void
+LayerIntervals::clear()
+{
+	this->_bottoms.clear();
+	this->_tops.clear();
+	this->_max_tops.clear();
+}
+
+std::vector<int>
+LayerIntervals::overlapping(coordf_t z_min, coordf_t z_max) const
+{
+	// the intervals before first end at or below z_min,
+	// the intervals from last on start at or above z_max
+	size_t first = std::upper_bound(this->_max_tops.begin(), this->_max_tops.end(), z_min) - this->_max_tops.begin();
+	size_t last  = std::lower_bound(this->_bottoms.begin(), this->_bottoms.end(), z_max) - this->_bottoms.begin();
+	std::vector<int> out;
+	for (size_t idx = first; idx < last; ++idx)
+		if (this->_tops[idx] > z_min)
+			out.push_back(int(idx));
+	return out;
+}
+
+}
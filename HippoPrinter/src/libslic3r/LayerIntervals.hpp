@@ -0,0 +1,49 @@
+#ifndef slic3r_LayerIntervals_hpp_
+#define slic3r_LayerIntervals_hpp_
+
+#include "libslic3r.h"
+#include <vector>
+
+namespace Slic3r {
+
+class Layer;
+
+// Sorted index over the z ranges (bottom, top] of a stack of layers, answering "which
+// layers overlap this z range" in O(log n + k) instead of scanning all the layers.
+// Used by the support generator for the support layers and the object layers, and by
+// the layer preview.
+//
+// The intervals must be appended in ascending order of their bottoms, as the layers of
+// a stack are. Their tops need not be sorted, though the queries are only O(log n + k)
+// when they are.
+class LayerIntervals
+{
+	public:
+	LayerIntervals() {};
+	// Support layers ending at the given heights, the first one starting at 0.
+	LayerIntervals(const std::vector<coordf_t> &tops);
+	// Layers of an object, each spanning (print_z - height, print_z].
+	LayerIntervals(const std::vector<Layer*> &layers);
+	void append(coordf_t bottom, coordf_t top);
+	void clear();
+	size_t size() const { return this->_bottoms.size(); };
+	coordf_t bottom(size_t idx) const { return this->_bottoms[idx]; };
+	coordf_t top(size_t idx) const { return this->_tops[idx]; };
+	// Indices of the intervals overlapping the open range (z_min, z_max), that is with
+	// bottom < z_max and top > z_min, in ascending order.
+	std::vector<int> overlapping(coordf_t z_min, coordf_t z_max) const;
+	// Indices of the intervals overlapping interval idx, including idx itself.
+	std::vector<int> overlapping(size_t idx) const {
+		return this->overlapping(this->_bottoms[idx], this->_tops[idx]);
+	};
+
+	private:
+	std::vector<coordf_t> _bottoms;
+	std::vector<coordf_t> _tops;
+	// _max_tops[i] is the highest top of the intervals 0..i
+	std::vector<coordf_t> _max_tops;
+};
+
+}
+
+#endif
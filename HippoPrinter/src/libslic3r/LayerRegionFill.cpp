@@ -290,11 +290,30 @@ LayerRegion::make_fill()
         }
     }
 
-    // add thin fill regions
-    // thin_fills are of C++ Slic3r::ExtrusionEntityCollection, perl type Slic3r::ExtrusionPath::Collection
-    // Unpacks the collection, creates multiple collections per path so that they will
-    // be individually included in the nearest neighbor search.
-    // The path type could be ExtrusionPath, ExtrusionLoop or ExtrusionEntityCollection.
+    this->_append_thin_fills();
+}
+
+// Take the fills generated by make_fill() for another region having the same fill
+// surfaces and config instead of generating them again. The thin fills, appended
+// last by make_fill(), are this region's own.
+void
+LayerRegion::copy_fill(const LayerRegion &other)
+{
+    this->fills.clear();
+    const size_t count = other.fills.entities.size() - other.thin_fills.entities.size();
+    for (size_t i = 0; i < count; ++i)
+        this->fills.append(*other.fills.entities[i]);
+    this->_append_thin_fills();
+}
+
+// add thin fill regions
+// thin_fills are of C++ Slic3r::ExtrusionEntityCollection, perl type Slic3r::ExtrusionPath::Collection
+// Unpacks the collection, creates multiple collections per path so that they will
+// be individually included in the nearest neighbor search.
+// The path type could be ExtrusionPath, ExtrusionLoop or ExtrusionEntityCollection.
+void
+LayerRegion::_append_thin_fills()
+{
     for (ExtrusionEntitiesPtr::const_iterator thin_fill = this->thin_fills.entities.begin(); thin_fill != this->thin_fills.entities.end(); ++ thin_fill) {
         ExtrusionEntityCollection* coll = new ExtrusionEntityCollection();
         this->fills.entities.push_back(coll);
@@ -222,6 +222,15 @@ MotionPlanner::init_graph(int island_idx)
         Lines lines = env.env.lines();
         boost::polygon::construct_voronoi(lines.begin(), lines.end(), &vd);
         
+        // test all the Voronoi vertices against our configuration space at once
+        Points vertices;
+        vertices.reserve(vd.vertices().size());
+        for (VD::const_vertex_iterator vertex = vd.vertices().begin(); vertex != vd.vertices().end(); ++vertex)
+            vertices.push_back(Point(vertex->x(), vertex->y()));
+        std::vector<bool> vertex_inside = env.island.contains(vertices);
+        for (size_t i = 0; i < vertices.size(); ++i)
+            if (!vertex_inside[i]) vertex_inside[i] = env.island.has_boundary_point(vertices[i]);
+        
         // traverse the Voronoi diagram and generate graph nodes and edges
         for (VD::const_edge_iterator edge = vd.edges().begin(); edge != vd.edges().end(); ++edge) {
             if (edge->is_infinite()) continue;
@@ -232,7 +241,7 @@ MotionPlanner::init_graph(int island_idx)
             Point p1 = Point(v1->x(), v1->y());
             
             // skip edge if any of its endpoints is outside our configuration space
-            if (!env.island.contains_b(p0) || !env.island.contains_b(p1)) continue;
+            if (!vertex_inside[v0 - &vd.vertices().front()] || !vertex_inside[v1 - &vd.vertices().front()]) continue;
             
             t_vd_vertices::const_iterator i_v0 = vd_vertices.find(v0);
             size_t v0_idx;
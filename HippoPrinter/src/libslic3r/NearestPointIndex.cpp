@@ -0,0 +1,142 @@
+#include "NearestPointIndex.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Slic3r {
+
+NearestPointIndex::NearestPointIndex(const Points &points, TieBreak tie_break)
+:   _points(points),
+	_tie_break(tie_break),
+	_removed(points.size(), false),
+	_count(points.size())
+{
+	this->_build();
+}
+
+void
+NearestPointIndex::remove(size_t idx)
+{
+	if (this->_removed[idx]) return;
+	this->_removed[idx] = true;
+	--this->_count;
+}
+
+void
+NearestPointIndex::_build()
+{
+	this->_indexed = this->_count;
+	this->_cell_start.clear();
+	this->_cell_points.clear();
+	this->_columns = this->_rows = 0;
+	if (this->_count == 0) return;
+
+	// bounding box of the remaining points
+	coord_t min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+	bool first = true;
+	for (size_t idx = 0; idx < this->_points.size(); ++idx) {
+		if (this->_removed[idx]) continue;
+		const Point &p = this->_points[idx];
+		if (first) {
+			min_x = max_x = p.x;
+			min_y = max_y = p.y;
+			first = false;
+		} else {
+			min_x = std::min(min_x, p.x);
+			min_y = std::min(min_y, p.y);
+			max_x = std::max(max_x, p.x);
+			max_y = std::max(max_y, p.y);
+		}
+	}
+
+	// about one point per cell, but never more cells than about three times the points
+	// (in a long and thin bounding box the cells get as long as the short side)
+	const double width  = double(max_x) - double(min_x);
+	const double height = double(max_y) - double(min_y);
+	double cell_size = std::sqrt(width * height / this->_count);
+	cell_size = std::max(cell_size, std::max(width, height) / this->_count);
+	this->_cell_size = std::max(coord_t(1), coord_t(std::ceil(cell_size)));
+	this->_origin = Point(min_x, min_y);
+	this->_columns = int((double(max_x) - double(min_x)) / this->_cell_size) + 1;
+	this->_rows    = int((double(max_y) - double(min_y)) / this->_cell_size) + 1;
+
+	// counting sort of the points by cell, keeping the ascending order inside a cell
+	std::vector<size_t> cells(this->_points.size());
+	this->_cell_start.assign(size_t(this->_columns) * this->_rows + 1, 0);
+	for (size_t idx = 0; idx < this->_points.size(); ++idx) {
+		if (this->_removed[idx]) continue;
+		int column, row;
+		this->_cell(this->_points[idx], &column, &row);
+		cells[idx] = size_t(row) * this->_columns + column;
+		++this->_cell_start[cells[idx] + 1];
+	}
+	for (size_t cell = 1; cell < this->_cell_start.size(); ++cell)
+		this->_cell_start[cell] += this->_cell_start[cell - 1];
+	this->_cell_points.resize(this->_count);
+	std::vector<size_t> next(this->_cell_start.begin(), this->_cell_start.end() - 1);
+	for (size_t idx = 0; idx < this->_points.size(); ++idx) {
+		if (this->_removed[idx]) continue;
+		this->_cell_points[next[cells[idx]]++] = idx;
+	}
+}
+
+// cell containing the point, or the nearest cell for the points outside of the grid
+void
+NearestPointIndex::_cell(const Point &point, int* column, int* row) const
+{
+	const double x = (double(point.x) - double(this->_origin.x)) / this->_cell_size;
+	const double y = (double(point.y) - double(this->_origin.y)) / this->_cell_size;
+	*column = int(std::max(0., std::min(double(this->_columns - 1), std::floor(x))));
+	*row    = int(std::max(0., std::min(double(this->_rows    - 1), std::floor(y))));
+}
+
+size_t
+NearestPointIndex::nearest(const Point &point)
+{
+	if (this->_count < this->_indexed / 2)
+		this->_build();
+
+	int center_column, center_row;
+	this->_cell(point, &center_column, &center_row);
+
+	size_t best = size_t(-1);
+	double best_distance = 0;
+	const int max_ring = std::max(this->_columns, this->_rows);
+	for (int ring = 0; ring <= max_ring; ++ring) {
+		if (best != size_t(-1) && ring > 0) {
+			// The points of this ring of cells are at least (ring-1) cells away from the
+			// (nearest grid cell of the) query point along x or y, so once that distance
+			// exceeds the best one found no point further out can win or even tie.
+			const double bound = double(ring - 1) * double(this->_cell_size);
+			if (bound * bound > best_distance) break;
+		}
+		const int first_row = std::max(0, center_row - ring);
+		const int last_row  = std::min(this->_rows - 1, center_row + ring);
+		for (int row = first_row; row <= last_row; ++row) {
+			// the first and the last row of the ring are full, the others only have their ends
+			const bool full_row = row == center_row - ring || row == center_row + ring;
+			const int step = full_row ? 1 : 2 * ring;
+			for (int column = center_column - ring; column <= center_column + ring; column += step) {
+				if (column < 0 || column >= this->_columns) continue;
+				const size_t cell = size_t(row) * this->_columns + column;
+				for (size_t i = this->_cell_start[cell]; i < this->_cell_start[cell + 1]; ++i) {
+					const size_t idx = this->_cell_points[i];
+					if (this->_removed[idx]) continue;
+					const Point &p = this->_points[idx];
+					// same arithmetic as the linear scans, so that ties come out the same
+					const double dx = double(point.x - p.x);
+					const double dy = double(point.y - p.y);
+					const double distance = dx * dx + dy * dy;
+					if (best == size_t(-1) || distance < best_distance
+						|| (distance == best_distance
+							&& ((this->_tie_break == tbLowestIndex || distance == 0) ? idx < best : idx > best))) {
+						best = idx;
+						best_distance = distance;
+					}
+				}
+			}
+		}
+	}
+	return best;
+}
+
+}
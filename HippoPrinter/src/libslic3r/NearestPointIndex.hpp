@@ -0,0 +1,60 @@
+#ifndef slic3r_NearestPointIndex_hpp_
+#define slic3r_NearestPointIndex_hpp_
+
+#include "libslic3r.h"
+#include "Point.hpp"
+#include <vector>
+
+namespace Slic3r {
+
+// Uniform grid over a set of points answering "nearest point not visited yet"
+// queries for the nearest-neighbour walks of chained_path(). Every query only
+// looks at the grid cells around the query point, so ordering n paths takes
+// about O(n log n) instead of the O(n^2) of a linear scan per step.
+//
+// The distances are computed and compared exactly like the linear scans did,
+// and ties are broken the same way, so the resulting order does not change.
+class NearestPointIndex
+{
+	public:
+	enum TieBreak {
+		// among the points at the same distance the one with the lowest index wins
+		tbLowestIndex,
+		// a coincident point with the lowest index wins, otherwise the point with
+		// the highest index wins (as in Point::nearest_point_index())
+		tbHighestIndex,
+	};
+
+	NearestPointIndex(const Points &points, TieBreak tie_break);
+	// number of points not removed yet
+	size_t size() const { return this->_count; };
+	bool empty() const { return this->_count == 0; };
+	// Index of the point nearest to the given one, among the points not removed yet.
+	// The index must not be empty.
+	size_t nearest(const Point &point);
+	void remove(size_t idx);
+
+	private:
+	Points _points;
+	TieBreak _tie_break;
+	std::vector<bool> _removed;
+	size_t _count;
+
+	// The grid, rebuilt from the remaining points once half of them have been
+	// removed, so that the queries do not keep walking over emptied cells.
+	Point _origin;
+	coord_t _cell_size;
+	int _columns, _rows;
+	// points of cell i (in ascending order) are _cell_points[_cell_start[i] .. _cell_start[i+1]-1]
+	std::vector<size_t> _cell_start;
+	std::vector<size_t> _cell_points;
+	// number of points in the grid when it was built
+	size_t _indexed;
+
+	void _build();
+	void _cell(const Point &point, int* column, int* row) const;
+};
+
+}
+
+#endif
@@ -1,6 +1,13 @@
 #include "ClipperUtils.hpp"
 #include "Polygon.hpp"
 #include "Polyline.hpp"
+#include <algorithm>
+
+// SSE2 is part of the x86-64 baseline, so it needs no runtime detection
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SLIC3R_CROSSINGS_SSE2
+#include <emmintrin.h>
+#endif
 
 namespace Slic3r {
 
@@ -88,13 +95,21 @@ Polygon::equally_spaced_points(double distance) const
 double
 Polygon::area() const
 {
+#ifdef use_xyz
 	return ClipperLib::Area(Slic3rMultiPoint_to_ClipperPath(*this));
+#else
+	return ClipperLib::Area(Slic3rPoints_to_ClipperPoints(this->points), this->points.size());
+#endif
 }
 
 bool
 Polygon::is_counter_clockwise() const
 {
+#ifdef use_xyz
 	return ClipperLib::Orientation(Slic3rMultiPoint_to_ClipperPath(*this));
+#else
+	return ClipperLib::Orientation(Slic3rPoints_to_ClipperPoints(this->points), this->points.size());
+#endif
 }
 
 bool
@@ -148,6 +163,67 @@ Polygon::contains(const Point &point) const
 	return result;
 }
 
+std::vector<bool>
+Polygon::contains(const Points &points) const
+{
+	std::vector<size_t> order(points.size());
+	for (size_t k = 0; k < order.size(); ++k) order[k] = k;
+	std::sort(order.begin(), order.end(), [&points](size_t a, size_t b) { return points[a].y < points[b].y; });
+	Points points_by_y;
+	points_by_y.reserve(points.size());
+	for (size_t k : order) points_by_y.push_back(points[k]);
+
+	std::vector<unsigned char> inside(points.size(), 0);
+	this->toggle_crossings(points_by_y, &inside);
+	std::vector<bool> result(points.size());
+	for (size_t k = 0; k < order.size(); ++k) result[order[k]] = inside[k] != 0;
+	return result;
+}
+
+// An edge is crossed by the rays of exactly the points with min(y) <= point.y < max(y),
+// a range of the sorted points, so every edge only visits the points whose ray it
+// crosses. Those get the same test as in contains(), without any branch; the SSE2 path
+// tests two points per step with the same double operations, so the result is identical.
+void
+Polygon::toggle_crossings(const Points &points_by_y, std::vector<unsigned char>* inside) const
+{
+	if (this->points.empty()) return;
+	const Point* p = points_by_y.data();
+	unsigned char* result = inside->data();
+	Points::const_iterator i = this->points.begin();
+	Points::const_iterator j = this->points.end() - 1;
+	for (; i != this->points.end(); j = i++) {
+		if (i->y == j->y) continue;
+		const coord_t low  = std::min(i->y, j->y);
+		const coord_t high = std::max(i->y, j->y);
+		const size_t first = std::lower_bound(p, p + points_by_y.size(), low,
+			[](const Point &point, coord_t y) { return point.y < y; }) - p;
+		const size_t last  = std::lower_bound(p + first, p + points_by_y.size(), high,
+			[](const Point &point, coord_t y) { return point.y < y; }) - p;
+		const coord_t iy = i->y;
+		const double dx = (double)(j->x - i->x);
+		const double dy = (double)(j->y - i->y);
+		const double ix = (double)i->x;
+		size_t k = first;
+#ifdef SLIC3R_CROSSINGS_SSE2
+		// SSE2 has no int64 to double conversion, the coordinates are converted one by one
+		const __m128d vdx = _mm_set1_pd(dx);
+		const __m128d vdy = _mm_set1_pd(dy);
+		const __m128d vix = _mm_set1_pd(ix);
+		for (; k + 2 <= last; k += 2) {
+			const __m128d px = _mm_set_pd((double)p[k + 1].x, (double)p[k].x);
+			const __m128d py = _mm_set_pd((double)(p[k + 1].y - iy), (double)(p[k].y - iy));
+			const __m128d edge_x = _mm_add_pd(_mm_div_pd(_mm_mul_pd(vdx, py), vdy), vix);
+			const int mask = _mm_movemask_pd(_mm_cmplt_pd(px, edge_x));
+			result[k]     ^= (unsigned char)(mask & 1);
+			result[k + 1] ^= (unsigned char)(mask >> 1);
+		}
+#endif
+		for (; k < last; ++k)
+			result[k] ^= (unsigned char)((double)p[k].x < dx * (double)(p[k].y - iy) / dy + ix);
+	}
+}
+
 void
 Polygon::douglas_peucker(double tolerance)
 {
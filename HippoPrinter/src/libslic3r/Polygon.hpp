@@ -39,6 +39,11 @@ class Polygon : public MultiPoint {
 	// Does an unoriented polygon contain a point?
 	// Tested by counting intersections along a horizontal line.
 	bool contains(const Point &point) const;
+	// contains() for many points at once, in a single pass over the edges
+	std::vector<bool> contains(const Points &points) const;
+	// Crossing-number kernel of the batch contains(): flips inside[k] for every edge
+	// crossed by the horizontal ray cast from points_by_y[k] (sorted by y).
+	void toggle_crossings(const Points &points_by_y, std::vector<unsigned char>* inside) const;
 	void douglas_peucker(double tolerance);
 	void remove_vertical_collinear_points(coord_t tolerance);
 	Polygons simplify(double tolerance) const;
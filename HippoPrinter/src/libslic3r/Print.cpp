@@ -40,6 +40,7 @@ void
 PrintState<StepClass>::set_done(StepClass step)
 {
 	this->done.insert(step);
+	this->dirty.erase(step);
 }
 
 template <class StepClass>
@@ -48,16 +49,83 @@ PrintState<StepClass>::invalidate(StepClass step)
 {
 	bool invalidated = this->started.erase(step) > 0;
 	this->done.erase(step);
+	this->dirty.erase(step);
 	return invalidated;
 }
 
+// Marks only the given layers of a step as needing to be recomputed.
+// A step which is not done and has nothing recorded in dirty is already
+// invalid as a whole, so it is left as it is.
+template <class StepClass>
+bool
+PrintState<StepClass>::invalidate_layers(StepClass step, const std::set<size_t> &layers)
+{
+	if (this->done.erase(step) > 0) {
+		this->dirty[step].layers = layers;
+		return true;
+	}
+	typename std::map<StepClass, DirtyParts>::iterator it = this->dirty.find(step);
+	if (it == this->dirty.end())
+		return false;
+	it->second.layers.insert(layers.begin(), layers.end());
+	return true;
+}
+
+// Marks a step as needing to be recomputed for all the layers of one region.
+template <class StepClass>
+bool
+PrintState<StepClass>::invalidate_region(StepClass step, size_t region_id)
+{
+	if (this->done.erase(step) > 0) {
+		this->dirty[step].regions.insert(region_id);
+		return true;
+	}
+	typename std::map<StepClass, DirtyParts>::iterator it = this->dirty.find(step);
+	if (it == this->dirty.end())
+		return false;
+	return it->second.regions.insert(region_id).second;
+}
+
+template <class StepClass>
+bool
+PrintState<StepClass>::is_layer_dirty(StepClass step, size_t layer_id) const
+{
+	if (this->is_done(step))
+		return false;
+	typename std::map<StepClass, DirtyParts>::const_iterator it = this->dirty.find(step);
+	return it == this->dirty.end() || it->second.layers.count(layer_id) > 0;
+}
+
+template <class StepClass>
+bool
+PrintState<StepClass>::is_region_dirty(StepClass step, size_t region_id) const
+{
+	if (this->is_done(step))
+		return false;
+	typename std::map<StepClass, DirtyParts>::const_iterator it = this->dirty.find(step);
+	return it == this->dirty.end() || it->second.regions.count(region_id) > 0;
+}
+
+template <class StepClass>
+bool
+PrintState<StepClass>::is_dirty(StepClass step, size_t layer_id, size_t region_id) const
+{
+	if (this->is_done(step))
+		return false;
+	typename std::map<StepClass, DirtyParts>::const_iterator it = this->dirty.find(step);
+	return it == this->dirty.end()
+		|| it->second.layers.count(layer_id) > 0
+		|| it->second.regions.count(region_id) > 0;
+}
+
 template class PrintState<PrintStep>;
 template class PrintState<PrintObjectStep>;
 
 
 Print::Print()
 :   total_used_filament(0),
-	total_extruded_volume(0)
+	total_extruded_volume(0),
+	canceled_(false)
 {
 }
 
@@ -284,6 +352,8 @@ Print::invalidate_state_by_config(const PrintConfigBase &config)
 bool
 Print::invalidate_step(PrintStep step)
 {
+	// PrintObjects invalidate the Print steps from their own worker threads
+	boost::lock_guard<boost::recursive_mutex> l(this->state_mutex_);
 	bool invalidated = this->state.invalidate(step);
 	
 	// propagate to dependent steps
@@ -526,6 +596,11 @@ Print::apply_config(DynamicPrintConfig config)
 		// check whether the new config is different from the current one
 		if (object->invalidate_state_by_config(new_config))
 			invalidated = true;
+		
+		// the layer height ranges are object-specific too, a change only invalidates
+		// the layers above the lowest Z it touches
+		if (object->set_layer_height_ranges(object->model_object()->layer_height_ranges))
+			invalidated = true;
 	}
 	
 	// handle changes to regions config defaults
@@ -572,8 +647,8 @@ Print::apply_config(DynamicPrintConfig config)
 				}
 				
 				// if we're here and the new region config is different from the old
-				// one, we need to apply the new config and invalidate all objects
-				// (possible optimization: only invalidate objects using this region)
+				// one, we need to apply the new config and invalidate this region
+				// in the objects using it
 				if (region->invalidate_state_by_config(new_config))
 					invalidated = true;
 			}
@@ -1070,19 +1145,27 @@ Print::output_filepath(const std::string &path)
  *  generate support material, make brim等操作
  */
 void Print::Process() {
-	//生成Perimeter
+	// 线程池的大小由用户设置的线程数决定，此时线程池中没有正在运行的任务
+	ThreadPool::instance().resize(config.threads.value);
 
-	// 生成填充结构
+	// 各个PrintObject的处理流程(生成填充结构->生成支撑结构)之间相互独立，
+	// 因此将每一个PrintObject作为一个任务并行处理，
+	// 这些任务与每一层的parallel_for共享同一个线程池
+	TaskGroup object_tasks;
 	for (PrintObject* object : objects) {
-		object->Infill();
-		//qDebug() << " An object completed";
-	}
+		object_tasks.run([this, object]() {
+			ThrowIfCanceled();
+			object->Infill();
 
-	for (PrintObject* object : objects) {
-		object->GenerateSupportMaterial();
+			ThrowIfCanceled();
+			object->GenerateSupportMaterial();
+		});
 	}
-	SetProgressStatus(100, QString("Generating tool-path completed"));
-	SetProgressStatus(0, QString("Generating tool-path completed"));
+	//等待所有PrintObject处理完成，如果某一个任务被取消，则在此处重新抛出CanceledException
+	object_tasks.wait();
+
+	SetProgressStatus(100, "Generating tool-path completed");
+	SetProgressStatus(0, "Generating tool-path completed");
 }
 
 
@@ -1150,14 +1233,62 @@ void Print::MakeBrim() {
 }
 
 
-void Print::SetStatusBar(QStatusBar* statusbar,QProgressBar* progressbar) {
-	statusbar_ = statusbar;
-	progress_bar_ = progressbar;
+void Print::SetStatusCallback(StatusCallback callback) {
+	boost::lock_guard<boost::mutex> lock(status_mutex_);
+	status_callback_ = callback;
+}
+
+/*
+ *	更新处理进度，可能在后台线程中调用，回调函数的调用是串行的
+ */
+void Print::SetProgressStatus(int percentage, const std::string& status) {
+	boost::lock_guard<boost::mutex> lock(status_mutex_);
+	if (status_callback_) {
+		status_callback_(percentage, status);
+	}
+}
+
+LayerProgress::LayerProgress(Print* print, int first_percentage, int last_percentage, size_t layer_count, const std::string& status)
+	: print_(print),
+	first_percentage_(first_percentage),
+	last_percentage_(last_percentage),
+	layer_count_(std::max<size_t>(layer_count, 1)),
+	status_(status),
+	done_layers_(0),
+	percentage_(first_percentage) {
+	print_->SetProgressStatus(first_percentage_, status_);
 }
 
-void Print::SetProgressStatus(int percentage, QString& status) {
-	this->progress_bar_->setValue(percentage);
-	this->statusbar_->showMessage(status);
+void LayerProgress::LayerDone(size_t layers) {
+	size_t done_layers = done_layers_ += layers;
+	int percentage = first_percentage_ + int((last_percentage_ - first_percentage_) * std::min(done_layers, layer_count_) / layer_count_);
+
+	//多个线程同时完成时，只由将百分比增加的线程报告进度
+	int reported = percentage_;
+	while (percentage > reported) {
+		if (percentage_.compare_exchange_weak(reported, percentage)) {
+			print_->SetProgressStatus(percentage, status_);
+			break;
+		}
+	}
+}
+
+void Print::Cancel() {
+	canceled_ = true;
+}
+
+void Print::ResetCancel() {
+	canceled_ = false;
+}
+
+bool Print::IsCanceled() const {
+	return canceled_;
+}
+
+void Print::ThrowIfCanceled() const {
+	if (canceled_) {
+		throw CanceledException();
+	}
 }
 
 void Print::ClearFilamentStats() {
@@ -2,11 +2,13 @@
 #define slic3r_Print_hpp_
 
 #include "libslic3r.h"
+#include <map>
 #include <set>
 #include <string>
 #include <vector>
-#include <QStatusBar>
-#include <QProgressBar>
+#include <atomic>
+#include <exception>
+#include <functional>
 #include <boost/thread.hpp>
 
 #include "BoundingBox.hpp"
@@ -40,12 +42,26 @@ class PrintState
 {
 	public:
 	std::set<StepType> started, done;
+	// Layers (indices into PrintObject::layers) and regions (indices into
+	// Print::regions) of a step which need to be recomputed.
+	struct DirtyParts {
+		std::set<size_t> layers;
+		std::set<size_t> regions;
+	};
+	// Steps which are neither done nor fully invalidated: only the listed layers
+	// and regions need to be recomputed, the results of the others are still valid.
+	std::map<StepType, DirtyParts> dirty;
 	
 	bool is_started(StepType step) const;
 	bool is_done(StepType step) const;
 	void set_started(StepType step);
 	void set_done(StepType step);
 	bool invalidate(StepType step);
+	bool invalidate_layers(StepType step, const std::set<size_t> &layers);
+	bool invalidate_region(StepType step, size_t region_id);
+	bool is_layer_dirty(StepType step, size_t layer_id) const;
+	bool is_region_dirty(StepType step, size_t region_id) const;
+	bool is_dirty(StepType step, size_t layer_id, size_t region_id) const;
 };
 
 // A PrintRegion object represents a group of volumes to print
@@ -123,6 +139,8 @@ class PrintObject
 	size_t total_layer_count() const;
 	size_t layer_count() const;
 	void clear_layers();
+	// Deletes the layers from first_layer on, in parallel.
+	void delete_layers(size_t first_layer);
 	Layer* get_layer(int idx) { return this->layers.at(idx); };
 	const Layer* get_layer(int idx) const { return this->layers.at(idx); };
 	// print_z: top of the layer; slice_z: center of the layer.
@@ -139,7 +157,10 @@ class PrintObject
 	// methods for handling state
 	bool invalidate_state_by_config(const PrintConfigBase &config);
 	bool invalidate_step(PrintObjectStep step);
+	bool invalidate_layers(PrintObjectStep step, const std::set<size_t> &layers);
+	bool invalidate_region(PrintObjectStep step, size_t region_id);
 	bool invalidate_all_steps();
+	bool set_layer_height_ranges(const t_layer_height_ranges &ranges);
 	
 	bool has_support_material() const;
 	void detect_surfaces_type();
@@ -147,7 +168,7 @@ class PrintObject
 	void bridge_over_infill();
 	coordf_t adjust_layer_height(coordf_t layer_height) const;
 	std::vector<coordf_t> generate_object_layers(coordf_t first_layer_height);
-	void _slice();
+	size_t _slice();
 	std::vector<ExPolygons> _slice_region(size_t region_id, std::vector<float> z, bool modifier);
 	void _make_perimeters();
 	void _infill();
@@ -160,6 +181,20 @@ class PrintObject
 	ModelObject* _model_object;
 	Points _copies;      // Slic3r::Point objects in scaled G-code coordinates
 
+	// mesh of a region composed and aligned for slicing, kept together with its
+	// slicer so that a part of the object can be sliced again without rebuilding them
+	struct RegionSlicer {
+		TriangleMesh mesh;
+		TriangleMeshSlicer<Z>* slicer;
+		RegionSlicer() : slicer(NULL) {};
+		~RegionSlicer() { delete this->slicer; };
+	};
+	// indexed by (region_id, modifier)
+	std::map<std::pair<size_t, bool>, RegionSlicer*> _region_slicers;
+	void _clear_region_slicers();
+	bool _is_layer_dirty(PrintObjectStep step, size_t layer_idx) const;
+	bool _can_reuse_prepared_infill(size_t region_id) const;
+
 	// TODO: call model_object->get_bounding_box() instead of accepting
 		// parameter
 	PrintObject(Print* print, ModelObject* model_object, const BoundingBoxf3 &modobj_bbox);
@@ -176,15 +211,54 @@ public:
 	void DiscoverHorizontalShells();
 	void ClipFillSurfaces();
 	void CombineInfill();
-	void SimplySlices(double distance);
+	void SimplySlices(double distance, size_t first_layer = 0);
 	void DetectSurfaceType();
 	void GenerateSupportMaterial();
+
+private:
+	void DiscoverLayerHorizontalShells(int region_id, int layer_id);
+	void CombineLayersInfill(int region_id, int layer_id, int layers);
 	
 };
 
 typedef std::vector<PrintObject*> PrintObjectPtrs;
 typedef std::vector<PrintRegion*> PrintRegionPtrs;
 
+/*
+ *	̨ȡʱPrint::ThrowIfCanceled()׳ɵPrint::Process()̲߳
+ */
+class CanceledException : public std::exception
+{
+public:
+	const char* what() const throw() { return "Background processing has been canceled"; }
+};
+
+/*
+ *	Ȼص<percentage, status>ں̨߳бã
+ *  ˻صҪнתGUI߳
+ */
+typedef std::function<void(int, const std::string&)> StatusCallback;
+
+/*
+ *	㱨ĳһĽȣڶ߳ͬʱLayerDone()
+ *  ɵĲӳ䵽[first_percentage, last_percentage]ٷֱʱŵPrint::SetProgressStatus()
+ */
+class LayerProgress
+{
+public:
+	LayerProgress(Print* print, int first_percentage, int last_percentage, size_t layer_count, const std::string& status);
+	void LayerDone(size_t layers = 1);
+
+private:
+	Print* print_;
+	int first_percentage_;
+	int last_percentage_;
+	size_t layer_count_;
+	std::string status_;
+	std::atomic<size_t> done_layers_;
+	std::atomic<int> percentage_;
+};
+
 // The complete print tray with possibly multiple objects.
 class Print
 {
@@ -262,13 +336,25 @@ public:
 	void Process();
 	void MakeSkirt();
 	void MakeBrim();
-	QStatusBar* statusbar_;
-	QProgressBar* progress_bar_;
-	void SetStatusBar(QStatusBar* statusbar, QProgressBar* progressbar);
-	void SetProgressStatus(int percentage, QString& status);
+	void SetStatusCallback(StatusCallback callback);
+	void SetProgressStatus(int percentage, const std::string& status);
 	void ClearFilamentStats();
 	void SetFilamentStats(int extruder_id, double length);
 	void ExportGCode(char* file_path);
+
+	//ȡ̨߳е
+	void Cancel();
+	void ResetCancel();
+	bool IsCanceled() const;
+	//еȡ㣬ѱȡ׳CanceledException
+	void ThrowIfCanceled() const;
+
+private:
+	StatusCallback status_callback_;
+	boost::mutex status_mutex_;
+	//дPrintObjectʱPrint::state
+	boost::recursive_mutex state_mutex_;
+	std::atomic<bool> canceled_;
 };
 
 #define FOREACH_BASE(type, container, iterator) for (type::const_iterator iterator = (container).begin(); iterator != (container).end(); ++iterator)
@@ -23,6 +23,23 @@ PrintConfigDef::PrintConfigDef()
 	
 	ConfigOptionDef* def;
 	
+	def = this->add("adaptive_slicing", coBool);
+	def->label = "Use adaptive slicing";
+	def->category = "Layers and Perimeters";
+	def->tooltip = "Automatically determine layer heights from the slope of the object surfaces: vertical walls are printed with thick layers, sloped and curved surfaces with thinner ones. Heights are kept between half the layer height and 75% of the nozzle diameter. Manual layer height ranges still apply.";
+	def->cli = "adaptive-slicing!";
+	def->default_value = new ConfigOptionBool(false);
+
+	def = this->add("adaptive_slicing_quality", coPercent);
+	def->label = "Adaptive quality";
+	def->category = "Layers and Perimeters";
+	def->tooltip = "Controls the quality / printing time tradeoff of adaptive slicing. 0% gives the thickest layers the surface slope allows, 100% the thinnest ones.";
+	def->sidetext = "%";
+	def->cli = "adaptive-slicing-quality=s";
+	def->min = 0;
+	def->max = 100;
+	def->default_value = new ConfigOptionPercent(75);
+
 	def = this->add("avoid_crossing_perimeters", coBool);
 	def->label = "Avoid crossing perimeters";
 	def->category = "Layers and Perimeters";
@@ -1440,10 +1457,12 @@ PrintConfigDef::PrintConfigDef()
 	def->enum_values.push_back("rectilinear-grid");
 	def->enum_values.push_back("honeycomb");
 	def->enum_values.push_back("pillars");
+	def->enum_values.push_back("tree");
 	def->enum_labels.push_back("rectilinear");
 	def->enum_labels.push_back("rectilinear grid");
 	def->enum_labels.push_back("honeycomb");
 	def->enum_labels.push_back("pillars");
+	def->enum_labels.push_back("tree");
 	def->default_value = new ConfigOptionEnum<SupportMaterialPattern>(smpPillars);
 
 	def = this->add("support_material_spacing", coFloat);
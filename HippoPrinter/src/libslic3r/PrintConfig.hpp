@@ -37,7 +37,7 @@ enum InfillPattern {
 };
 
 enum SupportMaterialPattern {
-    smpRectilinear, smpRectilinearGrid, smpHoneycomb, smpPillars,
+    smpRectilinear, smpRectilinearGrid, smpHoneycomb, smpPillars, smpTree,
 };
 
 enum SeamPosition {
@@ -81,6 +81,7 @@ template<> inline t_config_enum_values ConfigOptionEnum<SupportMaterialPattern>:
     keys_map["rectilinear-grid"]    = smpRectilinearGrid;
     keys_map["honeycomb"]           = smpHoneycomb;
     keys_map["pillars"]             = smpPillars;
+    keys_map["tree"]                = smpTree;
     return keys_map;
 }
 
@@ -143,6 +144,8 @@ class StaticPrintConfig : public PrintConfigBase, public StaticConfig
 class PrintObjectConfig : public virtual StaticPrintConfig
 {
     public:
+    ConfigOptionBool                adaptive_slicing;
+    ConfigOptionPercent             adaptive_slicing_quality;
     ConfigOptionBool                dont_support_bridges;
     ConfigOptionFloatOrPercent      extrusion_width;
     ConfigOptionFloatOrPercent      first_layer_height;
@@ -174,6 +177,8 @@ class PrintObjectConfig : public virtual StaticPrintConfig
     }
     
     virtual ConfigOption* optptr(const t_config_option_key &opt_key, bool create = false) {
+        OPT_PTR(adaptive_slicing);
+        OPT_PTR(adaptive_slicing_quality);
         OPT_PTR(dont_support_bridges);
         OPT_PTR(extrusion_width);
         OPT_PTR(first_layer_height);
@@ -1,11 +1,15 @@
 ﻿#include "Print.hpp"
 #include "SupportMaterial.hpp"
+#include "SlicingAdaptive.hpp"
 #include "BoundingBox.hpp"
 #include "ClipperUtils.hpp"
 #include "Geometry.hpp"
 #include <algorithm>
 #include <vector>
+#include <limits>
 #include <map>
+#include <cstdint>
+#include <cstring>
 
 namespace Slic3r {
 
@@ -36,6 +40,9 @@ PrintObject::PrintObject(Print* print, ModelObject* model_object, const Bounding
 
 PrintObject::~PrintObject()
 {
+	this->clear_layers();
+	this->clear_support_layers();
+	this->_clear_region_slicers();
 }
 
 Print*
@@ -144,6 +151,7 @@ void
 PrintObject::add_region_volume(int region_id, int volume_id)
 {
 	region_volumes[region_id].push_back(volume_id);
+	this->_clear_region_slicers();
 }
 
 /*  This is the *total* layer count (including support layers)
@@ -164,8 +172,27 @@ PrintObject::layer_count() const
 void
 PrintObject::clear_layers()
 {
-	for (int i = this->layers.size()-1; i >= 0; --i)
-		this->delete_layer(i);
+	this->delete_layers(0);
+}
+
+void
+PrintObject::delete_layers(size_t first_layer)
+{
+	if (first_layer >= this->layers.size()) return;
+	// Freeing the toolpaths of the layers takes a while on large prints, the layers are
+	// deleted in parallel. A layer unlinks its neighbours when deleted, so cut the links
+	// first to leave the layers independent of each other.
+	if (first_layer > 0)
+		this->layers[first_layer - 1]->upper_layer = NULL;
+	for (size_t layer_idx = first_layer; layer_idx < this->layers.size(); ++ layer_idx)
+		this->layers[layer_idx]->upper_layer = this->layers[layer_idx]->lower_layer = NULL;
+	parallel_for(first_layer, this->layers.size(),
+		[this](size_t layer_idx) {
+			delete this->layers[layer_idx];
+		},
+		1
+	);
+	this->layers.erase(this->layers.begin() + first_layer, this->layers.end());
 }
 
 Layer*
@@ -193,8 +220,15 @@ PrintObject::support_layer_count() const
 void
 PrintObject::clear_support_layers()
 {
-	for (int i = this->support_layers.size()-1; i >= 0; --i)
-		this->delete_support_layer(i);
+	for (SupportLayer* layer : this->support_layers)
+		layer->upper_layer = layer->lower_layer = NULL;
+	parallel_for(size_t(0), this->support_layers.size(),
+		[this](size_t layer_idx) {
+			delete this->support_layers[layer_idx];
+		},
+		1
+	);
+	this->support_layers.clear();
 }
 
 SupportLayer*
@@ -225,6 +259,8 @@ PrintObject::invalidate_state_by_config(const PrintConfigBase &config)
 	for (const t_config_option_key &opt_key : diff) {
 		if (opt_key == "layer_height"
 			|| opt_key == "first_layer_height"
+			|| opt_key == "adaptive_slicing"
+			|| opt_key == "adaptive_slicing_quality"
 			|| opt_key == "xy_size_compensation"
 			|| opt_key == "raft_layers"
 			|| opt_key == "regions_overlap") {
@@ -306,6 +342,69 @@ PrintObject::invalidate_step(PrintObjectStep step)
 	return invalidated;
 }
 
+// Invalidates a step only for the given layers (indices into this->layers)
+// and the layers depending on them.
+bool
+PrintObject::invalidate_layers(PrintObjectStep step, const std::set<size_t> &layers)
+{
+	bool invalidated = this->state.invalidate_layers(step, layers);
+	
+	// propagate to dependent steps
+	if (step == posSlice) {
+		// perimeters read the slices of the layer above (extra perimeters)
+		// and of the layer below (overhangs)
+		std::set<size_t> perimeter_layers;
+		for (std::set<size_t>::const_iterator it = layers.begin(); it != layers.end(); ++it) {
+			if (*it > 0) perimeter_layers.insert(*it - 1);
+			perimeter_layers.insert(*it);
+			perimeter_layers.insert(*it + 1);
+		}
+		this->invalidate_layers(posPerimeters, perimeter_layers);
+		this->state.invalidate(posDetectSurfaces);
+		this->invalidate_step(posSupportMaterial);
+	} else if (step == posPerimeters) {
+		this->invalidate_layers(posPrepareInfill, layers);
+		this->_print->invalidate_step(psSkirt);
+		this->_print->invalidate_step(psBrim);
+	} else if (step == posPrepareInfill) {
+		// horizontal shells and combined infill span many layers, so it is not
+		// known in advance which fill surfaces will change; only the layers whose
+		// fill surfaces came out different get new fills
+		this->invalidate_layers(posInfill, std::set<size_t>());
+	} else if (step == posInfill) {
+		this->_print->invalidate_step(psSkirt);
+		this->_print->invalidate_step(psBrim);
+	}
+	
+	return invalidated;
+}
+
+// Invalidates a step only for one region (index into Print::regions) and the
+// steps depending on it. Slicing, surface detection and support material work
+// on whole layers, so those steps are invalidated for the whole object.
+bool
+PrintObject::invalidate_region(PrintObjectStep step, size_t region_id)
+{
+	if (step == posSlice || step == posDetectSurfaces || step == posSupportMaterial)
+		return this->invalidate_step(step);
+	
+	bool invalidated = this->state.invalidate_region(step, region_id);
+	
+	// propagate to dependent steps
+	if (step == posPerimeters) {
+		this->invalidate_region(posPrepareInfill, region_id);
+		this->_print->invalidate_step(psSkirt);
+		this->_print->invalidate_step(psBrim);
+	} else if (step == posPrepareInfill) {
+		this->invalidate_region(posInfill, region_id);
+	} else if (step == posInfill) {
+		this->_print->invalidate_step(psSkirt);
+		this->_print->invalidate_step(psBrim);
+	}
+	
+	return invalidated;
+}
+
 bool
 PrintObject::invalidate_all_steps()
 {
@@ -319,6 +418,36 @@ PrintObject::invalidate_all_steps()
 	return invalidated;
 }
 
+// Replaces the custom layer height ranges. The layers below the lowest Z touched
+// by the change keep their heights, so only the layers above it are invalidated.
+bool
+PrintObject::set_layer_height_ranges(const t_layer_height_ranges &ranges)
+{
+	if (ranges == this->layer_height_ranges) return false;
+	
+	coordf_t min_z = std::numeric_limits<coordf_t>::max();
+	for (t_layer_height_ranges::const_iterator it = ranges.begin(); it != ranges.end(); ++it) {
+		t_layer_height_ranges::const_iterator old = this->layer_height_ranges.find(it->first);
+		if (old == this->layer_height_ranges.end() || old->second != it->second)
+			min_z = std::min(min_z, it->first.first);
+	}
+	for (t_layer_height_ranges::const_iterator it = this->layer_height_ranges.begin(); it != this->layer_height_ranges.end(); ++it) {
+		if (ranges.find(it->first) == ranges.end())
+			min_z = std::min(min_z, it->first.first);
+	}
+	this->layer_height_ranges = ranges;
+	
+	// the height of a layer is picked by its bottom Z
+	std::set<size_t> layers;
+	for (size_t i = 0; i < this->layers.size(); ++i) {
+		const Layer* layer = this->layers[i];
+		if (layer->slice_z - layer->height/2 >= min_z - EPSILON)
+			layers.insert(i);
+	}
+	this->invalidate_layers(posSlice, layers);
+	return true;
+}
+
 bool
 PrintObject::has_support_material() const
 {
@@ -336,10 +465,13 @@ PrintObject::detect_surfaces_type()
 	if (this->state.is_done(posDetectSurfaces)) return;
 	this->state.set_started(posDetectSurfaces);
 	
-	parallelize<Layer*>(
-		std::queue<Layer*>(std::deque<Layer*>(this->layers.begin(), this->layers.end())),  // cast LayerPtrs to std::queue<Layer*>
-		boost::bind(&Slic3r::Layer::detect_surfaces_type, _1),
-		this->_print->config.threads.value
+	parallel_for(size_t(0), this->layers.size(),
+		[this](size_t layer_idx) {
+			// abandon the remaining layers as soon as the print is canceled
+			this->_print->ThrowIfCanceled();
+			this->layers[layer_idx]->detect_surfaces_type();
+		},
+		1
 	);
 	
 	this->typed_slices = true;
@@ -349,10 +481,13 @@ PrintObject::detect_surfaces_type()
 void
 PrintObject::process_external_surfaces()
 {
-	parallelize<Layer*>(
-		std::queue<Layer*>(std::deque<Layer*>(this->layers.begin(), this->layers.end())),  // cast LayerPtrs to std::queue<Layer*>
-		boost::bind(&Slic3r::Layer::process_external_surfaces, _1),
-		this->_print->config.threads.value
+	parallel_for(size_t(0), this->layers.size(),
+		[this](size_t layer_idx) {
+			// abandon the remaining layers as soon as the print is canceled
+			this->_print->ThrowIfCanceled();
+			this->layers[layer_idx]->process_external_surfaces();
+		},
+		1
 	);
 }
 
@@ -567,11 +702,40 @@ std::vector<coordf_t> PrintObject::generate_object_layers(coordf_t first_layer_h
 		result.push_back(first_layer_height);
 	}
 
+	// adaptive slicing: layers between half the layer height and 75% of the nozzle diameter,
+	// thick on vertical walls and thin on sloped surfaces (see SlicingAdaptive)
+	SlicingAdaptive adaptive;
+	coordf_t min_height = layer_height / 2;
+	coordf_t max_height = layer_height;
+	coordf_t cusp_value = layer_height;
+	if (this->config.adaptive_slicing.value) {
+		max_height = std::max(layer_height,
+			std::min(0.75 * min_nozzle_diameter, this->_print->max_allowed_layer_height()));
+		coordf_t quality = this->config.adaptive_slicing_quality.value / 100;
+		cusp_value = (1 - quality) * max_height + quality * min_height;
+
+		// the object meshes placed as in _slice_region(), only their z matters here
+		ModelObject &object = *this->model_object();
+		TriangleMesh mesh;
+		for (const ModelVolume* volume : object.volumes)
+			if (! volume->modifier)
+				mesh.merge(volume->mesh);
+		if (mesh.facets_count() > 0) {
+			object.instances[0]->transform_mesh(&mesh, true);
+			mesh.translate(0, 0, -object.bounding_box().min.z);
+			adaptive.add_mesh(mesh);
+			adaptive.prepare();
+		}
+	}
+
 	coordf_t print_z = first_layer_height;
 	coordf_t height = first_layer_height;
 	// loop until we have at least one layer and the max slice_z reaches the object height
 	while (print_z < unscale(this->size.z)) {
 		height = layer_height;
+		if (! adaptive.empty())
+			height = this->adjust_layer_height(
+				adaptive.next_layer_height(print_z, cusp_value, min_height, max_height));
 
 		// look for an applicable custom range
 		for (t_layer_height_ranges::const_iterator it_range = this->layer_height_ranges.begin(); it_range != this->layer_height_ranges.end(); ++ it_range) {
@@ -623,8 +787,12 @@ std::vector<coordf_t> PrintObject::generate_object_layers(coordf_t first_layer_h
 // 6) Replaces bad slices by the slices reconstructed from the upper/lower layer
 // Resulting expolygons of layer regions are marked as Internal.
 //
+// When only some layers were invalidated (see set_layer_height_ranges()), the bottom
+// layers which would be generated again at the very same heights are kept.
+// Returns the index of the first newly sliced layer.
+//
 // this should be idempotent
-void PrintObject::_slice()
+size_t PrintObject::_slice()
 {
 
 	coordf_t raft_height = 0; // 	coordf_t print_z = 0;// 	coordf_t height  = 0;
@@ -662,16 +830,47 @@ void PrintObject::_slice()
 
 	// Initialize layers and their slice heights.
 	std::vector<float> slice_zs;
+	const std::map<PrintObjectStep, PrintState<PrintObjectStep>::DirtyParts>::iterator dirty = this->state.dirty.find(posSlice);
+	size_t first_layer = 0;
 	{
-		this->clear_layers();
 		// All print_z values for this object, without the raft.
 		std::vector<coordf_t> object_layers = this->generate_object_layers(first_layer_height);
-		// Reserve object layers for the raft. Last layer of the raft is the contact layer.
-		slice_zs.reserve(object_layers.size());
-		Layer *prev = nullptr;
 		coordf_t lo = raft_height;
 		coordf_t hi = lo;
-		for (size_t i_layer = 0; i_layer < object_layers.size(); i_layer++) {
+		if (dirty != this->state.dirty.end()) {
+			// Keep the layers below the first dirty one as long as they match the new ones exactly.
+			size_t max_kept = std::min(this->layers.size(), object_layers.size());
+			if (!dirty->second.layers.empty())
+				max_kept = std::min(max_kept, *dirty->second.layers.begin());
+			for (; first_layer < max_kept; ++first_layer) {
+				const Layer *layer = this->layers[first_layer];
+				const coordf_t next_hi = object_layers[first_layer] + raft_height;
+				if (layer->id() != id + first_layer
+					|| layer->height != next_hi - hi
+					|| layer->print_z != next_hi
+					|| layer->slice_z != 0.5 * (hi + next_hi) - raft_height
+					|| layer->slicing_errors
+					|| layer->regions.size() != this->_print->regions.size())
+					break;
+				lo = hi;
+				hi = next_hi;
+			}
+			// don't trust the layers sliced from here on if the slicing gets canceled
+			dirty->second.layers.insert(first_layer);
+			// the kept layers get back their slices as the slicing left them
+			for (size_t layer_id = 0; layer_id < first_layer; ++ layer_id)
+				for (LayerRegion *layerm : this->layers[layer_id]->regions)
+					layerm->slices = layerm->raw_slices;
+		} else {
+			// a full re-slicing may follow a change of the meshes
+			this->_clear_region_slicers();
+		}
+		this->delete_layers(first_layer);
+		id += int(first_layer);
+		// Reserve object layers for the raft. Last layer of the raft is the contact layer.
+		slice_zs.reserve(object_layers.size() - first_layer);
+		Layer *prev = this->layers.empty() ? nullptr : this->layers.back();
+		for (size_t i_layer = first_layer; i_layer < object_layers.size(); i_layer++) {
 			lo = hi;  // store old value
 			hi = object_layers[i_layer] + raft_height;
 			coordf_t slice_z = 0.5 * (lo + hi) - raft_height;
@@ -692,23 +891,25 @@ void PrintObject::_slice()
 		// Optimized for a single region. Slice the single non-modifier mesh.
 		std::vector<ExPolygons> expolygons_by_layer = this->_slice_region(0, slice_zs, false);
 		for (size_t layer_id = 0; layer_id < expolygons_by_layer.size(); ++ layer_id)
-			this->layers[layer_id]->regions.front()->slices.append(std::move(expolygons_by_layer[layer_id]), stInternal);
+			this->layers[first_layer + layer_id]->regions.front()->slices.append(std::move(expolygons_by_layer[layer_id]), stInternal);
 	} else {
 		// Slice all non-modifier volumes.
 		for (size_t region_id = 0; region_id < this->print()->regions.size(); ++ region_id) {
+			this->_print->ThrowIfCanceled();
 			std::vector<ExPolygons> expolygons_by_layer = this->_slice_region(region_id, slice_zs, false);
 			for (size_t layer_id = 0; layer_id < expolygons_by_layer.size(); ++ layer_id)
-				this->layers[layer_id]->regions[region_id]->slices.append(std::move(expolygons_by_layer[layer_id]), stInternal);
+				this->layers[first_layer + layer_id]->regions[region_id]->slices.append(std::move(expolygons_by_layer[layer_id]), stInternal);
 		}
 		// Slice all modifier volumes.
 		for (size_t region_id = 0; region_id < this->print()->regions.size(); ++ region_id) {
+			this->_print->ThrowIfCanceled();
 			std::vector<ExPolygons> expolygons_by_layer = this->_slice_region(region_id, slice_zs, true);
 			// loop through the other regions and 'steal' the slices belonging to this one
 			for (size_t other_region_id = 0; other_region_id < this->print()->regions.size(); ++ other_region_id) {
 				if (region_id == other_region_id)
 					continue;
 				for (size_t layer_id = 0; layer_id < expolygons_by_layer.size(); ++ layer_id) {
-					Layer       *layer = layers[layer_id];
+					Layer       *layer = layers[first_layer + layer_id];
 					LayerRegion *layerm = layer->regions[region_id];
 					LayerRegion *other_layerm = layer->regions[other_region_id];
 					if (layerm == nullptr || other_layerm == nullptr)
@@ -727,9 +928,10 @@ void PrintObject::_slice()
 	}
 
 	// remove last layer(s) if empty
+	size_t last_layer = this->layers.size();
 	bool done = false;
-	while (! this->layers.empty()) {
-		const Layer *layer = this->layers.back();
+	while (last_layer > 0) {
+		const Layer *layer = this->layers[last_layer - 1];
 		for (size_t region_id = 0; region_id < this->print()->regions.size(); ++ region_id)
 			if (layer->regions[region_id] != nullptr && ! layer->regions[region_id]->slices.empty()) {
 				done = true;
@@ -738,8 +940,9 @@ void PrintObject::_slice()
 		if(done) {
 			break;
 		}
-		this->delete_layer(int(this->layers.size()) - 1);
+		-- last_layer;
 	}
+	this->delete_layers(last_layer);
 
 // 	for (size_t layer_id = 0; layer_id < layers.size(); ++ layer_id) {
 // 		Layer *layer = this->layers[layer_id];
@@ -775,7 +978,9 @@ void PrintObject::_slice()
 // 	}
 // Apply size compensation and perform clipping of multi-part objects.
 	const coord_t xy_size_compensation = scale_(this->config.xy_size_compensation.value);
-	for (Layer* layer : this->layers) {
+	for (size_t layer_id = first_layer; layer_id < this->layers.size(); ++ layer_id) {
+		Layer* layer = this->layers[layer_id];
+		this->_print->ThrowIfCanceled();
 		if (xy_size_compensation > 0) {
 			if (layer->regions.size() == 1) {
 				// Single region, growing or shrinking.
@@ -825,6 +1030,15 @@ void PrintObject::_slice()
 // 				);
 // 		}
 	}
+
+	if (dirty != this->state.dirty.end()) {
+		// the layer below the new ones loses the upper layer its perimeters were made against
+		std::set<size_t> new_layers;
+		for (size_t layer_id = (first_layer > 0) ? first_layer - 1 : 0; layer_id < this->layers.size(); ++ layer_id)
+			new_layers.insert(layer_id);
+		this->invalidate_layers(posPerimeters, new_layers);
+	}
+	return first_layer;
 }
 
 // called from slice()
@@ -835,51 +1049,154 @@ PrintObject::_slice_region(size_t region_id, std::vector<float> z, bool modifier
 	std::vector<int> &region_volumes = this->region_volumes[region_id];
 	if (region_volumes.empty()) return layers;
 	
-	ModelObject &object = *this->model_object();
-	
-	// compose mesh
-	TriangleMesh mesh;
-	for (std::vector<int>::const_iterator it = region_volumes.begin();
-		it != region_volumes.end(); ++it) {
+	RegionSlicer* &region_slicer = this->_region_slicers[std::make_pair(region_id, modifier)];
+	if (region_slicer == NULL) {
+		region_slicer = new RegionSlicer();
+		ModelObject &object = *this->model_object();
 		
-		const ModelVolume &volume = *object.volumes[*it];
-		if (volume.modifier != modifier) continue;
-		
-		mesh.merge(volume.mesh);
+		// compose mesh
+		TriangleMesh &mesh = region_slicer->mesh;
+		for (std::vector<int>::const_iterator it = region_volumes.begin();
+			it != region_volumes.end(); ++it) {
+			
+			const ModelVolume &volume = *object.volumes[*it];
+			if (volume.modifier != modifier) continue;
+			
+			mesh.merge(volume.mesh);
+		}
+		if (mesh.facets_count() > 0) {
+			// transform mesh
+			// we ignore the per-instance transformations currently and only 
+			// consider the first one
+			object.instances[0]->transform_mesh(&mesh, true);
+
+			// align mesh to Z = 0 (it should be already aligned actually) and apply XY shift
+			mesh.translate(
+				-unscale(this->_copies_shift.x),
+				-unscale(this->_copies_shift.y),
+				-object.bounding_box().min.z
+			);
+			region_slicer->slicer = new TriangleMeshSlicer<Z>(&mesh);
+		}
 	}
-	if (mesh.facets_count() == 0) return layers;
-
-	// transform mesh
-	// we ignore the per-instance transformations currently and only 
-	// consider the first one
-	object.instances[0]->transform_mesh(&mesh, true);
-
-	// align mesh to Z = 0 (it should be already aligned actually) and apply XY shift
-	mesh.translate(
-		-unscale(this->_copies_shift.x),
-		-unscale(this->_copies_shift.y),
-		-object.bounding_box().min.z
-	);
+	if (region_slicer->slicer == NULL) return layers;
 	
 	// perform actual slicing
-	TriangleMeshSlicer<Z>(&mesh).slice(z, &layers);
+	region_slicer->slicer->slice(z, &layers);
 	return layers;
 }
 
+void
+PrintObject::_clear_region_slicers()
+{
+	for (std::map<std::pair<size_t, bool>, RegionSlicer*>::iterator it = this->_region_slicers.begin();
+		it != this->_region_slicers.end(); ++it)
+		delete it->second;
+	this->_region_slicers.clear();
+}
+
+// true if a step has to be recomputed on a layer, either because the layer itself
+// is dirty or because one of the dirty regions has slices on it
+bool
+PrintObject::_is_layer_dirty(PrintObjectStep step, size_t layer_idx) const
+{
+	if (this->state.is_layer_dirty(step, layer_idx))
+		return true;
+	const Layer* layer = this->layers[layer_idx];
+	for (size_t region_id = 0; region_id < layer->regions.size(); ++region_id)
+		if (this->state.is_region_dirty(step, region_id) && !layer->regions[region_id]->raw_slices.empty())
+			return true;
+	return false;
+}
+
+// The slices of the layers along a prismatic part of the object only differ by the
+// points the slicing adds where it cuts the side facets, which lie on the edges of
+// the outlines, and by rounding. Such layers get the toolpaths of each other, which
+// are copied from one to the other, and are told by their outlines following each
+// other within SCALED_RESOLUTION, the error allowed when simplifying the toolpaths.
+
+// true if the points of a follow the edges of b in order, starting from its first edge
+static bool
+follows(const Polygon &a, const Polygon &b)
+{
+	if (b.points.empty()) return a.points.empty();
+	size_t edge = 0;
+	for (const Point &point : a.points)
+		while (point.distance_to(Line(b.points[edge], b.points[(edge + 1) % b.points.size()])) > SCALED_RESOLUTION)
+			if (++ edge == b.points.size())
+				return false;
+	return true;
+}
+
+static bool
+similar_expolygons(const ExPolygon &a, const ExPolygon &b)
+{
+	if (a.holes.size() != b.holes.size()
+		|| !follows(a.contour, b.contour) || !follows(b.contour, a.contour))
+		return false;
+	for (size_t i = 0; i < a.holes.size(); ++i)
+		if (!follows(a.holes[i], b.holes[i]) || !follows(b.holes[i], a.holes[i]))
+			return false;
+	return true;
+}
+
+static bool
+similar_expolygons(const ExPolygons &a, const ExPolygons &b)
+{
+	if (a.size() != b.size()) return false;
+	for (size_t i = 0; i < a.size(); ++i)
+		if (!similar_expolygons(a[i], b[i]))
+			return false;
+	return true;
+}
+
+// same_surfaces() for the outlines following each other
+static bool
+similar_surfaces(const Surfaces &a, const Surfaces &b)
+{
+	if (a.size() != b.size()) return false;
+	for (size_t i = 0; i < a.size(); ++i) {
+		const Surface &sa = a[i];
+		const Surface &sb = b[i];
+		if (sa.surface_type != sb.surface_type
+			|| sa.thickness != sb.thickness
+			|| sa.thickness_layers != sb.thickness_layers
+			|| sa.bridge_angle != sb.bridge_angle
+			|| sa.extra_perimeters != sb.extra_perimeters
+			|| !similar_expolygons(sa.expolygon, sb.expolygon))
+			return false;
+	}
+	return true;
+}
+
 void
 PrintObject::_make_perimeters()
 {
 	if (this->state.is_done(posPerimeters)) return;
 	this->state.set_started(posPerimeters);
 
-	// merge slices if they were split into types
-	// This is not currently taking place because since merge_slices + detect_surfaces_type
-	// are not truly idempotent we are invalidating posSlice here (see the Perl part of 
-	// this method).
+	// Undo the steps following make_perimeters(). Since merge_slices + detect_surfaces_type
+	// are not truly idempotent, the layers whose perimeters have to be generated again
+	// restart from the slices left by Slice(), the other ones get back the surfaces
+	// left by their last make_perimeters().
+	std::vector<bool> dirty(this->layers.size());
+	for (size_t layer_idx = 0; layer_idx < this->layers.size(); ++layer_idx)
+		dirty[layer_idx] = this->_is_layer_dirty(posPerimeters, layer_idx);
+	FOREACH_LAYER(this, layer_it) {
+		FOREACH_LAYERREGION(*layer_it, layerm_it) {
+			LayerRegion &layerm = **layerm_it;
+			if (dirty[layer_it - this->layers.begin()]) {
+				layerm.slices = layerm.raw_slices;
+				layerm.fill_surfaces.clear();
+			} else {
+				layerm.slices = layerm.perimeter_slices;
+				layerm.fill_surfaces = layerm.perimeter_fill_surfaces;
+			}
+			layerm.bridged.clear();
+			layerm.unsupported_bridge_edges.polylines.clear();
+		}
+	}
 	if (this->typed_slices) {
-		// merge_slices() undoes detect_surfaces_type()
-		FOREACH_LAYER(this, layer_it)
-			(*layer_it)->merge_slices();
 		this->typed_slices = false;
 		this->state.invalidate(posDetectSurfaces);
 	}
@@ -901,9 +1218,17 @@ PrintObject::_make_perimeters()
 			|| this->layer_count() < 2) continue;
 		
 		for (size_t i = 0; i <= (this->layer_count()-2); ++i) {
+			if (!dirty[i]) continue;
+			this->_print->ThrowIfCanceled();
 			LayerRegion &layerm                     = *this->get_layer(i)->get_region(region_id);
 			const LayerRegion &upper_layerm         = *this->get_layer(i+1)->get_region(region_id);
 			
+			// Upper slices following the ones of this layer, as all along the prismatic
+			// parts of the object, stay within SCALED_RESOLUTION of their outlines, out of
+			// the critical areas defined below.
+			if (similar_surfaces(layerm.slices.surfaces, upper_layerm.slices.surfaces))
+				continue;
+			
 			// In order to avoid diagonal gaps (GH #3732) we ignore the external half of the upper
 			// perimeter, since it's not truly covering this layer.
 			const Polygons upper_layerm_polygons = offset(
@@ -974,11 +1299,80 @@ PrintObject::_make_perimeters()
 		}
 	}
 	
-	parallelize<Layer*>(
-		std::queue<Layer*>(std::deque<Layer*>(this->layers.begin(), this->layers.end())),  // cast LayerPtrs to std::queue<Layer*>
-		boost::bind(&Slic3r::Layer::make_perimeters, _1),
-		this->_print->config.threads.value
-	);
+	// The perimeters only depend on the slices of the layer (and on the ones of the
+	// lower layer for the overhangs), on its height and on whether it is the first one,
+	// so along the prismatic parts of the object the perimeters of the first layer are
+	// copied to the next ones. The layers are matched whether they are dirty or not, for
+	// getting the same perimeters as when all of them are done again.
+	bool overhangs = false;
+	FOREACH_REGION(this->_print, region_it)
+		overhangs = overhangs || (*region_it)->config.overhangs;
+	// layer whose perimeters are copied, or the layer itself
+	std::vector<size_t> same_layer(this->layers.size());
+	size_t first_layer = size_t(-1);
+	for (size_t layer_idx = 0; layer_idx < this->layers.size(); ++layer_idx) {
+		const Layer *layer = this->layers[layer_idx];
+		// the first object layer has no lower layer and its perimeters are never copied;
+		// test the index, with a raft its id() is not 0
+		bool same = first_layer != size_t(-1)
+			&& first_layer > 0
+			&& std::abs(layer->height - this->layers[first_layer]->height) < EPSILON
+			&& (!overhangs || similar_expolygons(layer->lower_layer->slices.expolygons,
+				this->layers[first_layer]->lower_layer->slices.expolygons));
+		for (size_t region_id = 0; same && region_id < layer->regions.size(); ++region_id)
+			same = similar_surfaces(layer->regions[region_id]->slices.surfaces,
+				this->layers[first_layer]->regions[region_id]->slices.surfaces);
+		same_layer[layer_idx] = same ? first_layer : layer_idx;
+		if (!same)
+			first_layer = layer_idx;
+	}
+	// Besides the dirty layers, the ones whose perimeters were copied from another layer
+	// (or to which the perimeters of a layer done again were copied) are updated.
+	std::vector<bool> update(this->layers.size());
+	for (size_t layer_idx = 0; layer_idx < this->layers.size(); ++layer_idx) {
+		const Layer *layer = this->layers[layer_idx];
+		const Layer *other = this->layers[same_layer[layer_idx]];
+		update[layer_idx] = dirty[layer_idx] || (layer != other && update[same_layer[layer_idx]]);
+		for (size_t region_id = 0; region_id < layer->regions.size(); ++region_id)
+			if (layer->regions[region_id]->perimeters_from != other->regions[region_id])
+				update[layer_idx] = true;
+	}
+	
+	for (int copy = 0; copy < 2; ++copy)
+		parallel_for(size_t(0), this->layers.size(),
+			[this, &update, &same_layer, copy](size_t layer_idx) {
+				if (!update[layer_idx] || (same_layer[layer_idx] != layer_idx) != bool(copy)) return;
+				// abandon the remaining layers as soon as the print is canceled
+				this->_print->ThrowIfCanceled();
+				Layer *layer = this->layers[layer_idx];
+				const Layer *other = this->layers[same_layer[layer_idx]];
+				if (copy) {
+					for (size_t region_id = 0; region_id < layer->regions.size(); ++region_id) {
+						LayerRegion &layerm = *layer->regions[region_id];
+						const LayerRegion &other_layerm = *other->regions[region_id];
+						layerm.perimeters    = other_layerm.perimeters;
+						layerm.thin_fills    = other_layerm.thin_fills;
+						layerm.fill_surfaces = other_layerm.fill_surfaces;
+					}
+				} else {
+					layer->make_perimeters();
+				}
+				for (size_t region_id = 0; region_id < layer->regions.size(); ++region_id) {
+					LayerRegion &layerm = *layer->regions[region_id];
+					layerm.perimeter_slices = layerm.slices;
+					layerm.perimeter_fill_surfaces = layerm.fill_surfaces;
+					layerm.perimeters_from = other->regions[region_id];
+				}
+			},
+			1
+		);
+	
+	// the fills of these layers include their new thin fills
+	std::set<size_t> new_perimeters;
+	for (size_t layer_idx = 0; layer_idx < this->layers.size(); ++layer_idx)
+		if (update[layer_idx])
+			new_perimeters.insert(layer_idx);
+	this->invalidate_layers(posInfill, new_perimeters);
 	
 	/*
 		simplify slices (both layer and region slices),
@@ -990,17 +1384,180 @@ PrintObject::_make_perimeters()
 	this->state.set_done(posPerimeters);
 }
 
+// true if both lists hold the same surfaces in the same order
+static bool
+same_surfaces(const Surfaces &a, const Surfaces &b)
+{
+	if (a.size() != b.size()) return false;
+	for (size_t i = 0; i < a.size(); ++i) {
+		const Surface &sa = a[i];
+		const Surface &sb = b[i];
+		if (sa.surface_type != sb.surface_type
+			|| sa.thickness != sb.thickness
+			|| sa.thickness_layers != sb.thickness_layers
+			|| sa.bridge_angle != sb.bridge_angle
+			|| sa.extra_perimeters != sb.extra_perimeters
+			|| sa.expolygon.contour.points != sb.expolygon.contour.points
+			|| sa.expolygon.holes.size() != sb.expolygon.holes.size())
+			return false;
+		for (size_t j = 0; j < sa.expolygon.holes.size(); ++j)
+			if (sa.expolygon.holes[j].points != sb.expolygon.holes[j].points)
+				return false;
+	}
+	return true;
+}
+
+// Hashing of the inputs of the passes of DiscoverHorizontalShells() and
+// CombineInfill(), used to tell whether a pass would give the same result again.
+static inline uint64_t
+hash_mix(uint64_t hash, uint64_t value)
+{
+	// finalizer of splitmix64, so that every bit of value affects the whole hash
+	value += 0x9e3779b97f4a7c15ULL;
+	value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+	value ^= value >> 31;
+	return (hash ^ value) * 0x100000001b3ULL;
+}
+
+static inline uint64_t
+hash_mix(uint64_t hash, double value)
+{
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return hash_mix(hash, bits);
+}
+
+static uint64_t
+hash_points(uint64_t hash, const Points &points)
+{
+	hash = hash_mix(hash, uint64_t(points.size()));
+	for (const Point &point : points) {
+		hash = hash_mix(hash, uint64_t(point.x));
+		hash = hash_mix(hash, uint64_t(point.y));
+	}
+	return hash;
+}
+
+static uint64_t
+hash_surfaces(uint64_t hash, const Surfaces &surfaces)
+{
+	hash = hash_mix(hash, uint64_t(surfaces.size()));
+	for (const Surface &surface : surfaces) {
+		hash = hash_mix(hash, uint64_t(surface.surface_type));
+		hash = hash_mix(hash, surface.thickness);
+		hash = hash_mix(hash, uint64_t(surface.thickness_layers));
+		hash = hash_mix(hash, surface.bridge_angle);
+		hash = hash_mix(hash, uint64_t(surface.extra_perimeters));
+		hash = hash_points(hash, surface.expolygon.contour.points);
+		hash = hash_mix(hash, uint64_t(surface.expolygon.holes.size()));
+		for (const Polygon &hole : surface.expolygon.holes)
+			hash = hash_points(hash, hole.points);
+	}
+	return hash;
+}
+
+// The results stored by DiscoverHorizontalShells() and CombineInfill() can be
+// replayed only while the infill of the region is prepared again because of
+// changed layers; a changed region config or a whole invalidated step needs
+// everything to be computed again.
+bool
+PrintObject::_can_reuse_prepared_infill(size_t region_id) const
+{
+	std::map<PrintObjectStep, PrintState<PrintObjectStep>::DirtyParts>::const_iterator it = this->state.dirty.find(posPrepareInfill);
+	return it != this->state.dirty.end() && it->second.regions.count(region_id) == 0;
+}
+
 void
 PrintObject::_infill()
 {
 	if (this->state.is_done(posInfill)) return;
 	this->state.set_started(posInfill);
 
-	parallelize<Layer*>(
-		std::queue<Layer*>(std::deque<Layer*>(this->layers.begin(), this->layers.end())),  // cast LayerPtrs to std::queue<Layer*>
-		boost::bind(&Slic3r::Layer::make_fills, _1),
-		this->_print->config.threads.value
-	);
+	// The fills of a region only depend on its fill surfaces and thin fills (and on its
+	// config, whose changes make the region dirty), on the height of the layer and on
+	// whether it is the first one, and on the infill direction alternating with a period
+	// of 2 or 3 layers (or of 2 or 3 times the thickness_layers of a surface). Along the
+	// prismatic parts of the object, the fills of the last layers of each direction are
+	// copied to the next layers getting the same surfaces; the regions are matched as
+	// in _make_perimeters(). The cubic and 3D honeycomb patterns depend on the height
+	// of the layer itself.
+	const size_t regions_count = this->_print->regions.size();
+	std::vector<size_t> same_layer(this->layers.size() * regions_count);
+	for (size_t region_id = 0; region_id < regions_count; ++region_id) {
+		const PrintRegionConfig &config = this->_print->regions[region_id]->config;
+		const InfillPattern patterns[] = { config.fill_pattern.value,
+			config.top_infill_pattern.value, config.bottom_infill_pattern.value };
+		bool by_height = false;
+		for (InfillPattern pattern : patterns)
+			by_height = by_height || pattern == ipCubic || pattern == ip3DHoneycomb;
+		std::vector<size_t> first_layers;  // the last 6 layers whose fills are made
+		for (size_t layer_idx = 0; layer_idx < this->layers.size(); ++layer_idx) {
+			const size_t idx = layer_idx * regions_count + region_id;
+			const Layer *layer = this->layers[layer_idx];
+			const Surfaces &surfaces = layer->regions[region_id]->fill_surfaces.surfaces;
+			same_layer[idx] = layer_idx;
+			for (size_t i = first_layers.size(); i > 0 && !by_height; --i) {
+				const Layer *other = this->layers[first_layers[i - 1]];
+				// the fills test id() == 0 for the first layer flow and the bridges, and don't
+				// read the lower layer, so with a raft the first object layer can be copied
+				bool same = other->id() > 0
+					&& std::abs(other->height - layer->height) < EPSILON
+					&& similar_surfaces(surfaces, other->regions[region_id]->fill_surfaces.surfaces);
+				for (size_t j = 0; same && j < surfaces.size(); ++j)
+					same = (layer->id() / surfaces[j].thickness_layers) % 6
+						== (other->id() / surfaces[j].thickness_layers) % 6;
+				if (same) {
+					same_layer[idx] = first_layers[i - 1];
+					break;
+				}
+			}
+			if (same_layer[idx] == layer_idx) {
+				if (first_layers.size() == 6)
+					first_layers.erase(first_layers.begin());
+				first_layers.push_back(layer_idx);
+			}
+		}
+	}
+	// The regions getting the same surfaces again keep their fills, unless they were
+	// copied from another region (or to it from a region done again).
+	std::vector<bool> update(same_layer.size());
+	for (size_t layer_idx = 0; layer_idx < this->layers.size(); ++layer_idx) {
+		const Layer *layer = this->layers[layer_idx];
+		for (size_t region_id = 0; region_id < regions_count; ++region_id) {
+			const LayerRegion &layerm = *layer->regions[region_id];
+			const size_t idx = layer_idx * regions_count + region_id;
+			const LayerRegion *other = this->layers[same_layer[idx]]->regions[region_id];
+			update[idx] = this->state.is_dirty(posInfill, layer_idx, region_id)
+				|| !same_surfaces(layerm.fill_surfaces.surfaces, layerm.filled_surfaces.surfaces)
+				|| (other != &layerm && update[same_layer[idx] * regions_count + region_id])
+				|| layerm.fills_from != other;
+		}
+	}
+	
+	for (int copy = 0; copy < 2; ++copy)
+		parallel_for(size_t(0), this->layers.size(),
+			[this, regions_count, &update, &same_layer, copy](size_t layer_idx) {
+				// abandon the remaining layers as soon as the print is canceled
+				this->_print->ThrowIfCanceled();
+				Layer *layer = this->layers[layer_idx];
+				for (size_t region_id = 0; region_id < regions_count; ++region_id) {
+					LayerRegion &layerm = *layer->regions[region_id];
+					const size_t idx = layer_idx * regions_count + region_id;
+					if ((same_layer[idx] != layer_idx) != bool(copy)) continue;
+					const LayerRegion *other = this->layers[same_layer[idx]]->regions[region_id];
+					if (update[idx]) {
+						if (copy)
+							layerm.copy_fill(*other);
+						else
+							layerm.make_fill();
+						layerm.fills_from = other;
+					}
+					layerm.filled_surfaces = layerm.fill_surfaces;
+				}
+			},
+			1
+		);
 	
 	/*  we could free memory now, but this would make this step not idempotent
 	### $_->fill_surfaces->clear for map @{$_->regions}, @{$object->layers};
@@ -1023,10 +1580,11 @@ void PrintObject::Slice() {
 	if (state.is_done(posSlice)) return;
 	state.set_started(posSlice);
 
-	print()->SetProgressStatus(10, QString("Processing triangled mesh"));
+	print()->SetProgressStatus(10, "Processing triangled mesh");
 
-	//对打印对象进行切分
-	_slice();
+	//对打印对象进行切分，只有部分层失效时，下方未改变的层被保留，first_layer为第一个重新切分的层
+	size_t first_layer = _slice();
+	_print->ThrowIfCanceled();
 
 	//遍历所有切分后的层，如果某一层存在slicing error，则使用其上一层和下一层的切分区域进行替换
 	// 检测slicing errors
@@ -1034,6 +1592,7 @@ void PrintObject::Slice() {
 		Layer* layer = get_layer(layer_id);
 
 		if (!layer->slicing_errors) continue;
+		_print->ThrowIfCanceled();
 
 		for (auto region_id = 0; region_id < layer->region_count(); region_id++) {
 			LayerRegion* region = layer->regions[region_id];
@@ -1098,7 +1657,14 @@ void PrintObject::Slice() {
 
 	//如果需要，则对slices进行simplify
 	if (_print->config.resolution) {
-		SimplySlices(scale_(print()->config.resolution));
+		SimplySlices(scale_(print()->config.resolution), first_layer);
+	}
+
+	//保存切分结果，重新生成Perimeters时由此恢复，而不必重新切分
+	for (auto layer_id = first_layer; layer_id < layer_count(); layer_id++) {
+		for (auto& region : get_layer(layer_id)->regions) {
+			region->raw_slices = region->slices;
+		}
 	}
 	if (layers.empty()) {
 		qDebug() << "No layers were detected";
@@ -1117,10 +1683,7 @@ void PrintObject::Slice() {
 void PrintObject::MakePerimeters() {
 	if (state.is_done(posPerimeters)) return;
 
-	if (typed_slices) {
-		invalidate_step(posSlice);
-	}
-
+	//typed_slices为真时不再重新切分，_make_perimeters()会从保存的切分结果中恢复slices
 	Slice();
 	_make_perimeters();
 }
@@ -1156,17 +1719,20 @@ void PrintObject::PrepareInfill() {
 	if (state.is_done(posPrepareInfill)) { return; }
 
 
-	invalidate_step(posPerimeters);
+	//PrepareInfill会修改slices和fill_surfaces，因此需要重新执行_make_perimeters()，
+	//但只是将各层恢复到生成Perimeters之后的状态，并不重新生成Perimeters
+	invalidate_layers(posPerimeters, std::set<size_t>());
 	MakePerimeters();
 
 	//设置打印状态
 	state.set_started(posPrepareInfill);
 
-	_print->SetProgressStatus(30, QString("Preparing infill"));
+	_print->SetProgressStatus(30, "Preparing infill");
 
 	//将所有layer region上的surface分类为top/internal/bottom
 	//根据某一曾上方或下方是否存在别的层进行判断
 	DetectSurfaceType();
+	_print->ThrowIfCanceled();
 
 	//根据配置判断是否需要：
 	//1. 将bottom/top转换为internal
@@ -1180,17 +1746,21 @@ void PrintObject::PrepareInfill() {
 	//使用BridgeDetector检测Bridges结构以及unsupported bridge region
 	//而且重新定义top/internal/bottom区域，在最下面一层可能也会有top区域
 	process_external_surfaces();
+	_print->ThrowIfCanceled();
 
 	//将top/bottom/bridge附近的Internal转换为Internal solid,保证了在solid层中，
 	//solid下方的internal转变为internal solid
 	DiscoverHorizontalShells();
+	_print->ThrowIfCanceled();
 
 	//将solid区域（bottom/top/perimeters）下方的internal转换为internal solid
 	ClipFillSurfaces();
+	_print->ThrowIfCanceled();
 
 	//检测该层为internal solid而其下方的层为internal类型的区域
 	//将其一部分由internal solid转换为internal bridge,确保internal solid不会塌陷
 	bridge_over_infill();
+	_print->ThrowIfCanceled();
 
 	//将不同层的填充区域根据配置参数进行合并
 	CombineInfill();
@@ -1203,229 +1773,331 @@ void PrintObject::PrepareInfill() {
 *  将其由internal重新分类为internal 和 internal solid
 */
 void PrintObject::DiscoverHorizontalShells() {
-	for (auto region_id = 0; region_id < _print->regions.size(); region_id++) {
-		for (auto layer_id = 0; layer_id < layer_count(); layer_id++) {
-			LayerRegion* layer_region = get_layer(layer_id)->get_region(region_id);
+	int region_count = _print->regions.size();
+
+	// 第一阶段：并行计算每一层会读写的layer范围<first layer, last layer>
+	// 有top区域时会修改下方top_solid_layers - 1层，有bottom区域时会修改上方bottom_solid_layers - 1层，
+	// 此外只会修改自身的fill surfaces。其他层的计算只会删减top/bottom区域而不会新增，因此该范围一直有效
+	std::vector<std::vector<std::pair<int, int>>> spans(region_count, std::vector<std::pair<int, int>>(layer_count()));
+	parallel_for(0, int(layer_count()),
+		[this, region_count, &spans](int layer_id) {
+			for (int region_id = 0; region_id < region_count; region_id++) {
+				const LayerRegion* layer_region = get_layer(layer_id)->get_region(region_id);
+				const PrintRegionConfig& config = layer_region->region()->config;
+
+				bool has_top = false;
+				bool has_bottom = false;
+				for (const SurfaceCollection* surfaces : { &layer_region->slices, &layer_region->fill_surfaces }) {
+					for (const Surface& surface : surfaces->surfaces) {
+						has_top = has_top || surface.surface_type == stTop;
+						has_bottom = has_bottom || surface.surface_type == stBottom || surface.surface_type == stBottomBridge;
+					}
+				}
 
-			if (layer_region->region()->config.solid_infill_every_layers
-				&& layer_region->region()->config.fill_density > 0
-				&& (layer_id % layer_region->region()->config.bottom_solid_layers) == 0) {
+				spans[region_id][layer_id] = std::make_pair(
+					has_top ? std::max(0, layer_id - std::max(config.top_solid_layers.value - 1, 0)) : layer_id,
+					has_bottom ? std::min(int(layer_count()) - 1, layer_id + std::max(config.bottom_solid_layers.value - 1, 0)) : layer_id);
+			}
+		}
+	);
+
+	// 读写范围相互重叠的层必须按从下到上的顺序依次计算，才能得到与逐层计算相同的结果，
+	// 将这样的层合并为一组；不同组之间读写的layer互不相交，可以并行计算
+	// groups中的每一项为<region_id, <first layer, last layer>>
+	std::vector<std::pair<int, std::pair<int, int>>> groups;
+	for (int region_id = 0; region_id < region_count; region_id++) {
+		// linked[i]表示第i层与第i + 1层属于同一组
+		std::vector<bool> linked(layer_count(), false);
+		for (auto& span : spans[region_id]) {
+			for (int id = span.first; id < span.second; id++) {
+				linked[id] = true;
+			}
+		}
+		int first_id = 0;
+		for (int layer_id = 0; layer_id < layer_count(); layer_id++) {
+			if (!linked[layer_id]) {
+				groups.push_back(std::make_pair(region_id, std::make_pair(first_id, layer_id)));
+				first_id = layer_id + 1;
+			}
+		}
+	}
 
-				SurfaceType type = layer_region->region()->config.fill_density == 100 ?
-					stInternalSolid : stInternalBridge;
+	// 只有部分层失效时，输入未变的layer可以直接使用上一次的计算结果
+	std::vector<bool> reuse(region_count);
+	for (int region_id = 0; region_id < region_count; region_id++) {
+		reuse[region_id] = _can_reuse_prepared_infill(region_id);
+	}
 
-				SurfacesPtr internal_surfaces;
-				internal_surfaces = layer_region->fill_surfaces.filter_by_type(stInternal);
-				for (Surface* surface : internal_surfaces) {
-					surface->surface_type = type;
+	// 第二阶段：并行计算各组，组内逐层计算
+	parallel_for(size_t(0), groups.size(),
+		[this, &spans, &groups, &reuse](size_t group_id) {
+			int region_id = groups[group_id].first;
+			for (int layer_id = groups[group_id].second.first; layer_id <= groups[group_id].second.second; layer_id++) {
+				_print->ThrowIfCanceled();
+				LayerRegion* layer_region = get_layer(layer_id)->get_region(region_id);
+				int first_id = spans[region_id][layer_id].first;
+				int last_id = spans[region_id][layer_id].second;
+
+				// 没有top/bottom区域时只会修改自身的fill surfaces，直接计算即可
+				if (first_id == layer_id && last_id == layer_id) {
+					DiscoverLayerHorizontalShells(region_id, layer_id);
+					continue;
 				}
-			}
 
+				// 读写范围内所有输入的hash值
+				uint64_t key = hash_mix(hash_mix(uint64_t(layer_id), uint64_t(first_id)), uint64_t(last_id));
+				key = hash_surfaces(key, layer_region->slices.surfaces);
+				for (auto id = first_id; id <= last_id; id++) {
+					const Layer* layer = get_layer(id);
+					key = hash_mix(key, uint64_t(layer->id()));
+					key = hash_mix(key, layer->height);
+					key = hash_surfaces(key, layer->regions[region_id]->fill_surfaces.surfaces);
+				}
 
-			// 在current layer上查找特定类型的slices
-			// 不适用fill_slices而使用slices的原因是后者同时包含了perimeter area，而这部分也将被扩充到shell
-			for (SurfaceType type : {stTop, stBottom, stBottomBridge}) {
-				//当前layer的current solid 区域，同时包含slices内的solid区域和solid infill区域
-				Polygons solid_polygons;
-				SurfacesPtr solid_slices = layer_region->slices.filter_by_type(type);
-				// 				for (Surface* surface : solid_slices) {
-				// 					//solid_polygons.push_back(surface->operator Slic3r::Polygons);
-				// 					solid_polygons.insert(solid_polygons.end(),
-				// 						surface->operator Slic3r::Polygons().begin(), surface->operator Slic3r::Polygons().end());
-				// 				}
-				for (Surface* surface : solid_slices) {
-					solid_polygons.push_back(surface->expolygon.contour);
-					solid_polygons.insert(solid_polygons.end(), surface->expolygon.holes.begin(), surface->expolygon.holes.end());
+				if (reuse[region_id] && layer_region->shells_key == key) {
+					for (auto& result : layer_region->shells_result) {
+						get_layer(result.first)->regions[region_id]->fill_surfaces = result.second;
+					}
+					continue;
 				}
 
+				DiscoverLayerHorizontalShells(region_id, layer_id);
 
-				SurfacesPtr solid_fill_surfaces = layer_region->fill_surfaces.filter_by_type(type);
-				// 				for (Surface* surface : solid_fill_surfaces) {
-				// 					//solid_polygons.push_back(surface->operator Slic3r::Polygons);
-				// 					solid_polygons.insert(solid_polygons.end(), 
-				// 						surface->operator Slic3r::Polygons().begin(), surface->operator Slic3r::Polygons().end());
-				// 				}
-				for (Surface* surface : solid_fill_surfaces) {
-					solid_polygons.push_back(surface->expolygon.contour);
-					solid_polygons.insert(solid_polygons.end(), surface->expolygon.holes.begin(), surface->expolygon.holes.end());
+				layer_region->shells_key = key;
+				layer_region->shells_result.clear();
+				for (auto id = first_id; id <= last_id; id++) {
+					layer_region->shells_result.push_back(std::make_pair(size_t(id), get_layer(id)->regions[region_id]->fill_surfaces));
 				}
+			}
+		},
+		1
+	);
+}
 
-				//如果当前层没有solid区域的话，则跳到下一个类型
-				if (solid_polygons.empty()) { continue; }
-				//qDebug() << "Layer " << layer_id << " has " << (type == stTop ? "top" : "bottom") << " surfaces";
+/*
+*	对region_id上的第layer_id层检测horizontal shells，
+*  只会修改自身及top_solid_layers/bottom_solid_layers范围内的neighbor layer上的fill surfaces
+*/
+void PrintObject::DiscoverLayerHorizontalShells(int region_id, int layer_id) {
+	LayerRegion* layer_region = get_layer(layer_id)->get_region(region_id);
 
-				//当前层所处的solid层数
-				int solid_count = (type == stTop) ?
-					layer_region->region()->config.top_solid_layers :
-					layer_region->region()->config.bottom_solid_layers;
+	if (layer_region->region()->config.solid_infill_every_layers
+		&& layer_region->region()->config.fill_density > 0
+		&& (layer_id % layer_region->region()->config.bottom_solid_layers) == 0) {
 
-				//neighbor_id表示与当前layer处于同一个solid 的layer
-				for (auto neighbor_id = (type == stTop) ? layer_id - 1 : layer_id + 1;
-					std::abs(neighbor_id - layer_id) <= solid_count - 1;
-					(type == stTop) ? neighbor_id-- : neighbor_id++) {
+		SurfaceType type = layer_region->region()->config.fill_density == 100 ?
+			stInternalSolid : stInternalBridge;
 
-					if (neighbor_id < 0 || neighbor_id >= layer_count()) continue;
-					//qDebug() << "Looking for neighbirs on layer " << neighbor_id;
+		SurfacesPtr internal_surfaces;
+		internal_surfaces = layer_region->fill_surfaces.filter_by_type(stInternal);
+		for (Surface* surface : internal_surfaces) {
+			surface->surface_type = type;
+		}
+	}
 
-					//neighbor layer上处于同一个layer region的部分
-					LayerRegion* neighbor_layer_region = get_layer(neighbor_id)->regions[region_id];
-					SurfaceCollection neighbor_fill_surfaces = neighbor_layer_region->fill_surfaces;
 
-					//neighbor层上的internal 和internal solid填充区域
-					Polygons neighbor_polygons;
-					for (Surface& surface : neighbor_fill_surfaces.surfaces) {
-						if (surface.surface_type == stInternal || surface.surface_type == stInternalSolid) {
-							//neighbor_polygons.push_back(surface.operator Slic3r::Polygons);
-							// 							neighbor_polygons.insert(neighbor_polygons.end(),
-							// 								surface.operator Slic3r::Polygons().begin(), surface.operator Slic3r::Polygons().end());
-							neighbor_polygons.push_back(surface.expolygon.contour);
-							neighbor_polygons.insert(neighbor_polygons.end(),
-								surface.expolygon.holes.begin(), surface.expolygon.holes.end());
-						}
-					}
+	// 在current layer上查找特定类型的slices
+	// 不适用fill_slices而使用slices的原因是后者同时包含了perimeter area，而这部分也将被扩充到shell
+	for (SurfaceType type : {stTop, stBottom, stBottomBridge}) {
+		//当前layer的current solid 区域，同时包含slices内的solid区域和solid infill区域
+		Polygons solid_polygons;
+		SurfacesPtr solid_slices = layer_region->slices.filter_by_type(type);
+		// 				for (Surface* surface : solid_slices) {
+		// 					//solid_polygons.push_back(surface->operator Slic3r::Polygons);
+		// 					solid_polygons.insert(solid_polygons.end(),
+		// 						surface->operator Slic3r::Polygons().begin(), surface->operator Slic3r::Polygons().end());
+		// 				}
+		for (Surface* surface : solid_slices) {
+			solid_polygons.push_back(surface->expolygon.contour);
+			solid_polygons.insert(solid_polygons.end(), surface->expolygon.holes.begin(), surface->expolygon.holes.end());
+		}
 
-					// 计算current layer上的solid区域，与 neighbor layer上的internal & internal solid区域的Intersection
-					// 即为当前层上的new internal solid区域，同时这一部分也是neighbor layer上的new internal solid部分
-					Polygons new_internal_solid = intersection(solid_polygons, neighbor_polygons, 1);
-
-					// 如果这一层上不需要internal solid的话，需要根据用户设置的参数判读是否需要继续在查找neighbor layer
-					if (new_internal_solid.empty()) {
-						// 如果用户希望object是中空的，则不再搜索neighbor layer，此时只生产external solid shell，
-						// 从而会导致打印出的物体中perimeter之间有hole，internal solid shells都是previous layer上
-						// shell的子集
-						if (layer_region->region()->config.fill_density == 0) {
-							break;
-						}
-						else {
-							//如果需要internal infill, 则可以自由得生成所需要的internal solid shell
-							continue;
-						}
-					}
 
-					// 如果打印的是一个中空物体的话，则需要丢弃任何比perimeter更thin的solid shell
-					if (layer_region->region()->config.fill_density == 0) {
+		SurfacesPtr solid_fill_surfaces = layer_region->fill_surfaces.filter_by_type(type);
+		// 				for (Surface* surface : solid_fill_surfaces) {
+		// 					//solid_polygons.push_back(surface->operator Slic3r::Polygons);
+		// 					solid_polygons.insert(solid_polygons.end(), 
+		// 						surface->operator Slic3r::Polygons().begin(), surface->operator Slic3r::Polygons().end());
+		// 				}
+		for (Surface* surface : solid_fill_surfaces) {
+			solid_polygons.push_back(surface->expolygon.contour);
+			solid_polygons.insert(solid_polygons.end(), surface->expolygon.holes.begin(), surface->expolygon.holes.end());
+		}
+
+		//如果当前层没有solid区域的话，则跳到下一个类型
+		if (solid_polygons.empty()) { continue; }
+		//qDebug() << "Layer " << layer_id << " has " << (type == stTop ? "top" : "bottom") << " surfaces";
+
+		//当前层所处的solid层数
+		int solid_count = (type == stTop) ?
+			layer_region->region()->config.top_solid_layers :
+			layer_region->region()->config.bottom_solid_layers;
+
+		//neighbor_id表示与当前layer处于同一个solid 的layer
+		for (auto neighbor_id = (type == stTop) ? layer_id - 1 : layer_id + 1;
+			std::abs(neighbor_id - layer_id) <= solid_count - 1;
+			(type == stTop) ? neighbor_id-- : neighbor_id++) {
+
+			if (neighbor_id < 0 || neighbor_id >= layer_count()) continue;
+			//qDebug() << "Looking for neighbirs on layer " << neighbor_id;
+
+			//neighbor layer上处于同一个layer region的部分
+			LayerRegion* neighbor_layer_region = get_layer(neighbor_id)->regions[region_id];
+			SurfaceCollection neighbor_fill_surfaces = neighbor_layer_region->fill_surfaces;
+
+			//neighbor层上的internal 和internal solid填充区域
+			Polygons neighbor_polygons;
+			for (Surface& surface : neighbor_fill_surfaces.surfaces) {
+				if (surface.surface_type == stInternal || surface.surface_type == stInternalSolid) {
+					//neighbor_polygons.push_back(surface.operator Slic3r::Polygons);
+					// 							neighbor_polygons.insert(neighbor_polygons.end(),
+					// 								surface.operator Slic3r::Polygons().begin(), surface.operator Slic3r::Polygons().end());
+					neighbor_polygons.push_back(surface.expolygon.contour);
+					neighbor_polygons.insert(neighbor_polygons.end(),
+						surface.expolygon.holes.begin(), surface.expolygon.holes.end());
+				}
+			}
+
+			// 计算current layer上的solid区域，与 neighbor layer上的internal & internal solid区域的Intersection
+			// 即为当前层上的new internal solid区域，同时这一部分也是neighbor layer上的new internal solid部分
+			Polygons new_internal_solid = intersection_clustered(solid_polygons, neighbor_polygons, 1);
 
-						// solid shell的厚度临界值
-						coord_t margin = neighbor_layer_region->flow(frExternalPerimeter).scaled_width();
+			// 如果这一层上不需要internal solid的话，需要根据用户设置的参数判读是否需要继续在查找neighbor layer
+			if (new_internal_solid.empty()) {
+				// 如果用户希望object是中空的，则不再搜索neighbor layer，此时只生产external solid shell，
+				// 从而会导致打印出的物体中perimeter之间有hole，internal solid shells都是previous layer上
+				// shell的子集
+				if (layer_region->region()->config.fill_density == 0) {
+					break;
+				}
+				else {
+					//如果需要internal infill, 则可以自由得生成所需要的internal solid shell
+					continue;
+				}
+			}
 
-						Polygons offseted = offset2(new_internal_solid, -margin, +margin, CLIPPER_OFFSET_SCALE, jtMiter, 5);
+			// 如果打印的是一个中空物体的话，则需要丢弃任何比perimeter更thin的solid shell
+			if (layer_region->region()->config.fill_density == 0) {
 
-						// 计算得到的厚度过小的区域
-						Polygons too_narrow = diff(new_internal_solid, offseted, 1);
+				// solid shell的厚度临界值
+				coord_t margin = neighbor_layer_region->flow(frExternalPerimeter).scaled_width();
 
-						// 如果存在厚度过小的情况的话，就需要从current layer的solid区域剔除这一部分
-						// 同时要更新当前layer上的internal solid区域
-						if (!too_narrow.empty()) {
-							new_internal_solid = diff(new_internal_solid, too_narrow);
-							solid_polygons = new_internal_solid;
-						}
-					}
+				Polygons offseted = offset2(new_internal_solid, -margin, +margin, CLIPPER_OFFSET_SCALE, jtMiter, 5);
 
+				// 计算得到的厚度过小的区域
+				Polygons too_narrow = diff(new_internal_solid, offseted, 1);
 
-					// 由于internal solid区域可能会被collapsed，因此要确保current layer上的new internal solid区域足够宽
-					{
-						// new internal solid区域的宽度边界，用于计算too narrow的区域
-						coord_t margin = 3 * layer_region->flow(frSolidInfill).scaled_width();
-
-						Polygons offseted = offset2(new_internal_solid, -margin, +margin, CLIPPER_OFFSET_SCALE, jtMiter, 5);
-						Polygons too_narrow = diff(new_internal_solid, offseted, 1);
-
-						// grow collapsing部分，并在neighbor layer和original layer上添加一部分区域，
-						// 从而可以保证下一层的shell也能得到支撑
-						if (!too_narrow.empty()) {
-
-							// 将too_narrow区域(即collapsing区域)向外扩展，并与neighbor layer上的internal & bridge区域做intersection
-							// 从而得到需要进行grow的区域，并将其添加到new internal solid部分
-							Polygons internal_bridge_polygons;
-							for (Surface& surface : neighbor_fill_surfaces.surfaces) {
-								if (surface.is_internal() || surface.is_bridge()) {
-									//internal_bridge_polygons.push_back(surface.operator Slic3r::Polygons);
-									// 									internal_bridge_polygons.insert(internal_bridge_polygons.end(),
-									// 										surface.operator Slic3r::Polygons().begin(), surface.operator Slic3r::Polygons().end());
-									internal_bridge_polygons.push_back(surface.expolygon.contour);
-									internal_bridge_polygons.insert(internal_bridge_polygons.end(),
-										surface.expolygon.holes.begin(), surface.expolygon.holes.end());
-
-								}
-							}
-
-							Polygons offseted_margin = offset(too_narrow, +margin);
-							Polygons grown = intersection(offseted_margin, internal_bridge_polygons);
-
-							new_internal_solid.insert(new_internal_solid.begin(), grown.begin(), grown.end());
-							solid_polygons = new_internal_solid;
-						}
+				// 如果存在厚度过小的情况的话，就需要从current layer的solid区域剔除这一部分
+				// 同时要更新当前layer上的internal solid区域
+				if (!too_narrow.empty()) {
+					new_internal_solid = diff(new_internal_solid, too_narrow);
+					solid_polygons = new_internal_solid;
+				}
+			}
 
-					}
 
-					// 将neighbor层上的internal solid区域合并到当前层上的new internal solid区域
-					// 作为neighbor 层上的internal solid区域
-					Polygons neighbor_internal_solid;
+			// 由于internal solid区域可能会被collapsed，因此要确保current layer上的new internal solid区域足够宽
+			{
+				// new internal solid区域的宽度边界，用于计算too narrow的区域
+				coord_t margin = 3 * layer_region->flow(frSolidInfill).scaled_width();
+
+				Polygons offseted = offset2(new_internal_solid, -margin, +margin, CLIPPER_OFFSET_SCALE, jtMiter, 5);
+				Polygons too_narrow = diff(new_internal_solid, offseted, 1);
+
+				// grow collapsing部分，并在neighbor layer和original layer上添加一部分区域，
+				// 从而可以保证下一层的shell也能得到支撑
+				if (!too_narrow.empty()) {
+
+					// 将too_narrow区域(即collapsing区域)向外扩展，并与neighbor layer上的internal & bridge区域做intersection
+					// 从而得到需要进行grow的区域，并将其添加到new internal solid部分
+					Polygons internal_bridge_polygons;
 					for (Surface& surface : neighbor_fill_surfaces.surfaces) {
-						if (surface.surface_type == stInternalSolid) {
-							//neighbor_internal_solid.push_back(surface.operator Slic3r::Polygons);
-							// 							neighbor_internal_solid.insert(neighbor_internal_solid.end(),
-							// 								surface.operator Slic3r::Polygons().begin(), surface.operator Slic3r::Polygons().end());
-							neighbor_internal_solid.push_back(surface.expolygon.contour);
-							neighbor_internal_solid.insert(neighbor_internal_solid.end(),
+						if (surface.is_internal() || surface.is_bridge()) {
+							//internal_bridge_polygons.push_back(surface.operator Slic3r::Polygons);
+							// 									internal_bridge_polygons.insert(internal_bridge_polygons.end(),
+							// 										surface.operator Slic3r::Polygons().begin(), surface.operator Slic3r::Polygons().end());
+							internal_bridge_polygons.push_back(surface.expolygon.contour);
+							internal_bridge_polygons.insert(internal_bridge_polygons.end(),
 								surface.expolygon.holes.begin(), surface.expolygon.holes.end());
-						}
-					}
-					neighbor_internal_solid.insert(neighbor_internal_solid.end(),
-						new_internal_solid.begin(), new_internal_solid.end());
-					ExPolygons internal_solid = union_ex(neighbor_internal_solid);
 
-					// 此时neighbor layer上的internal区域即为原本的internal 区域减去internal solid区域
-					ExPolygons neighbor_internal;
-					for (Surface& surface : neighbor_fill_surfaces.surfaces) {
-						if (surface.surface_type == stInternal) {
-							neighbor_internal.push_back(surface.expolygon);
 						}
 					}
-					ExPolygons internal = diff_ex(neighbor_internal, internal_solid, 1);
 
-					//将neighbor fill surfaces清空，并将internal和internal solid区域添加进去
-					neighbor_fill_surfaces.clear();
+					Polygons offseted_margin = offset(too_narrow, +margin);
+					Polygons grown = intersection(offseted_margin, internal_bridge_polygons);
 
-					neighbor_fill_surfaces.append(internal, stInternal);
-					neighbor_fill_surfaces.append(internal_solid, stInternalSolid);
+					new_internal_solid.insert(new_internal_solid.begin(), grown.begin(), grown.end());
+					solid_polygons = new_internal_solid;
+				}
 
-					// 将neighbor layer上的top surfaces和bottom surfaces都添加进去
-					Surfaces top_bottom_surfaces;
-					for (Surface& surface : neighbor_layer_region->fill_surfaces.surfaces) {
-						if (surface.surface_type == stTop || surface.is_bottom()) {
-							top_bottom_surfaces.push_back(surface);
-						}
-					}
+			}
 
-					// 先对所有的top/bottom surfaces进行分组，然后再分别将每一组合并之后，再减去internal & internal solid区域，
-					// 剩余的部分就是新的top/bottom surfaces
-					SurfaceCollection top_bottom_surface_collection(top_bottom_surfaces);
-					std::vector<SurfacesConstPtr> grouped_surfaces;
-					top_bottom_surface_collection.group(&grouped_surfaces);
-					for (SurfacesConstPtr surfaces : grouped_surfaces) {
-						ExPolygons all_surface_expolygons;
-						for (auto& surface : surfaces) { all_surface_expolygons.push_back(surface->expolygon); }
-						// 						ExPolygons internal_intersolid_expolygons;
-						// 						std::merge(internal.begin(), internal.end(),
-						// 							internal_solid.begin(), internal_solid.end(),
-						// 							back_inserter(internal_intersolid_expolygons));
-
-						ExPolygons internal_intersolid_expolygons(internal.begin(), internal.end());
-						internal_intersolid_expolygons.insert(internal_intersolid_expolygons.end(),
-							internal_solid.begin(), internal_solid.end());
-
-						ExPolygons result_solid_expolygons = diff_ex(all_surface_expolygons, internal_intersolid_expolygons, 1);
-
-						neighbor_fill_surfaces.append(result_solid_expolygons, surfaces[0]->surface_type);
-					}
+			// 将neighbor层上的internal solid区域合并到当前层上的new internal solid区域
+			// 作为neighbor 层上的internal solid区域
+			Polygons neighbor_internal_solid;
+			for (Surface& surface : neighbor_fill_surfaces.surfaces) {
+				if (surface.surface_type == stInternalSolid) {
+					//neighbor_internal_solid.push_back(surface.operator Slic3r::Polygons);
+					// 							neighbor_internal_solid.insert(neighbor_internal_solid.end(),
+					// 								surface.operator Slic3r::Polygons().begin(), surface.operator Slic3r::Polygons().end());
+					neighbor_internal_solid.push_back(surface.expolygon.contour);
+					neighbor_internal_solid.insert(neighbor_internal_solid.end(),
+						surface.expolygon.holes.begin(), surface.expolygon.holes.end());
+				}
+			}
+			neighbor_internal_solid.insert(neighbor_internal_solid.end(),
+				new_internal_solid.begin(), new_internal_solid.end());
+			ExPolygons internal_solid = union_ex(neighbor_internal_solid);
+
+			// 此时neighbor layer上的internal区域即为原本的internal 区域减去internal solid区域
+			ExPolygons neighbor_internal;
+			for (Surface& surface : neighbor_fill_surfaces.surfaces) {
+				if (surface.surface_type == stInternal) {
+					neighbor_internal.push_back(surface.expolygon);
+				}
+			}
+			ExPolygons internal = diff_ex(neighbor_internal, internal_solid, 1);
+
+			//将neighbor fill surfaces清空，并将internal和internal solid区域添加进去
+			neighbor_fill_surfaces.clear();
 
-					//用计算出的新的neighbor layer上的fill surfaces替换
-					neighbor_layer_region->fill_surfaces = neighbor_fill_surfaces;
+			neighbor_fill_surfaces.append(internal, stInternal);
+			neighbor_fill_surfaces.append(internal_solid, stInternalSolid);
+
+			// 将neighbor layer上的top surfaces和bottom surfaces都添加进去
+			Surfaces top_bottom_surfaces;
+			for (Surface& surface : neighbor_layer_region->fill_surfaces.surfaces) {
+				if (surface.surface_type == stTop || surface.is_bottom()) {
+					top_bottom_surfaces.push_back(surface);
 				}
+			}
 
+			// 先对所有的top/bottom surfaces进行分组，然后再分别将每一组合并之后，再减去internal & internal solid区域，
+			// 剩余的部分就是新的top/bottom surfaces
+			SurfaceCollection top_bottom_surface_collection(top_bottom_surfaces);
+			std::vector<SurfacesConstPtr> grouped_surfaces;
+			top_bottom_surface_collection.group(&grouped_surfaces);
+			for (SurfacesConstPtr surfaces : grouped_surfaces) {
+				ExPolygons all_surface_expolygons;
+				for (auto& surface : surfaces) { all_surface_expolygons.push_back(surface->expolygon); }
+				// 						ExPolygons internal_intersolid_expolygons;
+				// 						std::merge(internal.begin(), internal.end(),
+				// 							internal_solid.begin(), internal_solid.end(),
+				// 							back_inserter(internal_intersolid_expolygons));
+
+				ExPolygons internal_intersolid_expolygons(internal.begin(), internal.end());
+				internal_intersolid_expolygons.insert(internal_intersolid_expolygons.end(),
+					internal_solid.begin(), internal_solid.end());
+
+				ExPolygons result_solid_expolygons = diff_ex(all_surface_expolygons, internal_intersolid_expolygons, 1);
+
+				neighbor_fill_surfaces.append(result_solid_expolygons, surfaces[0]->surface_type);
 			}
+
+			//用计算出的新的neighbor layer上的fill surfaces替换
+			neighbor_layer_region->fill_surfaces = neighbor_fill_surfaces;
 		}
+
 	}
 }
 
@@ -1442,49 +2114,78 @@ void PrintObject::ClipFillSurfaces() {
 	}
 	if (!precodition) return;
 
+	//每一层只依赖自身原始fill surfaces的polygons只计算一次并缓存，
+	//第layer_id层作为current layer和作为第layer_id + 1层的lower layer时都使用同一份结果
+	struct ClipLayerPolygons {
+		Polygons solid;							//solid fill surfaces，上方层的处理不会修改这一部分
+		Polygons slices;						//layer slices
+		Polygons fill;							//所有的fill surfaces
+		Polygons internal_internalvoid;			//所有layer region的internal和internal void区域
+		std::vector<Polygons> region_internal;	//每一个layer region的internal和internal void区域
+		std::vector<Surfaces> region_other;		//每一个layer region的其他fill surfaces
+		double width_threshold;
+	};
+	std::vector<ClipLayerPolygons> cache(layer_count());
+	parallel_for(0, int(layer_count()),
+		[this, &cache](int layer_id) {
+			_print->ThrowIfCanceled();
+			Layer* layer = get_layer(layer_id);
+			ClipLayerPolygons& polygons = cache[layer_id];
+
+			for (ExPolygon& ex : layer->slices.expolygons) {
+				polygons.slices.push_back(ex.contour);
+				polygons.slices.insert(polygons.slices.end(), ex.holes.begin(), ex.holes.end());
+			}
+
+			polygons.region_internal.resize(layer->regions.size());
+			polygons.region_other.resize(layer->regions.size());
+			for (size_t region_id = 0; region_id < layer->regions.size(); region_id++) {
+				for (Surface& surface : layer->regions[region_id]->fill_surfaces.surfaces) {
+					if (surface.is_solid()) {
+						polygons.solid.push_back(surface.expolygon.contour);
+						polygons.solid.insert(polygons.solid.end(), surface.expolygon.holes.begin(), surface.expolygon.holes.end());
+					}
+					polygons.fill.push_back(surface.expolygon.contour);
+					polygons.fill.insert(polygons.fill.end(), surface.expolygon.holes.begin(), surface.expolygon.holes.end());
+					if (surface.surface_type == stInternal || surface.surface_type == stInternalVoid) {
+						polygons.region_internal[region_id].push_back(surface.expolygon.contour);
+						polygons.region_internal[region_id].insert(polygons.region_internal[region_id].end(),
+							surface.expolygon.holes.begin(), surface.expolygon.holes.end());
+					}
+					else {
+						polygons.region_other[region_id].push_back(surface);
+					}
+				}
+				polygons.internal_internalvoid.insert(polygons.internal_internalvoid.end(),
+					polygons.region_internal[region_id].begin(), polygons.region_internal[region_id].end());
+			}
+
+			// 只考虑那些宽度超过extrusion width的perimeter
+			polygons.width_threshold = 0;
+			for (LayerRegion* region : layer->regions) {
+				polygons.width_threshold = std::min(polygons.width_threshold, (double)region->flow(frPerimeter).scaled_width());
+			}
+		}
+	);
+
 	//由上向下进行处理，忽视最底层
+	//每一层的new internal区域由上一层的结果得到，并修改下一层的fill surfaces，因此这一部分只能逐层计算
+	LayerProgress progress(_print, 35, 45, layer_count(), "Clipping fill surfaces");
 	Polygons upper_internal;
 	for (int layer_id = layer_count() - 1; layer_id >= 1; layer_id--) {
+		_print->ThrowIfCanceled();
 		Layer* cur_layer = get_layer(layer_id);
 		Layer* lower_layer = get_layer(layer_id - 1);
+		const ClipLayerPolygons& cur_polygons = cache[layer_id];
+		ClipLayerPolygons& lower_polygons = cache[layer_id - 1];
 
 		//检测overhang区域，即solid infill surfaces
-		Polygons overhangs;
-		for (LayerRegion* region : cur_layer->regions) {
-			for (Surface& surface : region->fill_surfaces.surfaces) {
-				if (surface.is_solid()) {
-					//overhangs.push_back(surface.operator Slic3r::Polygons);
-					// 					overhangs.insert(overhangs.end(),
-					// 						surface.operator Slic3r::Polygons().begin(),
-					// 						surface.operator Slic3r::Polygons().end());
-					overhangs.push_back(surface.expolygon.contour);
-					for (auto& hole : surface.expolygon.holes) {
-						overhangs.push_back(hole);
-					}
-				}
-			}
-		}
+		Polygons overhangs = cur_polygons.solid;
 
 		// 如果存在一个没有被支撑perimeter loop的话，同样需要对其进行支撑
 		{
-
 			// 当前层的perimeters为slices surfaces - fill surfaces
-			// 			Polygons cur_slices;
-			// 			cur_slices = cur_layer->slices.operator Slic3r::Polygons();
-			// 			Polygons cur_fill;
-			// // 			for (LayerRegion* region : cur_layer->regions) {
-			// // 				//cur_fill.push_back(region->fill_surfaces.operator Slic3r::Polygons);
-			// // // 				cur_fill.insert(cur_fill.end(),
-			// // // 					region->fill_surfaces.operator Slic3r::Polygons().begin(), 
-			// // // 					region->fill_surfaces.operator Slic3r::Polygons().end());
-			// // 				cur_fill.push_back(region->fill_surfaces.)
-			// // 			}
-			Polygons cur_slices;
-			for (ExPolygon& ex : cur_layer->slices.expolygons) {
-				cur_slices.push_back(ex.contour);
-				cur_slices.insert(cur_slices.end(), ex.holes.begin(), ex.holes.end());
-			}
-
+			// 当前层的fill surfaces已经被上一层的处理修改过，因此不能使用缓存
 			Polygons cur_fill;
 			for (LayerRegion* region : cur_layer->regions) {
 				for (Surface& surface : region->fill_surfaces.surfaces) {
@@ -1495,34 +2196,14 @@ void PrintObject::ClipFillSurfaces() {
 				}
 			}
 
-
-			Polygons cur_perimeter = diff(cur_slices, cur_fill);
+			Polygons cur_perimeter = diff(cur_polygons.slices, cur_fill);
 
 			// 再计算cur layer的perimeter与下一层的infill surface之间的diff
 			// 即在cur layer的perimeter中减去被下一层的perimeter支撑的部分
-			Polygons lower_infill;
-			// 			for (LayerRegion* region : lower_layer->regions) {
-			// 				//lower_infill.push_back(region->fill_surfaces.operator Slic3r::Polygons);
-			// 				lower_infill.insert(lower_infill.end(),
-			// 					region->fill_surfaces.operator Slic3r::Polygons().begin(),
-			// 					region->fill_surfaces.operator Slic3r::Polygons().end());
-			// 			}
-			for (LayerRegion* region : lower_layer->regions) {
-				for (Surface& surface : region->fill_surfaces.surfaces) {
-					lower_infill.push_back(surface.expolygon.contour);
-					lower_infill.insert(lower_infill.end(), surface.expolygon.holes.begin(), surface.expolygon.holes.end());
-				}
-			}
-
-
-			cur_perimeter = intersection(cur_perimeter, lower_infill, 1);
+			cur_perimeter = intersection(cur_perimeter, lower_polygons.fill, 1);
 
 			// 只考虑那些宽度超过extrusion width的perimeter
-			double width_threshold = 0;
-			for (LayerRegion* region : cur_layer->regions) {
-				width_threshold = std::min(width_threshold, (double)region->flow(frPerimeter).scaled_width());
-			}
-			cur_perimeter = offset2(cur_perimeter, -width_threshold, +width_threshold);
+			cur_perimeter = offset2(cur_perimeter, -cur_polygons.width_threshold, +cur_polygons.width_threshold);
 
 			// 将perimeters中没有被低层perimeter支撑的部分添加到overhang中
 			overhangs.insert(overhangs.end(), cur_perimeter.begin(), cur_perimeter.end());
@@ -1534,59 +2215,25 @@ void PrintObject::ClipFillSurfaces() {
 		// 与lower layer的internal和internal void区域做intersection
 
 		// 将当前层的overhang与上一层的internal合并
-		// 		Polygons cur_overhangs_upperinternal;
-		// 		std::merge(overhangs.begin(), overhangs.end(),
-		// 			upper_internal.begin(), upper_internal.end(),
-		// 			back_inserter(cur_overhangs_upperinternal));
-
 		Polygons cur_overhangs_upperinternal(overhangs.begin(), overhangs.end());
 		cur_overhangs_upperinternal.insert(cur_overhangs_upperinternal.end(),
 			upper_internal.begin(), upper_internal.end());
 
-		// 下一层的internal和internal void区域
-		Polygons lower_internal_internalvoid;
-		for (LayerRegion* region : lower_layer->regions) {
-			for (Surface& surface : region->fill_surfaces.surfaces) {
-				if (surface.surface_type == stInternal || surface.surface_type == stInternalVoid) {
-					//lower_internal_internalvoid.push_back(surface.operator Slic3r::Polygons);
-					// 					lower_internal_internalvoid.insert(lower_internal_internalvoid.end(), 
-					// 						surface.operator Slic3r::Polygons().begin(),
-					// 						surface.operator Slic3r::Polygons().end() );
-					lower_internal_internalvoid.push_back(surface.expolygon.contour);
-					lower_internal_internalvoid.insert(lower_internal_internalvoid.end(),
-						surface.expolygon.holes.begin(), surface.expolygon.holes.end());
-				}
-			}
-		}
-
 		//二者之间的intersection即为新的internal区域
-		Polygons new_internal = intersection(cur_overhangs_upperinternal, lower_internal_internalvoid);
+		Polygons new_internal = intersection(cur_overhangs_upperinternal, lower_polygons.internal_internalvoid);
 		upper_internal = new_internal;		//更新upper internal
 
 
-											// 将lower layer的new internal区域应用到每一个lower layer的每一个layer region上
-											// 方法是将new internal与每一个layer region的internal & internal void区域做intersection作为新的internal
-											// 而new internal与每一个layer region的internal & internal void区域的difference作为新的internal void
-		for (LayerRegion* layer_region : lower_layer->regions) {
+		// 将lower layer的new internal区域应用到每一个lower layer的每一个layer region上
+		// 方法是将new internal与每一个layer region的internal & internal void区域做intersection作为新的internal
+		// 而new internal与每一个layer region的internal & internal void区域的difference作为新的internal void
+		for (size_t region_id = 0; region_id < lower_layer->regions.size(); region_id++) {
+			LayerRegion* layer_region = lower_layer->regions[region_id];
 			if (layer_region->region()->config.fill_density == 0) return;
 
 			// lower layer上的internal surfaces和其他的surfaces
-			Polygons lower_internal_polygons;
-			Surfaces lower_other_surfaces;
-
-			for (Surface surface : layer_region->fill_surfaces.surfaces) {
-				if (surface.surface_type == stInternal || surface.surface_type == stInternalVoid) {
-					//lower_internal_polygons.push_back(surface.operator Slic3r::Polygons);
-					// 					lower_internal_polygons.insert(lower_internal_polygons.end(),
-					// 						surface.operator Slic3r::Polygons().begin(), surface.operator Slic3r::Polygons().end() );
-					lower_internal_polygons.push_back(surface.expolygon.contour);
-					lower_internal_polygons.insert(lower_internal_polygons.end(),
-						surface.expolygon.holes.begin(), surface.expolygon.holes.end());
-				}
-				else {
-					lower_other_surfaces.push_back(surface);
-				}
-			}
+			const Polygons& lower_internal_polygons = lower_polygons.region_internal[region_id];
+			Surfaces& lower_other_surfaces = lower_polygons.region_other[region_id];
 
 			// 将new internal与internal & internal void区域的intersection作为新的internal区域
 			Surfaces lower_internal_surfaces;
@@ -1607,8 +2254,7 @@ void PrintObject::ClipFillSurfaces() {
 			layer_region->fill_surfaces.append(lower_other_surfaces);
 		}
 
-
-
+		progress.LayerDone();
 	}
 }
 
@@ -1620,6 +2266,9 @@ void PrintObject::ClipFillSurfaces() {
 void PrintObject::CombineInfill() {
 
 
+	//所有要进行合并的组，每一项为<region_id, <合并组最上层的layer_id, 合并的层数>>
+	std::vector<std::pair<int, std::pair<int, int>>> groups;
+
 	//对每一个Print Region分别进行操作，对应的是每一个Print Region
 	for (int region_id = 0; region_id < _print->regions.size(); region_id++) {
 		PrintRegion* print_region = _print->get_region(region_id);
@@ -1661,131 +2310,177 @@ void PrintObject::CombineInfill() {
 
 
 		// 遍历所有要进行合并的Layer
+		// 最下方的合并组的最上层为第0层或第1层时结束整个合并过程，其余regions也不再合并
+		if (!combine.empty() && combine.begin()->first <= 1)
+			break;
 		for (auto layer_combine : combine) {
-			int layer_id = layer_combine.first;
-			if (layer_id <= 1)
-				return;
-
-			//获取所有要进行combine的layer region，这些layer region来自所有要合并的layer
-			LayerRegionPtrs layer_regions;
-			for (int id = layer_id - combine[layer_id] + 1; id <= layer_id; id++) {
-				layer_regions.push_back(get_layer(id)->get_region(region_id));
+			groups.push_back(std::make_pair(region_id, layer_combine));
+		}
+	}
+
+	//不同的合并组之间没有重叠的layer，各组并行合并
+	size_t combined_layers = 0;
+	for (auto& group : groups) {
+		combined_layers += group.second.second;
+	}
+	LayerProgress progress(_print, 45, 55, combined_layers, "Combining infill");
+	parallel_for(size_t(0), groups.size(),
+		[this, &groups, &progress](size_t group_id) {
+			_print->ThrowIfCanceled();
+			int region_id = groups[group_id].first;
+			int layer_id = groups[group_id].second.first;
+			int layers = groups[group_id].second.second;
+
+			// 合并组的输入未变时，直接使用上一次的计算结果
+			LayerRegion* top_layer_region = get_layer(layer_id)->get_region(region_id);
+			uint64_t key = hash_mix(uint64_t(layer_id), uint64_t(layers));
+			for (int id = layer_id - layers + 1; id <= layer_id; id++) {
+				const Layer* layer = get_layer(id);
+				key = hash_mix(key, uint64_t(layer->id()));
+				key = hash_mix(key, layer->height);
+				key = hash_surfaces(key, layer->regions[region_id]->fill_surfaces.surfaces);
+			}
+			if (_can_reuse_prepared_infill(region_id) && top_layer_region->combine_key == key) {
+				for (int id = layer_id - layers + 1; id <= layer_id; id++) {
+					get_layer(id)->regions[region_id]->fill_surfaces = top_layer_region->combine_result[id - (layer_id - layers + 1)];
+				}
+			}
+			else {
+				CombineLayersInfill(region_id, layer_id, layers);
+
+				top_layer_region->combine_key = key;
+				top_layer_region->combine_result.clear();
+				for (int id = layer_id - layers + 1; id <= layer_id; id++) {
+					top_layer_region->combine_result.push_back(get_layer(id)->regions[region_id]->fill_surfaces);
+				}
 			}
 
-			//只合并internal infill部分
-			for (SurfaceType type : {stInternal}) {
+			progress.LayerDone(layers);
+		},
+		1
+	);
+}
 
-				SurfacesPtr internal_fill_surfaces = layer_regions[0]->fill_surfaces.filter_by_type(type);
+/*
+*	合并region_id上以layer_id为最上层的layers层的internal fill surfaces
+*/
+void PrintObject::CombineLayersInfill(int region_id, int layer_id, int layers) {
+	//获取所有要进行combine的layer region，这些layer region来自所有要合并的layer
+	LayerRegionPtrs layer_regions;
+	for (int id = layer_id - layers + 1; id <= layer_id; id++) {
+		layer_regions.push_back(get_layer(id)->get_region(region_id));
+	}
 
-				//使用lowest layer来初始化intersection
-				ExPolygons intersection;
-				for (Surface* surface : internal_fill_surfaces) {
-					intersection.push_back(surface->expolygon);
-				}
+	//只合并internal infill部分
+	for (SurfaceType type : {stInternal}) {
 
-				//从第二层开始，将其fill surfaces与intersection进行intersection操作
-				for (int id = 1; id < layer_regions.size(); id++) {
-					SurfacesPtr temp_fill_surfaces = layer_regions[id]->fill_surfaces.filter_by_type(type);
-					ExPolygons temp_intersection;
-					for (Surface* surface : temp_fill_surfaces) {
-						temp_intersection.push_back(surface->expolygon);
-					}
+		SurfacesPtr internal_fill_surfaces = layer_regions[0]->fill_surfaces.filter_by_type(type);
 
-					intersection = intersection_ex(intersection, temp_intersection);
-				}
+		//使用lowest layer来初始化intersection
+		ExPolygons intersection;
+		for (Surface* surface : internal_fill_surfaces) {
+			intersection.push_back(surface->expolygon);
+		}
 
-				//在intersection中所有area小于临界值的部分都将被剔除
-				double area_threshold = layer_regions[0]->infill_area_threshold();
-				// 				for (auto iterator = intersection.begin(); iterator != intersection.end();) {
-				// 					if (iterator->area() < area_threshold) {
-				// 						intersection.erase(iterator);
-				// 					}
-				// 					else {
-				// 						++iterator;
-				// 					}
-				// 				}
-				intersection.erase(std::remove_if(intersection.begin(),
-					intersection.end(),
-					[&](ExPolygon expolygon) {
-					return expolygon.area() < area_threshold;
-				}),
-					intersection.end());
-
-				// 如果intersection为空，则进行下一次循环，即没有合格的intersection
-				if (intersection.empty()) {
-					continue;
-				}
+		//从第二层开始，将其fill surfaces与intersection进行intersection操作
+		for (int id = 1; id < layer_regions.size(); id++) {
+			SurfacesPtr temp_fill_surfaces = layer_regions[id]->fill_surfaces.filter_by_type(type);
+			ExPolygons temp_intersection;
+			for (Surface* surface : temp_fill_surfaces) {
+				temp_intersection.push_back(surface->expolygon);
+			}
 
-				// intersection包含可能被所有的layers合并的region，所以需要从所有的layers中移除这一部分
-				// layer_regions[-1] ???
-				std::vector<InfillPattern> patterns{ ipRectilinear, ipGrid, ipHoneycomb };
-				ExPolygons intersection_with_clearance = offset_ex(intersection,
-					layer_regions[0]->flow(frInfill).scaled_width() / 2 +
-					layer_regions[0]->flow(frPerimeter).scaled_width() / 2 +
-					((type == stInternalSolid) ||
-					(std::find(patterns.begin(), patterns.end(), print_region->config.fill_pattern) != patterns.end())
-						) ?
-					layer_regions[0]->flow(frSolidInfill).scaled_width() : 0
-					// 由于在稍后的步骤中rectlinear和honeycomb的填充区域将会grow，并与perimeters进行overlap，所以需要抵消这一部分
-				);
+			intersection = intersection_ex(intersection, temp_intersection);
+		}
 
+		//在intersection中所有area小于临界值的部分都将被剔除
+		double area_threshold = layer_regions[0]->infill_area_threshold();
+		// 				for (auto iterator = intersection.begin(); iterator != intersection.end();) {
+		// 					if (iterator->area() < area_threshold) {
+		// 						intersection.erase(iterator);
+		// 					}
+		// 					else {
+		// 						++iterator;
+		// 					}
+		// 				}
+		intersection.erase(std::remove_if(intersection.begin(),
+			intersection.end(),
+			[&](ExPolygon expolygon) {
+			return expolygon.area() < area_threshold;
+		}),
+			intersection.end());
+
+		// 如果intersection为空，则进行下一次循环，即没有合格的intersection
+		if (intersection.empty()) {
+			continue;
+		}
 
-				//当前合并区域的层高
-				double sum_height = 0;
-				for (LayerRegion* region : layer_regions) {
-					sum_height += region->layer()->height;
-				}
+		// intersection包含可能被所有的layers合并的region，所以需要从所有的layers中移除这一部分
+		// layer_regions[-1] ???
+		std::vector<InfillPattern> patterns{ ipRectilinear, ipGrid, ipHoneycomb };
+		ExPolygons intersection_with_clearance = offset_ex(intersection,
+			layer_regions[0]->flow(frInfill).scaled_width() / 2 +
+			layer_regions[0]->flow(frPerimeter).scaled_width() / 2 +
+			((type == stInternalSolid) ||
+			(std::find(patterns.begin(), patterns.end(), _print->get_region(region_id)->config.fill_pattern) != patterns.end())
+				) ?
+			layer_regions[0]->flow(frSolidInfill).scaled_width() : 0
+			// 由于在稍后的步骤中rectlinear和honeycomb的填充区域将会grow，并与perimeters进行overlap，所以需要抵消这一部分
+		);
 
-				// 对所有的layer region进行操作
-				for (LayerRegion* layer_region : layer_regions) {
-					ExPolygons this_type_expolygons;
-					Surfaces other_type_surfaces;
-					for (Surface& surface : layer_region->fill_surfaces.surfaces) {
-						if (surface.surface_type != type) {
-							this_type_expolygons.push_back(surface.expolygon);
-						}
-						else {
-							other_type_surfaces.push_back(surface);
-						}
-					}
 
-					//将internal infill与intersection with clearance做difference，得到new this type expolygons
-					ExPolygons new_this_type_expolygons = diff_ex(this_type_expolygons, intersection_with_clearance);
+		//当前合并区域的层高
+		double sum_height = 0;
+		for (LayerRegion* region : layer_regions) {
+			sum_height += region->layer()->height;
+		}
 
-					//将internal infill减去intersection with clearance后剩下的部分作为新的internal infill
-					Surfaces new_this_type_surfaces;
-					for (auto& expolygon : new_this_type_expolygons) {
-						new_this_type_surfaces.push_back(Surface(type, expolygon));
-					}
+		// 对所有的layer region进行操作
+		for (LayerRegion* layer_region : layer_regions) {
+			ExPolygons this_type_expolygons;
+			Surfaces other_type_surfaces;
+			for (Surface& surface : layer_region->fill_surfaces.surfaces) {
+				if (surface.surface_type != type) {
+					this_type_expolygons.push_back(surface.expolygon);
+				}
+				else {
+					other_type_surfaces.push_back(surface);
+				}
+			}
 
+			//将internal infill与intersection with clearance做difference，得到new this type expolygons
+			ExPolygons new_this_type_expolygons = diff_ex(this_type_expolygons, intersection_with_clearance);
+
+			//将internal infill减去intersection with clearance后剩下的部分作为新的internal infill
+			Surfaces new_this_type_surfaces;
+			for (auto& expolygon : new_this_type_expolygons) {
+				new_this_type_surfaces.push_back(Surface(type, expolygon));
+			}
 
-					// 将调整过高度之后的surfaces添加的最上层的layer
-					if (layer_region->layer()->id() == get_layer(layer_id)->id()) {
-						for (ExPolygon& expolygon : intersection) {
-							Surface new_surface(type, expolygon);
-							new_surface.thickness = sum_height;
-							new_surface.thickness_layers = layer_regions.size();
-							new_this_type_surfaces.push_back(new_surface);
-						}
-					}
-					else {		//对于其他层则为void层
-								// this type expolygons与intersection with clearance的intersection作为internal void区域
-								// 原因是该区域都被转换到顶层的高度上了
-						ExPolygons void_expolygons = intersection_ex(this_type_expolygons, intersection_with_clearance);
-						for (ExPolygon& expolygon : void_expolygons) {
-							new_this_type_surfaces.push_back(Surface(stInternalVoid, expolygon));
-						}
-					}
 
-					// 将计算后的fill surfaces添加到该layer region上
-					layer_region->fill_surfaces.clear();
-					layer_region->fill_surfaces.append(new_this_type_surfaces);
-					layer_region->fill_surfaces.append(other_type_surfaces);
+			// 将调整过高度之后的surfaces添加的最上层的layer
+			if (layer_region->layer()->id() == get_layer(layer_id)->id()) {
+				for (ExPolygon& expolygon : intersection) {
+					Surface new_surface(type, expolygon);
+					new_surface.thickness = sum_height;
+					new_surface.thickness_layers = layer_regions.size();
+					new_this_type_surfaces.push_back(new_surface);
+				}
+			}
+			else {		//对于其他层则为void层
+						// this type expolygons与intersection with clearance的intersection作为internal void区域
+						// 原因是该区域都被转换到顶层的高度上了
+				ExPolygons void_expolygons = intersection_ex(this_type_expolygons, intersection_with_clearance);
+				for (ExPolygon& expolygon : void_expolygons) {
+					new_this_type_surfaces.push_back(Surface(stInternalVoid, expolygon));
 				}
 			}
 
+			// 将计算后的fill surfaces添加到该layer region上
+			layer_region->fill_surfaces.clear();
+			layer_region->fill_surfaces.append(new_this_type_surfaces);
+			layer_region->fill_surfaces.append(other_type_surfaces);
 		}
-
 	}
 }
 
@@ -1793,8 +2488,9 @@ void PrintObject::CombineInfill() {
 /*
 *	对Slices进行简化，只有在需要的时候才进行
 */
-void PrintObject::SimplySlices(double distance) {
-	for (auto& layer : layers) {
+void PrintObject::SimplySlices(double distance, size_t first_layer) {
+	for (auto layer_id = first_layer; layer_id < layer_count(); layer_id++) {
+		Layer* layer = get_layer(layer_id);
 		layer->slices.simplify(distance);
 		for (auto& region : layer->regions) {
 			region->slices.simplify(distance);
@@ -1846,15 +2542,16 @@ void PrintObject::GenerateSupportMaterial() {
 
 	SupportMaterial support_material = SupportMaterial(&(_print->config), &config, &first_layer_flow, &support_flow, &interface_flow);
 
-	_print->SetProgressStatus(85, QString("Generating support material"));
+	_print->SetProgressStatus(85, "Generating support material");
 
 	support_material.Generate(*this);
 
 	state.set_done(posSupportMaterial);
 
 	//设置状态栏内容和进度条
-	QString final_stats = "Weight: " + QString::number(_print->total_weight) + ", Cost: " + QString::number(_print->total_cost);
-	_print->SetProgressStatus(85, final_stats);
+	std::ostringstream final_stats;
+	final_stats << "Weight: " << _print->total_weight << ", Cost: " << _print->total_cost;
+	_print->SetProgressStatus(85, final_stats.str());
 }
 
 }
@@ -1,4 +1,5 @@
 #include "Print.hpp"
+#include <algorithm>
 
 namespace Slic3r {
 
@@ -151,10 +152,18 @@ PrintRegion::invalidate_state_by_config(const PrintConfigBase &config)
             if (object->invalidate_all_steps())
                 invalidated = true;
     } else {
+        // only the objects having volumes in this region are affected,
+        // and only for the layers of this region
+        const size_t region_id = std::find(this->print()->regions.begin(), this->print()->regions.end(), this)
+            - this->print()->regions.begin();
         for (const PrintObjectStep &step : steps)
-            for (PrintObject* object : this->print()->objects)
-                if (object->invalidate_step(step))
+            for (PrintObject* object : this->print()->objects) {
+                std::map<size_t, std::vector<int> >::const_iterator volumes = object->region_volumes.find(region_id);
+                if (volumes == object->region_volumes.end() || volumes->second.empty())
+                    continue;
+                if (object->invalidate_region(step, region_id))
                     invalidated = true;
+            }
     }
     
     return invalidated;
@@ -64,11 +64,13 @@ SLAPrint::slice()
         fill->angle         = Geometry::deg2rad(this->config.fill_angle.value);
         fill->density       = this->config.fill_density.value/100;
         
-        parallelize<size_t>(
-            0,
-            this->layers.size()-1,
-            boost::bind(&SLAPrint::_infill_layer, this, _1, fill.get()),
-            this->config.threads.value
+        ThreadPool::instance().resize(this->config.threads.value);
+        Fill* layer_fill = fill.get();
+        parallel_for(size_t(0), this->layers.size(),
+            [this, layer_fill](size_t layer_idx) {
+                this->_infill_layer(layer_idx, layer_fill);
+            },
+            1
         );
     }
     
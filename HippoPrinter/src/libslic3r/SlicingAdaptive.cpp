@@ -0,0 +1,85 @@
+#include "SlicingAdaptive.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Slic3r {
+
+// facets with |n_z| above this are treated as horizontal surfaces
+static const float HORIZONTAL_NORMAL_Z = 0.99999f;
+
+void
+SlicingAdaptive::add_mesh(const TriangleMesh &mesh)
+{
+	this->_facets.reserve(this->_facets.size() + mesh.stl.stats.number_of_facets);
+	for (int i = 0; i < mesh.stl.stats.number_of_facets; ++i) {
+		const stl_facet &facet = mesh.stl.facet_start[i];
+		// the stored normals are not trusted, compute them from the vertices
+		double ax = facet.vertex[1].x - facet.vertex[0].x;
+		double ay = facet.vertex[1].y - facet.vertex[0].y;
+		double az = facet.vertex[1].z - facet.vertex[0].z;
+		double bx = facet.vertex[2].x - facet.vertex[0].x;
+		double by = facet.vertex[2].y - facet.vertex[0].y;
+		double bz = facet.vertex[2].z - facet.vertex[0].z;
+		double nx = ay * bz - az * by;
+		double ny = az * bx - ax * bz;
+		double nz = ax * by - ay * bx;
+		double length = sqrt(nx * nx + ny * ny + nz * nz);
+		if (length == 0) continue;
+
+		Facet f;
+		f.z_min = std::min(facet.vertex[0].z, std::min(facet.vertex[1].z, facet.vertex[2].z));
+		f.z_max = std::max(facet.vertex[0].z, std::max(facet.vertex[1].z, facet.vertex[2].z));
+		f.normal_z = float(std::abs(nz) / length);
+		if (f.normal_z > HORIZONTAL_NORMAL_Z)
+			this->_horizontal_z.push_back(0.5 * (f.z_min + f.z_max));
+		else
+			this->_facets.push_back(f);
+	}
+}
+
+void
+SlicingAdaptive::prepare()
+{
+	std::sort(this->_facets.begin(), this->_facets.end(),
+		[](const Facet &f1, const Facet &f2) { return f1.z_min < f2.z_min; });
+	std::sort(this->_horizontal_z.begin(), this->_horizontal_z.end());
+	this->_horizontal_z.erase(std::unique(this->_horizontal_z.begin(), this->_horizontal_z.end()),
+		this->_horizontal_z.end());
+	this->_next_facet = 0;
+	this->_active.clear();
+}
+
+coordf_t
+SlicingAdaptive::next_layer_height(coordf_t z, coordf_t cusp_value, coordf_t min_height, coordf_t max_height)
+{
+	// drop the facets ending below z and take in the ones starting below the tallest layer
+	this->_active.erase(std::remove_if(this->_active.begin(), this->_active.end(),
+		[z](const Facet &f) { return f.z_max <= z + EPSILON; }), this->_active.end());
+	for (; this->_next_facet < this->_facets.size() && this->_facets[this->_next_facet].z_min < z + max_height; ++this->_next_facet)
+		if (this->_facets[this->_next_facet].z_max > z + EPSILON)
+			this->_active.push_back(this->_facets[this->_next_facet]);
+
+	// the active facets are sorted by z_min, so once one starts above the layer
+	// (which only gets thinner) none of the following can be crossed by it
+	coordf_t height = max_height;
+	for (const Facet &f : this->_active) {
+		if (f.z_min >= z + height) break;
+		if (f.normal_z * height > cusp_value)
+			height = cusp_value / f.normal_z;
+	}
+	height = std::max(height, min_height);
+
+	// end the layer on a horizontal surface close above, or split the distance to it
+	// in two layers when a single one would leave a sliver below min_height
+	std::vector<coordf_t>::const_iterator it = std::upper_bound(this->_horizontal_z.begin(), this->_horizontal_z.end(), z + EPSILON);
+	if (it != this->_horizontal_z.end()) {
+		coordf_t distance = *it - z;
+		if (distance < height)
+			height = std::max(distance, min_height);
+		else if (distance < height + min_height && distance / 2 >= min_height)
+			height = distance / 2;
+	}
+	return height;
+}
+
+}
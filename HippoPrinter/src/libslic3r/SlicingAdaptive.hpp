@@ -0,0 +1,52 @@
+#ifndef slic3r_SlicingAdaptive_hpp_
+#define slic3r_SlicingAdaptive_hpp_
+
+#include "libslic3r.h"
+#include "TriangleMesh.hpp"
+#include <vector>
+
+namespace Slic3r {
+
+// Chooses the height of each layer from the slope of the mesh facets it crosses.
+// A layer of height h printed over a facet whose normal has the z component n_z
+// leaves a cusp (the stair step measured along the normal) of h * |n_z|, so the
+// tallest layer keeping the cusp below a given value is cusp / |n_z|: vertical
+// walls allow any height, nearly horizontal surfaces need the thinnest layers.
+//
+// The queries must be issued bottom up, with non decreasing z, as the layers are
+// generated; the facets below the current z are dropped as the sweep advances.
+class SlicingAdaptive
+{
+	public:
+	SlicingAdaptive() : _next_facet(0) {};
+	// Adds the facets of a mesh already placed in the object coordinate system
+	// (z = 0 at the bottom of the object).
+	void add_mesh(const TriangleMesh &mesh);
+	// Sorts the facets, to be called once all the meshes were added.
+	void prepare();
+	bool empty() const { return this->_facets.empty(); };
+	// Height of the layer starting at z, between min_height and max_height, so that
+	// no facet crossed by the layer gets a cusp larger than cusp_value. The layer is
+	// also shortened to end on a horizontal surface close above z, so that flat tops
+	// and ledges land on a layer boundary.
+	coordf_t next_layer_height(coordf_t z, coordf_t cusp_value, coordf_t min_height, coordf_t max_height);
+
+	private:
+	struct Facet {
+		float z_min, z_max;
+		// |n_z| of the unit normal
+		float normal_z;
+	};
+	// sorted by z_min
+	std::vector<Facet> _facets;
+	// heights of the horizontal facets, sorted
+	std::vector<coordf_t> _horizontal_z;
+	// first facet of _facets not moved to _active yet
+	size_t _next_facet;
+	// facets reaching above the current z, in ascending order of z_min
+	std::vector<Facet> _active;
+};
+
+}
+
+#endif
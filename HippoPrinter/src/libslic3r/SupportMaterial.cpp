@@ -29,14 +29,14 @@ void SupportMaterial::Generate(PrintObject& object) {
 	std::map<double, Polygons> contact_map;		//<print_z,polygons>
 	std::map<double, Polygons> overhang_map;	//<print_z, polygons>
 	std::map<double, Polygons> top_map;		//<print_z,polygons>
-	std::map<int, Polygons> interface_map;	//<layer_id, polygons>
-	std::map<int, Polygons> base_map;		//<layer_id, polygons>
 	
 	std::vector<double> support_z;
 
 	ContactArea(object,contact_map, overhang_map);
+	object.print()->ThrowIfCanceled();
 
 	ObjectTop(object, contact_map, top_map);
+	object.print()->ThrowIfCanceled();
 
 	std::vector<double> contact_z;
 	for (auto& val : contact_map) {
@@ -55,20 +55,66 @@ void SupportMaterial::Generate(PrintObject& object) {
 
 	SupportLayersZ(object,contact_z,top_z,max_layer_height,support_z);
 
-	std::map<int, Polygons> pillars_shape;
+	//support layersobject layerszڲlayerغϵlayers
+	support_intervals_ = LayerIntervals(support_z);
+	object_intervals_ = LayerIntervals(object.layers);
+
+	bool tree_support = (object_config_->support_material_pattern == smpTree);
+	std::vector<Polygons> pillars_shape(support_z.size());
 	if (object_config_->support_material_pattern == smpPillars) {
 		GeneratePillarsShape(contact_map, support_z, pillars_shape);
 	}
-	GenerateInterfaceLayers(support_z, contact_map, top_map, interface_map);
-	ClipWithObject(object, base_map, support_z);
-	ClipWithShape(interface_map, pillars_shape);
+	object.print()->ThrowIfCanceled();
+
+	//˺ǰsupport layerʵģǱ浽support layer idΪУ
+	//е̶ֻ߳عЩ
+	//contactoverhangֻsupport layerĸ߶ϱʣsupport_zеֱӶ
+	std::vector<Polygons> contact_layers(support_z.size());
+	std::vector<Polygons> overhang_layers(support_z.size());
+	std::vector<Polygons> top_layers(support_z.size());
+	for (size_t i = 0; i < support_z.size(); i++) {
+		auto contact_it = contact_map.find(support_z[i]);
+		if (contact_it != contact_map.end()) {
+			contact_layers[i] = std::move(contact_it->second);
+		}
+		auto overhang_it = overhang_map.find(support_z[i]);
+		if (overhang_it != overhang_map.end()) {
+			overhang_layers[i] = std::move(overhang_it->second);
+		}
+		//GenerateBottomInterfacesLayers()Ҫtop_map
+		auto top_it = top_map.find(support_z[i]);
+		if (top_it != top_map.end()) {
+			top_layers[i] = top_it->second;
+		}
+	}
+	contact_map.clear();
+	overhang_map.clear();
+
+	std::vector<Polygons> interface_layers(support_z.size());
+	std::vector<Polygons> base_layers(support_z.size());
+
+	GenerateInterfaceLayers(support_z, contact_layers, top_layers, interface_layers);
+	ClipWithObject(object, base_layers, support_z);
+	if (!tree_support) {
+		ClipWithShape(interface_layers, pillars_shape);
+	}
 
 
-	GenerateBaseLayers(support_z, contact_map, top_map, interface_map, base_map);
-	ClipWithObject(object, base_map, support_z);
-	ClipWithShape(base_map, pillars_shape);
+	object.print()->ThrowIfCanceled();
+	if (tree_support) {
+		//״֧ŽṹֻϡbranchesɣҪcontact area´
+		GenerateTreeLayers(object, support_z, contact_layers, base_layers);
+	}
+	else {
+		GenerateBaseLayers(support_z, contact_layers, top_layers, interface_layers, base_layers);
+	}
+	ClipWithObject(object, base_layers, support_z);
+	if (!tree_support) {
+		ClipWithShape(base_layers, pillars_shape);
+	}
 
-	GenerateBottomInterfacesLayers(support_z, base_map, top_map, interface_map);
+	GenerateBottomInterfacesLayers(support_z, base_layers, top_map, interface_layers);
+	object.print()->ThrowIfCanceled();
 
 	for (int i = 0; i < support_z.size(); i++) {
 		object.add_support_layer(i,		//id
@@ -81,7 +127,8 @@ void SupportMaterial::Generate(PrintObject& object) {
 		}
 	}
 	
-	GenerateToolPaths(object, overhang_map, contact_map, interface_map, base_map);
+	GenerateToolPaths(object, overhang_layers, contact_layers, interface_layers, base_layers);
+	object.print()->ThrowIfCanceled();
 }
 
 
@@ -93,187 +140,222 @@ void SupportMaterial::Generate(PrintObject& object) {
 void SupportMaterial::ContactArea(PrintObject& object, std::map<double, Polygons>& contact_map,
 	std::map<double, Polygons>& overhang_map) {
 
-	//ûõǽǶֵתΪ
-	// +1Ա֤תֵԭֵӦĻֵ
-	double threshold_rad = Geometry::deg2rad(object_config_->support_material_threshold + 1);
-
 	//жǷֻbuild plateϹsupprt material, Ļtop surfaces浽buildplate_only_top_surfacesУȻ
 	//contact surfacesмȥbuildplate_only_top_surfacesͲڱtop_surfaces֧ŵcontact surface
 	//֧Žṹ
 	bool buildplate_only = (object_config_->support_material_buildplate_only||object_config_->support_material_enforce_layers)
 		&& object_config_->support_material_buildplate_only;
-	
-	Polygons buildplate_only_top_surfaces;
-
-	
-	//contact areas  overhang areas
-	for (int layer_id = 0; layer_id < object.layer_count(); layer_id++) {
-	//for(int layer_id = object.layer_count()-1; layer_id >= 0; layer_id--){
-
-		//ע⣺raft_layers0ʱlayer_id һlayer->id
-		//˴layer_id = 0ʾfirst object layer
-		//layer->id == 0ʾfirst print layer(raft layers)
-		
-		//ûraft,layer 0,layer 1
-		if (object_config_->raft_layers == 0 && layer_id == 0) {
-			continue;
-		}
 
-		//support materialߵǰlayerѾ˱ɵsupport layers
-		//˳ѭ
-		if (layer_id > 0 &&
-			!object_config_->support_material && 
-			(layer_id >= object_config_->support_material_enforce_layers)) {
-			break;
-		}
-		
-		Layer* layer = object.get_layer(layer_id);
+	//Ҫlayers
+	//ע⣺raft_layers0ʱlayer_id һlayer->id
+	//˴layer_id = 0ʾfirst object layer
+	//layer->id == 0ʾfirst print layer(raft layers)
+	//ûraft,layer 1ʼ
+	//support materialֻsupport materiallayers
+	int first_layer_id = (object_config_->raft_layers == 0) ? 1 : 0;
+	int last_layer_id = object.layer_count();
+	if (!object_config_->support_material) {
+		last_layer_id = std::min(last_layer_id, std::max(1, int(object_config_->support_material_enforce_layers)));
+	}
+	if (first_layer_id >= last_layer_id) {
+		return;
+	}
 
-		//modelsupport material
-		if (buildplate_only) {
-			//layerϵеtop surfacesϲһ
-			Polygons projection_new;
-			for (LayerRegion* layer_region : layer->regions) {
-				for (Surface& surface : layer_region->slices.surfaces) {
-					if (surface.surface_type == stTop) {
-						projection_new.push_back(surface.expolygon.contour);
-						projection_new.insert(projection_new.end(), 
-							surface.expolygon.holes.begin(), surface.expolygon.holes.end());
+	//buildplate_onlyʱÿһҪõò㼰·layersϵtop surfacesĲ
+	//Ȳеؼÿһϵtop surfaces¶κϲϲĽֻڳµtop surfacesʱŻı䣬
+	//ֻÿθıĽtop_surfaces_index¼ÿһӦĽ
+	std::vector<Polygons> buildplate_only_top_surfaces(1);
+	std::vector<size_t> top_surfaces_index(object.layer_count(), 0);
+	if (buildplate_only) {
+		std::vector<Polygons> projections(object.layer_count());
+		parallel_for(first_layer_id, last_layer_id,
+			[&](int layer_id) {
+				object.print()->ThrowIfCanceled();
+				//layerϵеtop surfacesϲһ
+				Polygons& projection_new = projections[layer_id];
+				for (LayerRegion* layer_region : object.get_layer(layer_id)->regions) {
+					for (Surface& surface : layer_region->slices.surfaces) {
+						if (surface.surface_type == stTop) {
+							projection_new.push_back(surface.expolygon.contour);
+							projection_new.insert(projection_new.end(),
+								surface.expolygon.holes.begin(), surface.expolygon.holes.end());
+						}
 					}
 				}
+				//ӵtop surfacesаȫƫƣԱ֤֮ǰlayersϵtop surfacesһ
+				//ǲںϲĹнаȫƫƣΪᵼbuild_only_top_surfacesԽԽ
+				if (!projection_new.empty()) {
+					projection_new = offset(projection_new, scale_(0.01));
+				}
+			},
+			1
+		);
+
+		//ǰtop surfaces֮ǰLayersϵtop surfacesкϲ
+		for (int layer_id = first_layer_id; layer_id < last_layer_id; layer_id++) {
+			if (!projections[layer_id].empty()) {
+				Polygons top_surfaces = buildplate_only_top_surfaces.back();
+				top_surfaces.insert(top_surfaces.end(), projections[layer_id].begin(), projections[layer_id].end());
+				buildplate_only_top_surfaces.push_back(union_(top_surfaces, 0));
 			}
+			top_surfaces_index[layer_id] = buildplate_only_top_surfaces.size() - 1;
+		}
+	}
 
-			//ǰtop surfaces֮ǰLayersϵtop surfacesкϲ
-			//ӵtop surfacesаȫƫƣԱ֤֮ǰlayersϵtop surfacesһ
-			//ǲںϲĹнаȫƫƣΪᵼbuild_only_top_surfacesԽԽ
-			if (!projection_new.empty()) {
-				projection_new = offset(projection_new, scale_(0.01));
-
-				buildplate_only_top_surfaces.insert(buildplate_only_top_surfaces.end(),
-					projection_new.begin(), projection_new.end());
+	//еؼÿһcontact areasoverhang areasٰlayer˳򱣴浽map
+	std::vector<Polygons> contacts(object.layer_count());
+	std::vector<Polygons> overhangs(object.layer_count());
+	std::vector<coordf_t> contacts_z(object.layer_count(), 0);
+	std::vector<char> has_contact(object.layer_count(), false);
+	parallel_for(first_layer_id, last_layer_id,
+		[&](int layer_id) {
+			object.print()->ThrowIfCanceled();
+			has_contact[layer_id] = LayerContactArea(object, layer_id,
+				buildplate_only_top_surfaces[top_surfaces_index[layer_id]],
+				contacts[layer_id], overhangs[layer_id], contacts_z[layer_id]);
+		},
+		1
+	);
 
-				buildplate_only_top_surfaces = union_(buildplate_only_top_surfaces, 0);
-			}
+	for (int layer_id = first_layer_id; layer_id < last_layer_id; layer_id++) {
+		if (has_contact[layer_id]) {
+			contact_map[contacts_z[layer_id]] = std::move(contacts[layer_id]);
+			overhang_map[contacts_z[layer_id]] = std::move(overhangs[layer_id]);
 		}
+	}
+}
 
 
-		//Ҫ֧ŵoverhangscontacts
-		Polygons contact;
-		Polygons overhang;
+/*
+ *	һlayercontact areaoverhang areaԼcontact areaĸ߶contact_z
+ *	buildplate_only_top_surfacesΪò㼰·layersϵtop surfacesֻbuildplate_onlyʱʹã
+ *	layerҪ֧ţ򷵻false
+ */
+bool SupportMaterial::LayerContactArea(PrintObject& object, int layer_id, const Polygons& buildplate_only_top_surfaces,
+	Polygons& contact, Polygons& overhang, coordf_t& contact_z) {
 
-		
-		if (layer_id == 0) {
-			//first object playerҪraftռõĿռ䣬˴ֻcontourholes
-			for (ExPolygon& expolygon : layer->slices.expolygons) {
-				overhang.push_back(expolygon.contour);
-			}
-			//Polygons offseted_overhang = offset(overhang, scale_(+SUPPORT_MATERIAL_MARGIN));
-			//contact.insert(contact.end(), offseted_overhang.begin(), offseted_overhang.end());
-			contact = offset(overhang, scale_(+SUPPORT_MATERIAL_MARGIN));
+	//ûõǽǶֵתΪ
+	// +1Ա֤תֵԭֵӦĻֵ
+	double threshold_rad = Geometry::deg2rad(object_config_->support_material_threshold + 1);
+
+	bool buildplate_only = (object_config_->support_material_buildplate_only||object_config_->support_material_enforce_layers)
+		&& object_config_->support_material_buildplate_only;
+
+	Layer* layer = object.get_layer(layer_id);
+
+	//Ҫ֧ŵoverhangscontacts
+	if (layer_id == 0) {
+		//first object playerҪraftռõĿռ䣬˴ֻcontourholes
+		for (ExPolygon& expolygon : layer->slices.expolygons) {
+			overhang.push_back(expolygon.contour);
+		}
+		//Polygons offseted_overhang = offset(overhang, scale_(+SUPPORT_MATERIAL_MARGIN));
+		//contact.insert(contact.end(), offseted_overhang.begin(), offseted_overhang.end());
+		contact = offset(overhang, scale_(+SUPPORT_MATERIAL_MARGIN));
+	}
+	else {
+		Layer* lower_layer = object.get_layer(layer_id - 1);
+
+		//ǰlower layersϵpolygonsԱҪ
+		Polygons lower_slice_polygons;
+		for (ExPolygon& expolygon : lower_layer->slices.expolygons) {
+			lower_slice_polygons.push_back(expolygon.contour);
+			lower_slice_polygons.insert(lower_slice_polygons.end(),
+				expolygon.holes.begin(), expolygon.holes.end());
 		}
-		else {
-			Layer* lower_layer = object.get_layer(layer_id - 1);
 
-			//ǰlower layersϵpolygonsԱҪ
-			Polygons lower_slice_polygons;
-			for (ExPolygon& expolygon : lower_layer->slices.expolygons) {
-				lower_slice_polygons.push_back(expolygon.contour);
-				lower_slice_polygons.insert(lower_slice_polygons.end(),
-					expolygon.holes.begin(), expolygon.holes.end());
+		//ֱÿһLayerRegionд
+		for (LayerRegion* layer_region : layer->regions) {
+			coord_t flow_width = layer_region->flow(frExternalPerimeter).scaled_width();
+			
+			//diffʾlayerperimetercenterlinelower layerboundary֮diff, Ҳoverhang
+			Polygons diff_polygons;		
+			
+			Polygons layer_region_polygons;
+			for (Surface& surface : layer_region->slices.surfaces) {
+				layer_region_polygons.push_back(surface.expolygon.contour);
+				layer_region_polygons.insert(layer_region_polygons.end(),
+					surface.expolygon.holes.begin(), surface.expolygon.holes.end());
 			}
 
-			//ֱÿһLayerRegionд
-			for (LayerRegion* layer_region : layer->regions) {
-				coord_t flow_width = layer_region->flow(frExternalPerimeter).scaled_width();
-				
-				//diffʾlayerperimetercenterlinelower layerboundary֮diff, Ҳoverhang
-				Polygons diff_polygons;		
+
+			//ָthreshold angle,Ҫʹòͬ߼overhangs
+			if ((object_config_->support_material && threshold_rad != 0) ||
+				(layer_id <= object_config_->support_material_enforce_layers) ||
+				(object_config_->raft_layers > 0 && layer_id == 0)) {
 				
-				Polygons layer_region_polygons;
-				for (Surface& surface : layer_region->slices.surfaces) {
-					layer_region_polygons.push_back(surface.expolygon.contour);
-					layer_region_polygons.insert(layer_region_polygons.end(),
-						surface.expolygon.holes.begin(), surface.expolygon.holes.end());
+				double layer_threshold_rad = threshold_rad;
+				coord_t d = 0;
+				if (layer_id <= object_config_->support_material_enforce_layers) {
+					layer_threshold_rad = Geometry::deg2rad(89);
+				}
+				if (layer_threshold_rad != 0) {
+					d = scale_(lower_layer->height * (cos(layer_threshold_rad) / sin(layer_threshold_rad)));
 				}
 
+				//layer_regionϵslicesoffset󣬺lower_layerϵslicesdiff
+				Polygons region_slice_polygons;
+				for (Surface& surface : layer_region->slices.surfaces) {
+					ExPolygon& expolygon = surface.expolygon;
+					region_slice_polygons.push_back(expolygon.contour);
+					region_slice_polygons.insert(region_slice_polygons.end(),
+						expolygon.holes.begin(), expolygon.holes.end());
+				}
 
-				//ָthreshold angle,Ҫʹòͬ߼overhangs
-				if ((object_config_->support_material && threshold_rad != 0) ||
-					(layer_id <= object_config_->support_material_enforce_layers) ||
-					(object_config_->raft_layers > 0 && layer_id == 0)) {
-					
-					double layer_threshold_rad = threshold_rad;
-					coord_t d = 0;
-					if (layer_id <= object_config_->support_material_enforce_layers) {
-						layer_threshold_rad = Geometry::deg2rad(89);
-					}
-					if (layer_threshold_rad != 0) {
-						d = scale_(lower_layer->height * (cos(layer_threshold_rad) / sin(layer_threshold_rad)));
-					}
-
-					//layer_regionϵslicesoffset󣬺lower_layerϵslicesdiff
-					Polygons region_slice_polygons;
-					for (Surface& surface : layer_region->slices.surfaces) {
-						ExPolygon& expolygon = surface.expolygon;
-						region_slice_polygons.push_back(expolygon.contour);
-						region_slice_polygons.insert(region_slice_polygons.end(),
-							expolygon.holes.begin(), expolygon.holes.end());
-					}
-
-					Polygons lower_polygons;
-					for (ExPolygon& expolygon : lower_layer->slices.expolygons) {
-						lower_polygons.push_back(expolygon.contour);
-						lower_polygons.insert(lower_polygons.end(),
-							expolygon.holes.begin(), expolygon.holes.end());
-					}
+				Polygons lower_polygons;
+				for (ExPolygon& expolygon : lower_layer->slices.expolygons) {
+					lower_polygons.push_back(expolygon.contour);
+					lower_polygons.insert(lower_polygons.end(),
+						expolygon.holes.begin(), expolygon.holes.end());
+				}
 
-					diff_polygons = diff(offset(region_slice_polygons, -d), lower_polygons);
+				diff_polygons = diff(offset(region_slice_polygons, -d), lower_polygons);
 
-					if (d > (flow_width / 2)) {
-						diff_polygons = diff(offset(diff_polygons, (d - flow_width / 2)), lower_polygons);
-					}
+				if (d > (flow_width / 2)) {
+					diff_polygons = diff(offset(diff_polygons, (d - flow_width / 2)), lower_polygons);
 				}
-				else{
-					double offset_distance = object_config_->get_abs_value("support_material_threshold", flow_width);
+			}
+			else{
+				double offset_distance = object_config_->get_abs_value("support_material_threshold", flow_width);
+
+				diff_polygons = diff(layer_region_polygons, offset(lower_slice_polygons, offset_distance));
 
-					diff_polygons = diff(layer_region_polygons, offset(lower_slice_polygons, offset_distance));
+				//ɾЩرС					
+				diff_polygons = offset2(diff_polygons, -flow_width / 10, +flow_width / 10);
+				
+				//diff_polygonslower_slicesı߽һoverhanging regionsperimetercenterlineɵringstripe
+				//diffΪʾò㲻perimetercenterlinelower_slice boundary֮Ҳûoverhang
+			}
 
-					//ɾЩرС					
-					diff_polygons = offset2(diff_polygons, -flow_width / 10, +flow_width / 10);
+			//Ҫ֧Bridgeṹ
+			if (object_config_->dont_support_bridges == true) {
+				//bridging perimeters
+				Polygons bridged_perimeters;
+				{
+					Flow bridge_flow = layer_region->flow(frPerimeter, 1);
+
+					//ȡlower layerslicesgrow half the nozzle diameter
+					//ԭǼʹhalf nozzle diameterĿlower layer棬ȻΪòǱlower layer֧ŵ
+					double nozzle_diameter = print_config_->nozzle_diameter.get_at(
+						layer_region->region()->config.perimeter_extruder - 1);
+					Polygons lower_grown_slices = offset(lower_slice_polygons, scale_(+nozzle_diameter / 2));
 					
-					//diff_polygonslower_slicesı߽һoverhanging regionsperimetercenterlineɵringstripe
-					//diffΪʾò㲻perimetercenterlinelower_slice boundary֮Ҳûoverhang
-				}
+					//ȡPolylinesʽperimeters
+					ExtrusionEntityCollection perimeters_collection;
+					layer_region->perimeters.flatten(&perimeters_collection);
 
-				//Ҫ֧Bridgeṹ
-				if (object_config_->dont_support_bridges == true) {
-					//bridging perimeters
-					Polygons bridged_perimeters;
-					{
-						Flow bridge_flow = layer_region->flow(frPerimeter, 1);
-
-						//ȡlower layerslicesgrow half the nozzle diameter
-						//ԭǼʹhalf nozzle diameterĿlower layer棬ȻΪòǱlower layer֧ŵ
-						double nozzle_diameter = print_config_->nozzle_diameter.get_at(
-							layer_region->region()->config.perimeter_extruder - 1);
-						Polygons lower_grown_slices = offset(lower_slice_polygons, scale_(+nozzle_diameter / 2));
-						
-						//ȡPolylinesʽperimeters
-						ExtrusionEntityCollection* perimeters_collection = new ExtrusionEntityCollection;
-						layer_region->perimeters.flatten(perimeters_collection);
-
-						Polylines overhang_perimeters;
-						for (ExtrusionEntity* entity : perimeters_collection->entities) {
-							overhang_perimeters.push_back(entity->as_polyline());
-						}
-						for (Polyline& polyline : overhang_perimeters) {
-							polyline.points[0].translate(1, 0);
-						}
+					Polylines overhang_perimeters;
+					for (ExtrusionEntity* entity : perimeters_collection.entities) {
+						overhang_perimeters.push_back(entity->as_polyline());
+					}
+					for (Polyline& polyline : overhang_perimeters) {
+						polyline.points[0].translate(1, 0);
+					}
 
-						//ֻperimetersoverhang
-						overhang_perimeters = diff_pl(overhang_perimeters, lower_grown_slices);
+					//ֻperimetersoverhang
+					overhang_perimeters = diff_pl(overhang_perimeters, lower_grown_slices);
 
-						//ֻstrtaight overhangs
+					//ֻstrtaight overhangs
 // 						Polylines temp_overhang_perimeters;
 // 						for (Polyline& polyline : overhang_perimeters) {
 // 							if (polyline.is_straight()) {
@@ -281,16 +363,16 @@ void SupportMaterial::ContactArea(PrintObject& object, std::map<double, Polygons
 // 							}
 // 						}
 // 						std::swap(temp_overhang_perimeters, overhang_perimeters);
-						overhang_perimeters.erase(std::remove_if(overhang_perimeters.begin(),overhang_perimeters.end(),
-							[](Polyline& polyline) {return !polyline.is_straight(); }),
-							overhang_perimeters.end());
-
-						//ֻյlayer slicesڵoverhangs
-						for (Polyline& polyline : overhang_perimeters) {
-							polyline.extend_start(flow_width);
-							polyline.extend_end(flow_width);
-						}
-						
+					overhang_perimeters.erase(std::remove_if(overhang_perimeters.begin(),overhang_perimeters.end(),
+						[](Polyline& polyline) {return !polyline.is_straight(); }),
+						overhang_perimeters.end());
+
+					//ֻյlayer slicesڵoverhangs
+					for (Polyline& polyline : overhang_perimeters) {
+						polyline.extend_start(flow_width);
+						polyline.extend_end(flow_width);
+					}
+					
 // 						temp_overhang_perimeters.clear();
 // 						for (Polyline& polyline : overhang_perimeters) {
 // 							if (layer->slices.contains(polyline.first_point()) && layer->slices.contains(polyline.last_point())) {
@@ -299,148 +381,143 @@ void SupportMaterial::ContactArea(PrintObject& object, std::map<double, Polygons
 // 						}
 // 						swap(temp_overhang_perimeters, overhang_perimeters);
 
-						overhang_perimeters.erase(std::remove_if(overhang_perimeters.begin(),overhang_perimeters.end(),
-							[&](Polyline& polyline) {
-							return !layer->slices.contains(polyline.first_point()) || !layer->slices.contains(polyline.last_point());
-							}),
-							overhang_perimeters.end());
-
-
-						//ͨչpolylineĿȣbridging polylinesתΪpolygons
-						{
-							//bridgesܼĿȴspacing,ԭǸnon-bridging perimeters spacing
-							//ȷλõ
-							double width = std::max({ bridge_flow.scaled_width(),
-								bridge_flow.scaled_spacing(),
-								flow_width,
-								layer_region->flow(frPerimeter).scaled_width() });
-
-							Polygons grown_perimeters;
-							for (Polyline& polyline : overhang_perimeters) {
-								Polygons polygons = offset(polyline, (width / 2 + 10));
-								grown_perimeters.insert(grown_perimeters.end(),
-									polygons.begin(), polygons.end());
-							}
-
-							bridged_perimeters = union_(grown_perimeters);
-						}
+					overhang_perimeters.erase(std::remove_if(overhang_perimeters.begin(),overhang_perimeters.end(),
+						[&](Polyline& polyline) {
+						return !layer->slices.contains(polyline.first_point()) || !layer->slices.contains(polyline.last_point());
+						}),
+						overhang_perimeters.end());
 
-					}	//end for computing bridged_perimeters
 
-					
-					//Ƴbridges,ֻ֧Щunsupport edges
-					Polygons bridge_polygons;
-					for (Surface& surface : layer_region->fill_surfaces.surfaces) {
-						if (surface.surface_type == stBottomBridge &&  surface.bridge_angle != -1) {
-							bridge_polygons.push_back(surface.expolygon.contour);
-							bridge_polygons.insert(bridge_polygons.end(),
-								surface.expolygon.holes.begin(), surface.expolygon.holes.end());
-							//bridged_perimeters.push_back(surface.expolygon.contour);
-							//bridged_perimeters.insert(bridged_perimeters.end(),
-							//	bridge_polygons.begin(), bridge_polygons.end());
+					//ͨչpolylineĿȣbridging polylinesתΪpolygons
+					{
+						//bridgesܼĿȴspacing,ԭǸnon-bridging perimeters spacing
+						//ȷλõ
+						double width = std::max({ bridge_flow.scaled_width(),
+							bridge_flow.scaled_spacing(),
+							flow_width,
+							layer_region->flow(frPerimeter).scaled_width() });
+
+						Polygons grown_perimeters;
+						for (Polyline& polyline : overhang_perimeters) {
+							Polygons polygons = offset(polyline, (width / 2 + 10));
+							grown_perimeters.insert(grown_perimeters.end(),
+								polygons.begin(), polygons.end());
 						}
+
+						bridged_perimeters = union_(grown_perimeters);
 					}
-					
-					bridged_perimeters.insert(bridged_perimeters.end(), 
-						bridge_polygons.begin(), bridge_polygons.end());
-					diff_polygons = diff(diff_polygons, bridged_perimeters, 1);
 
-					Polygons grown_bridged_edges;
-					for (Polyline& polyline : layer_region->unsupported_bridge_edges.polylines) {
-						Polygons grown = offset(polyline, scale_(SUPPORT_MATERIAL_MARGIN));
+				}	//end for computing bridged_perimeters
 
-						grown_bridged_edges.insert(grown_bridged_edges.end(),
-							grown.begin(), grown.end());
+				
+				//Ƴbridges,ֻ֧Щunsupport edges
+				Polygons bridge_polygons;
+				for (Surface& surface : layer_region->fill_surfaces.surfaces) {
+					if (surface.surface_type == stBottomBridge &&  surface.bridge_angle != -1) {
+						bridge_polygons.push_back(surface.expolygon.contour);
+						bridge_polygons.insert(bridge_polygons.end(),
+							surface.expolygon.holes.begin(), surface.expolygon.holes.end());
+						//bridged_perimeters.push_back(surface.expolygon.contour);
+						//bridged_perimeters.insert(bridged_perimeters.end(),
+						//	bridge_polygons.begin(), bridge_polygons.end());
 					}
-						
-					Polygons intersection_polygons = intersection(grown_bridged_edges, bridge_polygons);
-					diff_polygons.insert(diff_polygons.end(), intersection_polygons.begin(), intersection_polygons.end());
-						
-				}	//if(dont_support_bridges)
+				}
+				
+				bridged_perimeters.insert(bridged_perimeters.end(), 
+					bridge_polygons.begin(), bridge_polygons.end());
+				diff_polygons = diff(diff_polygons, bridged_perimeters, 1);
 
+				Polygons grown_bridged_edges;
+				for (Polyline& polyline : layer_region->unsupported_bridge_edges.polylines) {
+					Polygons grown = offset(polyline, scale_(SUPPORT_MATERIAL_MARGIN));
 
-				if (buildplate_only) {
-					//Ҫtop surfacessupport overhangs
-					//Ҫͨgrow overhang regioncontact surface֮ǰ
-					diff_polygons = diff(diff_polygons, buildplate_only_top_surfaces);
+					grown_bridged_edges.insert(grown_bridged_edges.end(),
+						grown.begin(), grown.end());
 				}
+					
+				Polygons intersection_polygons = intersection(grown_bridged_edges, bridge_polygons);
+				diff_polygons.insert(diff_polygons.end(), intersection_polygons.begin(), intersection_polygons.end());
+					
+			}	//if(dont_support_bridges)
 
-				if (diff_polygons.empty()) {
-					continue;
-				}
 
-				overhang.insert(overhang.end(), diff_polygons.begin(), diff_polygons.end());
+			if (buildplate_only) {
+				//Ҫtop surfacessupport overhangs
+				//Ҫͨgrow overhang regioncontact surface֮ǰ
+				diff_polygons = diff(diff_polygons, buildplate_only_top_surfaces);
+			}
 
-				//ʹgapֵhalf the upper extrusion width)contact area, ʹõĲֵextend
-				//extend contact areaʱõextendķʽԭǱ֧Žṹobjectһoverflow
-				Polygons lower_polygons;
-				for (ExPolygon& expolygon : lower_layer->slices.expolygons) {
-					lower_polygons.push_back(expolygon.contour);
-					lower_polygons.insert(lower_polygons.end(),
-						expolygon.holes.begin(), expolygon.holes.end());
-				}
-				Polygons slice_margin = offset(lower_polygons, +flow_width / 2);
-				if (buildplate_only) {
-					//ͬʹtop surfaces޼contact surfaces
-					slice_margin.insert(slice_margin.end(), 
-						buildplate_only_top_surfaces.begin(), buildplate_only_top_surfaces.end());
-					slice_margin = union_(slice_margin);
-				}
+			if (diff_polygons.empty()) {
+				continue;
+			}
 
-				for (coord_t i = 0; i <= 3; i++) {
-					if (i == 0) {
-						coord_t temp_offset = flow_width / 2;
-						diff_polygons = diff(offset(diff_polygons, +temp_offset), slice_margin);
-					}
-					else {
-						coord_t temp_offset = scale_(SUPPORT_MATERIAL_MARGIN/3);
-						diff_polygons = diff(offset(diff_polygons, +temp_offset), slice_margin);
-					}
-					//diff_polygons = diff(offset(diff_polygons, flow_width / 2), slice_margin);
-				}
+			overhang.insert(overhang.end(), diff_polygons.begin(), diff_polygons.end());
 
-				contact.insert(contact.end(), diff_polygons.begin(), diff_polygons.end());
+			//ʹgapֵhalf the upper extrusion width)contact area, ʹõĲֵextend
+			//extend contact areaʱõextendķʽԭǱ֧Žṹobjectһoverflow
+			Polygons lower_polygons;
+			for (ExPolygon& expolygon : lower_layer->slices.expolygons) {
+				lower_polygons.push_back(expolygon.contour);
+				lower_polygons.insert(lower_polygons.end(),
+					expolygon.holes.begin(), expolygon.holes.end());
+			}
+			Polygons slice_margin = offset(lower_polygons, +flow_width / 2);
+			if (buildplate_only) {
+				//ͬʹtop surfaces޼contact surfaces
+				slice_margin.insert(slice_margin.end(), 
+					buildplate_only_top_surfaces.begin(), buildplate_only_top_surfaces.end());
+				slice_margin = union_(slice_margin);
+			}
 
+			for (coord_t i = 0; i <= 3; i++) {
+				if (i == 0) {
+					coord_t temp_offset = flow_width / 2;
+					diff_polygons = diff(offset(diff_polygons, +temp_offset), slice_margin);
+				}
+				else {
+					coord_t temp_offset = scale_(SUPPORT_MATERIAL_MARGIN/3);
+					diff_polygons = diff(offset(diff_polygons, +temp_offset), slice_margin);
+				}
+				//diff_polygons = diff(offset(diff_polygons, flow_width / 2), slice_margin);
 			}
-		
-		}	//end for layer_id != 0
 
-		if(contact.empty())	continue;
+			contact.insert(contact.end(), diff_polygons.begin(), diff_polygons.end());
 
+		}
+	
+	}	//end for layer_id != 0
 
-		//潫contact areaӦõӦlayer
-		{
-			std::vector<double> nozzles;
-			for (LayerRegion* layer_region : layer->regions) {
-				double peri_nozzle_diameter = print_config_->nozzle_diameter.get_at(layer_region->region()->config.perimeter_extruder - 1);
-				double infill_nozzle_diameter = print_config_->nozzle_diameter.get_at(layer_region->region()->config.infill_extruder - 1);
-				double solid_nozzle_diameter = print_config_->nozzle_diameter.get_at(layer_region->region()->config.solid_infill_extruder - 1);
+	if (contact.empty()) {
+		return false;
+	}
 
-				nozzles.push_back(peri_nozzle_diameter);
-				nozzles.push_back(infill_nozzle_diameter);
-				nozzles.push_back(solid_nozzle_diameter);
-			}
+	//潫contact areaӦõӦlayer
+	std::vector<double> nozzles;
+	for (LayerRegion* layer_region : layer->regions) {
+		double peri_nozzle_diameter = print_config_->nozzle_diameter.get_at(layer_region->region()->config.perimeter_extruder - 1);
+		double infill_nozzle_diameter = print_config_->nozzle_diameter.get_at(layer_region->region()->config.infill_extruder - 1);
+		double solid_nozzle_diameter = print_config_->nozzle_diameter.get_at(layer_region->region()->config.solid_infill_extruder - 1);
 
-			double nozzle_diamter = std::accumulate(nozzles.begin(), nozzles.end(), 0.0) / nozzles.size();
+		nozzles.push_back(peri_nozzle_diameter);
+		nozzles.push_back(infill_nozzle_diameter);
+		nozzles.push_back(solid_nozzle_diameter);
+	}
 
-			coordf_t contact_z = layer->print_z - ContactDistance(layer->height, nozzle_diamter);
+	double nozzle_diamter = std::accumulate(nozzles.begin(), nozzles.end(), 0.0) / nozzles.size();
 
-			//layer is too low,Ӹlayer
-			double first_layer_height = object_config_->get_abs_value("first_layer_height") - EPSILON;
-			if (contact_z < first_layer_height) {
-				continue;
-			}
+	contact_z = layer->print_z - ContactDistance(layer->height, nozzle_diamter);
 
-			contact_map[contact_z] = contact;
-			overhang_map[contact_z] = overhang;
-		}
-		
+	//layer is too low,Ӹlayer
+	double first_layer_height = object_config_->get_abs_value("first_layer_height") - EPSILON;
+	if (contact_z < first_layer_height) {
+		return false;
 	}
-
+	return true;
 }
 
 
 
+
 /*
  *	objecttop surfaces,Ҫøòжsupport materiallayer_height,
  *  ͬʱɾobjectµ֧ţõλ
@@ -583,59 +660,41 @@ void SupportMaterial::SupportLayersZ(PrintObject& object, std::vector<double>& c
 /*
  *	contact layers´interface layers
  */
-void SupportMaterial::GenerateInterfaceLayers(std::vector<double>& support_z,std::map<double, Polygons>& contact_map,
-	std::map<double,Polygons>& top_map, std::map<int, Polygons>& interface_map) {
+void SupportMaterial::GenerateInterfaceLayers(const std::vector<double>& support_z, const std::vector<Polygons>& contact_layers,
+	const std::vector<Polygons>& top_layers, std::vector<Polygons>& interface_layers) {
 	int interface_layers_num = object_config_->support_material_interface_layers;
 
 	//contact areas·interface layers
 	for (int layer_id = 0; layer_id < support_z.size(); layer_id++) {
-		double z_val = support_z[layer_id];
-
-		Polygons this_polygons;
-		if (contact_map.find(z_val) == contact_map.end()) {
+		if (contact_layers[layer_id].empty()) {
 			continue;
 		}
-		else {
-			this_polygons = contact_map[z_val];
-		}
+		Polygons this_polygons = contact_layers[layer_id];
 
 		//contact layerinterface layer
 		for (int i = layer_id - 1; i >= 0 && i > layer_id - interface_layers_num; i--) {
-			double z_val = support_z[i];
-			std::vector<int> overlapping_layers = OverlappingLayers(i, support_z);
-			std::vector<double> overlapping_z;
-			for (auto& val : overlapping_layers) {
-				overlapping_z.push_back(support_z[val]);
-			}
+			std::vector<int> overlapping_layers = OverlappingLayers(i);
 
 			//ǰinterface areaΪupper contact areaupper interface arealayer slices֮diff
 			//diffsupport materialtop surfaces
 			Polygons diff_polygons1;
 			//ǰcontact regionбɾӳ(clipped projection)
 			diff_polygons1.insert(diff_polygons1.end(), this_polygons.begin(), this_polygons.end());
-			if (interface_map.find(i) != interface_map.end()) {
-				//òѾinterface region
-				diff_polygons1.insert(diff_polygons1.end(), interface_map[i].begin(), interface_map[i].end());
-			}
+			//òѾinterface region
+			diff_polygons1.insert(diff_polygons1.end(), interface_layers[i].begin(), interface_layers[i].end());
 
 			Polygons diff_polygons2;
-			for (double d : overlapping_z) {
-				if (top_map.find(d) != top_map.end()) {
-					//òtop slices
-					diff_polygons2.insert(diff_polygons2.end(), top_map[d].begin(), top_map[d].end());
-				}
+			for (int j : overlapping_layers) {
+				//òtop slices
+				diff_polygons2.insert(diff_polygons2.end(), top_layers[j].begin(), top_layers[j].end());
 			}
-
-			for (double d : overlapping_z) {
+			for (int j : overlapping_layers) {
 				//òcontact regions
-				if (contact_map.find(d) != contact_map.end()) {
-					diff_polygons2.insert(diff_polygons2.end(), contact_map[d].begin(), contact_map[d].end());
-				}
+				diff_polygons2.insert(diff_polygons2.end(), contact_layers[j].begin(), contact_layers[j].end());
 			}
 
-			Polygons diff_polygons = diff(diff_polygons1, diff_polygons2, 1);
-			this_polygons = diff_polygons;
-			interface_map[i] = diff_polygons;
+			this_polygons = diff(diff_polygons1, diff_polygons2, 1);
+			interface_layers[i] = this_polygons;
 		}
 	}
 }
@@ -644,8 +703,8 @@ void SupportMaterial::GenerateInterfaceLayers(std::vector<double>& support_z,std
 /*
  *	base support layerһreverse interfaces, ԭobject top surfaces
  */
-void SupportMaterial::GenerateBottomInterfacesLayers(std::vector<double>& support_z, std::map<int, Polygons>& base_map,
-	std::map<double, Polygons>& top_map, std::map<int, Polygons>& interface_map) {
+void SupportMaterial::GenerateBottomInterfacesLayers(const std::vector<double>& support_z, std::vector<Polygons>& base_layers,
+	const std::map<double, Polygons>& top_map, std::vector<Polygons>& interface_layers) {
 	
 	//interface layersκbottom interface layers
 	if (object_config_->support_material_interface_layers == 0) {
@@ -657,10 +716,10 @@ void SupportMaterial::GenerateBottomInterfacesLayers(std::vector<double>& suppor
 
 	//objecttop surfaces
 	for (auto& val : top_map) {
-		Polygons& this_polygons = val.second;
+		const Polygons& this_polygons = val.second;
 
 		//¼Ϊtop surfaceɵinterface layers
-		int interface_layers = 0;
+		int interface_layers_count = 0;
 		
 		//еsupport layersֱҵһtop surfaceϷsupport layer
 		for (int layer_id = 0; layer_id < support_z.size(); layer_id++) {
@@ -669,11 +728,10 @@ void SupportMaterial::GenerateBottomInterfacesLayers(std::vector<double>& suppor
 				continue;
 			}
 
-			if (base_map.find(layer_id) != base_map.end()) {
-				//ӦΪinterface areasupport material area
-				Polygons interface_area_polygons = intersection(base_map[layer_id], this_polygons);
+			//ӦΪinterface areasupport material area
+			Polygons interface_area_polygons = intersection(base_layers[layer_id], this_polygons);
 
-				//ɾС
+			//ɾС
 // 				Polygons temp_interface_area;
 // 				for (Polygon& polygon : interface_area_polygons) {
 // 					if (std::abs(polygon.area()) >= area_threshold) {
@@ -681,20 +739,20 @@ void SupportMaterial::GenerateBottomInterfacesLayers(std::vector<double>& suppor
 // 					}
 // 				}
 // 				std::swap(temp_interface_area, interface_area_polygons);
-				interface_area_polygons.erase(std::remove_if(interface_area_polygons.begin(),
-					interface_area_polygons.end(),
-					[&](Polygon& polygon) {return std::abs(polygon.area()) < area_threshold; }),
-					interface_area_polygons.end());
+			interface_area_polygons.erase(std::remove_if(interface_area_polygons.begin(),
+				interface_area_polygons.end(),
+				[&](Polygon& polygon) {return std::abs(polygon.area()) < area_threshold; }),
+				interface_area_polygons.end());
 
-				base_map[layer_id] = diff(base_map[layer_id], interface_area_polygons);
+			base_layers[layer_id] = diff(base_layers[layer_id], interface_area_polygons);
 
-				//µinterface area浽interface
-				interface_map[layer_id].insert(interface_map[layer_id].end(),
-					interface_area_polygons.begin(), interface_area_polygons.end());
-			}
-			interface_layers++;
+			//µinterface area浽interface
+			interface_layers[layer_id].insert(interface_layers[layer_id].end(),
+				interface_area_polygons.begin(), interface_area_polygons.end());
 
-			if (interface_layers == object_config_->support_material_interface_layers) {
+			interface_layers_count++;
+
+			if (interface_layers_count == object_config_->support_material_interface_layers) {
 				break;
 			}
 		}
@@ -704,100 +762,104 @@ void SupportMaterial::GenerateBottomInterfacesLayers(std::vector<double>& suppor
 /*
  *	contact layersinterface layers´ݣmain support layers
  */
-void SupportMaterial::GenerateBaseLayers(std::vector<double>& support_z, std::map<double,Polygons>& contact_map,
-	std::map<double,Polygons>& top_map,std::map<int,Polygons>& interface_map, std::map<int,Polygons>& base_map) {
-
-	//interface·support layers
-	for (int i = support_z.size() - 1; i >= 0; i--) {
-		double z_val = support_z[i];
-		std::vector<int> overlapping_layers = OverlappingLayers(i, support_z);
-		std::vector<double> overlapping_z;
-		for (int val : overlapping_layers) {
-			overlapping_z.push_back(support_z[val]);
-		}
-
-		//Ϊ˱ûinterface layerҪ۲upper layer
-		//һinterace layerʾֻһcontact layer,interace[i+1]Ϊ
-		Polygons upper_contact;
-		if (object_config_->support_material_interface_layers <= 1) {
-			double temp_z_val = support_z[i + 1];
-			if (contact_map.find(temp_z_val) != contact_map.end()) {
-				upper_contact = contact_map[temp_z_val];
-			}
-		}
-
-		Polygons diff_polygons1;
-		//upper layerϵsupport regions
-		if (base_map.find(i + 1) != base_map.end()) {
-			diff_polygons1.insert(diff_polygons1.end(), base_map[i + 1].begin(),base_map[i+1].end());
-		}
-		//upper layerϵinterface regions
-		if (interface_map.find(i + 1) != interface_map.end()) {
-			diff_polygons1.insert(diff_polygons1.end(), interface_map[i + 1].begin(), interface_map[i + 1].end());
-		}
-		//upper layerϵcontact regions
-		diff_polygons1.insert(diff_polygons1.end(), upper_contact.begin(), upper_contact.end());
-
-
-		Polygons diff_polygons2;
-		//top slicescontact regions on this layer
-		for (double z : overlapping_z) {
-			if (top_map.find(z) != top_map.end()) {
-				diff_polygons2.insert(diff_polygons2.end(), top_map[z].begin(), top_map[z].end());
+void SupportMaterial::GenerateBaseLayers(const std::vector<double>& support_z, const std::vector<Polygons>& contact_layers,
+	const std::vector<Polygons>& top_layers, const std::vector<Polygons>& interface_layers, std::vector<Polygons>& base_layers) {
+	int layers_count = support_z.size();
+
+	//ÿһҪupper layerмȥĲ(òtop slices, contact regionsinterface regions)
+	//ļ޹أȲеذǼ϶µĴݹֻҪdiff
+	std::vector<Polygons> clip_polygons(layers_count);
+	parallel_for(0, layers_count,
+		[&](int i) {
+			std::vector<int> overlapping_layers = OverlappingLayers(i);
+			Polygons& diff_polygons2 = clip_polygons[i];
+			//top slicescontact regions on this layer
+			for (int j : overlapping_layers) {
+				diff_polygons2.insert(diff_polygons2.end(), top_layers[j].begin(), top_layers[j].end());
+				diff_polygons2.insert(diff_polygons2.end(), contact_layers[j].begin(), contact_layers[j].end());
 			}
-
-			if (contact_map.find(z) != contact_map.end()) {
-				diff_polygons2.insert(diff_polygons2.end(), contact_map[z].begin(), contact_map[z].end());
+			//interface layers on this layer
+			for (int j : overlapping_layers) {
+				diff_polygons2.insert(diff_polygons2.end(), interface_layers[j].begin(), interface_layers[j].end());
 			}
-		}
+		},
+		1
+	);
 
-		//interface layers on this layer
-		for (int i : overlapping_layers) {
-			if (interface_map.find(i) != interface_map.end()) {
-				diff_polygons2.insert(diff_polygons2.end(), interface_map[i].begin(), interface_map[i].end());
+	//interface·support layers
+	for (int i = layers_count - 1; i >= 0; i--) {
+		Polygons diff_polygons1;
+		if (i + 1 < layers_count) {
+			//upper layerϵsupport regions
+			diff_polygons1.insert(diff_polygons1.end(), base_layers[i + 1].begin(), base_layers[i + 1].end());
+			//upper layerϵinterface regions
+			diff_polygons1.insert(diff_polygons1.end(), interface_layers[i + 1].begin(), interface_layers[i + 1].end());
+			//Ϊ˱ûinterface layerҪ۲upper layer
+			//һinterace layerʾֻһcontact layer,interace[i+1]Ϊ
+			if (object_config_->support_material_interface_layers <= 1) {
+				//upper layerϵcontact regions
+				diff_polygons1.insert(diff_polygons1.end(), contact_layers[i + 1].begin(), contact_layers[i + 1].end());
 			}
 		}
 
-		base_map[i] = diff(diff_polygons1, diff_polygons2, 1);
+		base_layers[i] = diff(diff_polygons1, clip_polygons[i], 1);
+		Polygons().swap(clip_polygons[i]);
 	}
 }
 
-void SupportMaterial::ClipWithObject(PrintObject& object, std::map<int,Polygons>& support_map,
-		std::vector<double>& support_z) {
+void SupportMaterial::ClipWithObject(PrintObject& object, std::vector<Polygons>& support_layers,
+		const std::vector<double>& support_z) {
 
-	for (auto& val : support_map) {
-		if (val.second.empty()) {
-			continue;
-		}
+	//֮໥д
+	parallel_for(0, int(support_layers.size()),
+		[&](int layer_id) {
+			Polygons& support = support_layers[layer_id];
+			if (support.empty()) {
+				return;
+			}
 
-		double z_max = support_z[val.first];
-		double z_min = (val.first == 0) ? 0 : support_z[val.first - 1];
+			double z_max = support_z[layer_id];
+			double z_min = (layer_id == 0) ? 0 : support_z[layer_id - 1];
+
+			//layer->slicescurrent layerϵfull shape, Ҳperimeter's width
+			//support support materialfull shape, ҲҪextrusion
+			//бfull extrusion width
+			//ԶsupportslicediffûӰ죬offset֮ǰȰbounding box޳
+			//(offsetmiter limitΪ3sliceչ3width)
+			BoundingBox support_bbox;
+			for (const Polygon& polygon : support) {
+				support_bbox.merge(polygon.bounding_box());
+			}
+			support_bbox.offset(3 * flow_->scaled_width() + 1);
 
-		//layer->slicescurrent layerϵfull shape, Ҳperimeter's width
-		//support support materialfull shape, ҲҪextrusion
-		//бfull extrusion width
-		Polygons layer_slice_polygons;
-		for (Layer* layer : object.layers) {
-			if (layer->print_z > z_min && (layer->print_z - layer->height) < z_max) {
-				for (ExPolygon& expolygon : layer->slices.expolygons) {
+			Polygons layer_slice_polygons;
+			for (int object_layer_id : object_intervals_.overlapping(z_min, z_max)) {
+				for (ExPolygon& expolygon : object.layers[object_layer_id]->slices.expolygons) {
+					if (!support_bbox.overlap(expolygon.contour.bounding_box())) {
+						continue;
+					}
 					layer_slice_polygons.push_back(expolygon.contour);
 					layer_slice_polygons.insert(layer_slice_polygons.end(), 
 						expolygon.holes.begin(), expolygon.holes.end());
 				}
 			}
-		}
 
-		support_map[val.first] = diff(val.second, offset(layer_slice_polygons, +flow_->scaled_width()));
-	}
+			support = diff_clustered(support, offset(layer_slice_polygons, +flow_->scaled_width()));
+		},
+		1
+	);
 }
 
-void SupportMaterial::GenerateToolPaths(PrintObject& object,std::map<double,Polygons>& overhang_map,
-	std::map<double,Polygons>& contact_map,std::map<int,Polygons>& interface_map,std::map<int,Polygons>& base_map) {
-	parallelize<int>(
-		0,
-		object.support_layers.size()-1,
-		boost::bind(&SupportMaterial::ProcessLayer,this,std::ref(object),_1,overhang_map,contact_map,interface_map,base_map),
-		print_config_->threads.value
+void SupportMaterial::GenerateToolPaths(PrintObject& object, const std::vector<Polygons>& overhang_layers,
+	const std::vector<Polygons>& contact_layers, const std::vector<Polygons>& interface_layers,
+	const std::vector<Polygons>& base_layers) {
+	// ProcessLayer()ֻȡЩ飬е߳̿ԹͬһݣҪԸһ
+	parallel_for(0, int(object.support_layers.size()),
+		[&](int layer_id) {
+			object.print()->ThrowIfCanceled();
+			ProcessLayer(object, layer_id, overhang_layers, contact_layers, interface_layers, base_layers);
+		},
+		1
 	);
 
 }
@@ -806,8 +868,9 @@ void SupportMaterial::GenerateToolPaths(PrintObject& object,std::map<double,Poly
 /*
  *	ֱÿһ֧Žṹдһ
  */
-void SupportMaterial::ProcessLayer(PrintObject& object,int layer_id, std::map<double, Polygons>& overhang_map,
-	std::map<double, Polygons>& contact_map, std::map<int, Polygons>& interface_map, std::map<int, Polygons>& base_map) {
+void SupportMaterial::ProcessLayer(PrintObject& object, int layer_id, const std::vector<Polygons>& overhang_layers,
+	const std::vector<Polygons>& contact_layers, const std::vector<Polygons>& interface_layers,
+	const std::vector<Polygons>& base_layers) {
 	int contact_loops = 1;
 	
 	//circle: contact area״	
@@ -823,15 +886,15 @@ void SupportMaterial::ProcessLayer(PrintObject& object,int layer_id, std::map<do
 
 	//֧Žṹģʽ
 	SupportMaterialPattern support_pattern = object_config_->support_material_pattern;
-	InfillPattern support_infill_pattern;
+	//rectilinear, rectilinear gridtreeʹrectilinear
+	InfillPattern support_infill_pattern = ipRectilinear;
 	int angle = object_config_->support_material_angle;
 	std::vector<double> angles(1, angle);
 
 	if (support_pattern == smpRectilinearGrid) {
-		support_infill_pattern = ipRectilinear;
 		angles.push_back(angles[0] + 90);
 	}
-	else if (support_pattern == smpPillars) {
+	else if (support_pattern == smpHoneycomb || support_pattern == smpPillars) {
 		support_infill_pattern = ipHoneycomb;
 	}
 
@@ -844,7 +907,6 @@ void SupportMaterial::ProcessLayer(PrintObject& object,int layer_id, std::map<do
 
 	//support layer
 	SupportLayer* support_layer = object.support_layers[layer_id];
-	double z = support_layer->print_z;
 
 	//flowĲ
 	Flow flow = *flow_;
@@ -852,24 +914,11 @@ void SupportMaterial::ProcessLayer(PrintObject& object,int layer_id, std::map<do
 	Flow interface_flow = *interface_flow_;
 	interface_flow.height = support_layer->height;
 
-	Polygons overhang_polygons;
-	Polygons contact_polygons;
-	Polygons interface_polygons;
-	Polygons base_polygons;
-	
-	//ȡӡ߶zӦoverhang area, contact area, interface area, base area
-	if (overhang_map.find(z) != overhang_map.end()) {
-		overhang_polygons = overhang_map[z];
-	}
-	if (contact_map.find(z) != contact_map.end()) {
-		contact_polygons = contact_map[z];
-	}
-	if (interface_map.find(layer_id) != interface_map.end()) {
-		interface_polygons = interface_map[layer_id];
-	}
-	if (base_map.find(layer_id) != base_map.end()) {
-		base_polygons = base_map[layer_id];
-	}
+	//ȡòoverhang area, contact area, interface area, base area
+	const Polygons& overhang_polygons = overhang_layers[layer_id];
+	Polygons contact_polygons = contact_layers[layer_id];
+	Polygons interface_polygons = interface_layers[layer_id];
+	Polygons base_polygons = base_layers[layer_id];
 
 	//islands,Խдӡ,contact area, interface area, base areaunion
 	Polygons islands_polygons = contact_polygons;
@@ -1098,8 +1147,8 @@ void SupportMaterial::ProcessLayer(PrintObject& object,int layer_id, std::map<do
 /*
  * object top surfacesϵfirst support layer
  */
-void SupportMaterial::GeneratePillarsShape(std::map<double,Polygons>& contact_map,std::vector<double> support_z,
-	std::map<int,Polygons>& shape_map) {
+void SupportMaterial::GeneratePillarsShape(std::map<double,Polygons>& contact_map, const std::vector<double>& support_z,
+	std::vector<Polygons>& shape_map) {
 	
 	//ÿյ㼯BoundingBox
 	if (contact_map.empty()) {
@@ -1194,38 +1243,282 @@ void SupportMaterial::GeneratePillarsShape(std::map<double,Polygons>& contact_ma
 }
 
 
-void SupportMaterial::ClipWithShape(std::map<int,Polygons>& support, std::map<int,Polygons>& shape_map) {
-	for (auto& val : support) {
-		//Ҫclip bottom layersӶcontinuous base flangeҲclip raft layers
-		int layer_id = val.first;
-		if (layer_id == 0 || layer_id < object_config_->raft_layers) {
-			continue;
+namespace {
+
+//״֧ŽṹһbranchĳһϵĽ
+struct TreeNode {
+	Point position;
+	coord_t radius;
+};
+
+//ڵ㰴ձ߳Ϊcell_size飬ڲһڵڽڵ
+class TreeNodeGrid {
+public:
+	TreeNodeGrid(const Points& positions, coord_t cell_size) : cell_size_(cell_size) {
+		for (int k = 0; k < int(positions.size()); k++) {
+			cells_[Key(Cell(positions[k].x), Cell(positions[k].y))].push_back(k);
+		}
+	}
+
+	//С˳򣬱positionΧ3x3cellенڵ
+	template<class Func>
+	void ForEachNear(const Point& position, Func func) const {
+		coord_t cx = Cell(position.x);
+		coord_t cy = Cell(position.y);
+		for (coord_t x = cx - 1; x <= cx + 1; x++) {
+			for (coord_t y = cy - 1; y <= cy + 1; y++) {
+				auto it = cells_.find(Key(x, y));
+				if (it == cells_.end()) {
+					continue;
+				}
+				for (int k : it->second) {
+					func(k);
+				}
+			}
 		}
-		val.second = intersection(val.second, shape_map[layer_id]);
 	}
 
+private:
+	coord_t Cell(coord_t c) const {
+		return (c >= 0) ? c / cell_size_ : -((-c - 1) / cell_size_) - 1;
+	}
+	static int64_t Key(coord_t x, coord_t y) {
+		return (int64_t(x) << 32) ^ (int64_t(y) & 0xffffffff);
+	}
+
+	coord_t cell_size_;
+	std::map<int64_t, std::vector<int>> cells_;
+};
+
+//ԭΪԲĵΣbranchԲν
+Polygon TreeCircle(coord_t radius) {
+	const int segments = 12;
+	Polygon circle;
+	for (int k = 0; k < segments; k++) {
+		double angle = 2 * PI * k / segments;
+		circle.points.push_back(Point(coord_t(radius * cos(angle)), coord_t(radius * sin(angle))));
+	}
+	return circle;
+}
+
 }
 
+
 /*
- *	layerغϵlayer
+ *	contact area·ѡȡϡ֧ŵ(tips)֧ŵλڼΪspacingȫϣ
+ *	ڵcontact layersϵ֧ŵ¶룬ʱϲ
  */
-std::vector<int> SupportMaterial::OverlappingLayers(int index,const std::vector<double>& support_z) {
+Points SupportMaterial::TreeTips(const Polygons& contact_polygons, coord_t spacing, coord_t tip_radius) {
+	Points tips;
+	for (ExPolygon& island : union_ex(contact_polygons)) {
+		size_t island_tips = tips.size();
+
+		//֧ŵԲνҪȫcontact area
+		for (ExPolygon& inner : offset_ex(island, -tip_radius)) {
+			BoundingBox bbox = inner.contour.bounding_box();
+			Points candidates;
+			coord_t x_min = bbox.min.x - ((bbox.min.x % spacing) + spacing) % spacing;
+			coord_t y_min = bbox.min.y - ((bbox.min.y % spacing) + spacing) % spacing;
+			for (coord_t x = x_min; x <= bbox.max.x; x += spacing) {
+				for (coord_t y = y_min; y <= bbox.max.y; y += spacing) {
+					candidates.push_back(Point(x, y));
+				}
+			}
+			std::vector<bool> inside = inner.contains(candidates);
+			for (int k = 0; k < int(candidates.size()); k++) {
+				if (inside[k]) {
+					tips.push_back(candidates[k]);
+				}
+			}
+			//contact areaܲκ㣬ʱٱһ֧ŵ
+			if (tips.size() == island_tips) {
+				tips.push_back(inner.contour.points.front());
+			}
+		}
 
-	double z_max = support_z[index];
-	double z_min = (index == 0) ? 0 : support_z[index - 1];
+		//contact areaСΪ
+		if (tips.size() == island_tips) {
+			Point centroid = island.contour.centroid();
+			tips.push_back(island.contains(centroid) ? centroid : island.contour.points.front());
+		}
+	}
+	return tips;
+}
 
-	std::vector<int> res;
 
-	for (int i = 0; i < support_z.size(); i++) {
-		double z_max2 = support_z[i];
-		double z_min2 = (i == 0) ? 0 : support_z[i - 1];
+/*
+ *	״֧Žṹbase layers
+ *	contact area·ѡȡϡ֧ŵ㣬ÿ֧ŵΪһϸСbranch
+ *	branchĹڵbranch£֮ϲͬʱ𽥱֣
+ *	objectʱֹ֧ͣobjectϣÿbase areaֻЩbranchԲν棬
+ *	contact areaµͶӰ
+ */
+void SupportMaterial::GenerateTreeLayers(PrintObject& object, const std::vector<double>& support_z,
+	const std::vector<Polygons>& contact_layers, std::vector<Polygons>& base_layers) {
+	int layers_count = support_z.size();
+	if (layers_count == 0) {
+		return;
+	}
+
+	//branchĲ
+	coord_t tip_radius = 1.5 * flow_->scaled_width();
+	coord_t max_radius = 4 * tip_radius;
+	double radius_growth = 0.1;		//ÿ1mm, 뾶0.1mm
+	double branch_slope = tan(Geometry::deg2rad(40.0));		//branchֱнΪ40
+	coord_t tip_spacing = 2 * scale_(object_config_->support_material_spacing + flow_->spacing());
+	coord_t attract_distance = 2 * tip_spacing;
+
+	//contact layer֧ŵ㻥أеؼ
+	std::vector<Points> tips(layers_count);
+	parallel_for(1, layers_count,
+		[&](int i) {
+			if (!contact_layers[i].empty()) {
+				tips[i] = TreeTips(contact_layers[i], tip_spacing, tip_radius);
+			}
+		},
+		1
+	);
+	object.print()->ThrowIfCanceled();
+
+	//϶µbranches, ¼ÿһϵн
+	std::vector<std::vector<TreeNode>> layer_nodes(layers_count);
+	std::vector<TreeNode> nodes;
+	for (int i = layers_count - 1; i >= 0; i--) {
+		if (!nodes.empty()) {
+			double height = support_z[i + 1] - support_z[i];
+			double step = scale_(height) * branch_slope;
+
+			Points positions;
+			for (TreeNode& node : nodes) {
+				positions.push_back(node.position);
+			}
+			TreeNodeGrid grid(positions, attract_distance);
+
+			//ÿڵattract_distanceΧĽڵƶһԽڵ˴ʱе
+			Points moved(nodes.size());
+			parallel_for(0, int(nodes.size()),
+				[&](int k) {
+					int nearest = -1;
+					double nearest_distance = attract_distance;
+					grid.ForEachNear(positions[k], [&](int j) {
+						double distance = positions[k].distance_to(positions[j]);
+						if (j != k && (distance < nearest_distance || (distance == nearest_distance && j < nearest))) {
+							nearest = j;
+							nearest_distance = distance;
+						}
+					});
+					moved[k] = positions[k];
+					if (nearest >= 0 && nearest_distance > 0) {
+						double move = std::min(step, nearest_distance / 2) / nearest_distance;
+						moved[k].translate(coord_t((positions[nearest].x - positions[k].x) * move),
+							coord_t((positions[nearest].y - positions[k].y) * move));
+					}
+				}
+			);
+
+			//뵱ǰobjectཻĽڵ㱣ԭλԭλҲobjectֹཻͣ
+			BoundingBox nodes_bbox(moved);
+			nodes_bbox.merge(BoundingBox(positions));
+			std::vector<bool> moved_blocked(nodes.size(), false);
+			std::vector<bool> blocked(nodes.size(), false);
+			double z_min = (i == 0) ? 0 : support_z[i - 1];
+			for (int object_layer_id : object_intervals_.overlapping(z_min, support_z[i])) {
+				for (ExPolygon& expolygon : object.layers[object_layer_id]->slices.expolygons) {
+					if (!nodes_bbox.overlap(expolygon.contour.bounding_box())) {
+						continue;
+					}
+					std::vector<bool> moved_inside = expolygon.contains(moved);
+					std::vector<bool> inside = expolygon.contains(positions);
+					for (int k = 0; k < int(nodes.size()); k++) {
+						moved_blocked[k] = moved_blocked[k] || moved_inside[k];
+						blocked[k] = blocked[k] || inside[k];
+					}
+				}
+			}
+
+			//ϲĽڵ
+			TreeNodeGrid moved_grid(moved, attract_distance);
+			std::vector<bool> merged(nodes.size(), false);
+			std::vector<TreeNode> next_nodes;
+			for (int k = 0; k < int(nodes.size()); k++) {
+				if (merged[k]) {
+					continue;
+				}
+				if (moved_blocked[k]) {
+					if (!blocked[k]) {
+						next_nodes.push_back(nodes[k]);
+					}
+					continue;
+				}
+				TreeNode node = { moved[k], nodes[k].radius };
+				moved_grid.ForEachNear(moved[k], [&](int j) {
+					if (j > k && !merged[j] && !moved_blocked[j] && moved[k].distance_to(moved[j]) <= tip_radius) {
+						merged[j] = true;
+						node.radius = std::max(node.radius, nodes[j].radius);
+					}
+				});
+				node.radius = std::min(max_radius, coord_t(node.radius + radius_growth * scale_(height)));
+				next_nodes.push_back(node);
+			}
+			std::swap(nodes, next_nodes);
+		}
 
-		if (z_max > z_min2 && z_min < z_max2) {
-			res.push_back(i);
+		//upper layercontact area·µbranches
+		if (i + 1 < layers_count) {
+			for (Point& tip : tips[i + 1]) {
+				TreeNode node = { tip, tip_radius };
+				nodes.push_back(node);
+			}
+		}
+		layer_nodes[i] = nodes;
+	}
+	object.print()->ThrowIfCanceled();
+
+	//unionأеؼ
+	Polygon circle = TreeCircle(tip_radius);
+	parallel_for(0, layers_count,
+		[&](int i) {
+			Polygons circles;
+			for (TreeNode& node : layer_nodes[i]) {
+				Polygon node_circle = (node.radius == tip_radius) ? circle : TreeCircle(node.radius);
+				node_circle.translate(node.position);
+				circles.push_back(node_circle);
+			}
+			base_layers[i] = union_(circles);
+		},
+		1
+	);
+
+	//raft layersҪظbranchesĵײ
+	int raft_layers = object_config_->raft_layers;
+	if (raft_layers > 0 && raft_layers < layers_count) {
+		Polygons raft = offset(base_layers[raft_layers], scale_(SUPPORT_MATERIAL_MARGIN));
+		for (int i = 0; i < raft_layers; i++) {
+			base_layers[i] = raft;
 		}
 	}
-	return res;
+}
+
 
+void SupportMaterial::ClipWithShape(std::vector<Polygons>& support_layers, const std::vector<Polygons>& shape_map) {
+	parallel_for(0, int(support_layers.size()),
+		[&](int layer_id) {
+			//Ҫclip bottom layersӶcontinuous base flangeҲclip raft layers
+			if (layer_id == 0 || layer_id < object_config_->raft_layers || support_layers[layer_id].empty()) {
+				return;
+			}
+			support_layers[layer_id] = intersection(support_layers[layer_id], shape_map[layer_id]);
+		},
+		1
+	);
+
+}
+
+/*
+ *	layerغϵlayer
+ */
+std::vector<int> SupportMaterial::OverlappingLayers(int index) {
+	return support_intervals_.overlapping(index);
 }
 
 
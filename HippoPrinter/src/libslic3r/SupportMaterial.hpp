@@ -4,6 +4,7 @@
 #include <src/libslic3r/PrintConfig.hpp>
 #include <src/libslic3r/Flow.hpp>
 #include <src/libslic3r/Print.hpp>
+#include <src/libslic3r/LayerIntervals.hpp>
 #include <boost/thread.hpp>
 
 
@@ -23,6 +24,9 @@ public:
 	void ContactArea(PrintObject& object, std::map<double, Polygons>& contact_map,
 		std::map<double, Polygons>& overhang_map);
 
+	bool LayerContactArea(PrintObject& object, int layer_id, const Polygons& buildplate_only_top_surfaces,
+		Polygons& contact, Polygons& overhang, coordf_t& contact_z);
+
 	void ObjectTop(PrintObject& object, std::map<double, Polygons>& contact_map,
 		std::map<coordf_t, Polygons>& top_map);
 
@@ -30,32 +34,38 @@ public:
 		std::vector<double>& top_z, double max_object_layer_height,
 		std::vector<double>& z_vec);
 
-	void GenerateInterfaceLayers(std::vector<double>& support_z, std::map<double, Polygons>& contact_map,
-		std::map<double, Polygons>& top_map, std::map<int, Polygons>& interface_map);
+	//以下各函数中的std::vector<Polygons>均以support layer id为索引
+	void GenerateInterfaceLayers(const std::vector<double>& support_z, const std::vector<Polygons>& contact_layers,
+		const std::vector<Polygons>& top_layers, std::vector<Polygons>& interface_layers);
+
+	void GenerateBottomInterfacesLayers(const std::vector<double>& support_z, std::vector<Polygons>& base_layers,
+		const std::map<double, Polygons>& top_map, std::vector<Polygons>& interface_layers);
 
-	void GenerateBottomInterfacesLayers(std::vector<double>& support_z, std::map<int, Polygons>& base_map,
-		std::map<double, Polygons>& top_map, std::map<int, Polygons>& interface_map);
+	void GenerateBaseLayers(const std::vector<double>& support_z, const std::vector<Polygons>& contact_layers,
+		const std::vector<Polygons>& top_layers, const std::vector<Polygons>& interface_layers,
+		std::vector<Polygons>& base_layers);
 
-	void GenerateBaseLayers(std::vector<double>& support_z, 
-		std::map<double, Polygons>& contact_map,std::map<double, Polygons>& top_map,
-		std::map<int, Polygons>& interface_map, std::map<int, Polygons>& base_map);
+	void ClipWithObject(PrintObject& object, std::vector<Polygons>& support_layers,
+		const std::vector<double>& support_z);
 
-	void ClipWithObject(PrintObject& object, std::map<int, Polygons>& interface_map,
-		std::vector<double>& support_z);
+	void GenerateToolPaths(PrintObject& object, const std::vector<Polygons>& overhang_layers,
+		const std::vector<Polygons>& contact_layers, const std::vector<Polygons>& interface_layers,
+		const std::vector<Polygons>& base_layers);
 
-	void GenerateToolPaths(PrintObject& object, std::map<double, Polygons>& overhang_map,
-		std::map<double, Polygons>& contact_map, std::map<int, Polygons>& interface_map, 
-		std::map<int, Polygons>& base_map);
+	void ProcessLayer(PrintObject& object, int layer_id, const std::vector<Polygons>& overhang_layers,
+		const std::vector<Polygons>& contact_layers, const std::vector<Polygons>& interface_layers,
+		const std::vector<Polygons>& base_layers);
 
-	void ProcessLayer(PrintObject& object, int layer_id, std::map<double, Polygons>& overhang_map,
-		std::map<double, Polygons>& contact_map, std::map<int, Polygons>& interface_map, 
-		std::map<int, Polygons>& base_map);
+	void GeneratePillarsShape(std::map<double, Polygons>& contact_map, const std::vector<double>& support_z,
+		std::vector<Polygons>& shape_map);
 
-	void GeneratePillarsShape(std::map<double, Polygons>& contact_map, std::vector<double> support_z,
-		std::map<int, Polygons>& shape_map);
+	void GenerateTreeLayers(PrintObject& object, const std::vector<double>& support_z,
+		const std::vector<Polygons>& contact_layers, std::vector<Polygons>& base_layers);
 
-	void ClipWithShape(std::map<int, Polygons>& support, std::map<int, Polygons>& shape_map);
-	std::vector<int> OverlappingLayers(int i, const std::vector<double>&);
+	Points TreeTips(const Polygons& contact_polygons, coord_t spacing, coord_t tip_radius);
+
+	void ClipWithShape(std::vector<Polygons>& support_layers, const std::vector<Polygons>& shape_map);
+	std::vector<int> OverlappingLayers(int i);
 
 	double ContactDistance(double layer_height, double nozzle_diamter);
 
@@ -67,6 +77,9 @@ public:
 	Flow* flow_;
 	Flow* first_layer_flow_;
 	Flow* interface_flow_;
+
+	LayerIntervals support_intervals_;	//support layers的z区间
+	LayerIntervals object_intervals_;	//object layers的z区间
 };
 
 }
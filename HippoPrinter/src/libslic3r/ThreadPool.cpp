@@ -0,0 +1,200 @@
+#include "ThreadPool.hpp"
+
+namespace Slic3r {
+
+// index of the pool worker running on this thread, -1 for the external threads
+static thread_local int worker_idx = -1;
+
+ThreadPool&
+ThreadPool::instance()
+{
+	static ThreadPool pool(std::max(1u, boost::thread::hardware_concurrency()));
+	return pool;
+}
+
+ThreadPool::ThreadPool(size_t threads)
+:   _workers_count(0),
+	_queued(0),
+	_stopping(false)
+{
+	this->_start(threads);
+}
+
+ThreadPool::~ThreadPool()
+{
+	this->_stop();
+}
+
+void
+ThreadPool::resize(size_t threads)
+{
+	if (threads == 0) threads = std::max(1u, boost::thread::hardware_concurrency());
+	if (threads == this->_workers_count) return;
+	this->_stop();
+	this->_start(threads);
+}
+
+void
+ThreadPool::_start(size_t threads)
+{
+	this->_stopping = false;
+	this->_workers_count = threads;
+	for (size_t i = 0; i <= threads; ++i)
+		this->_queues.push_back(new WorkQueue());
+	for (size_t i = 0; i < threads; ++i)
+		this->_workers.push_back(new boost::thread(boost::bind(&ThreadPool::_worker, this, i)));
+}
+
+void
+ThreadPool::_stop()
+{
+	{
+		boost::lock_guard<boost::mutex> l(this->_sleep_mutex);
+		this->_stopping = true;
+	}
+	this->_sleep_cond.notify_all();
+	for (boost::thread* worker : this->_workers) {
+		worker->join();
+		delete worker;
+	}
+	this->_workers.clear();
+	for (WorkQueue* queue : this->_queues)
+		delete queue;
+	this->_queues.clear();
+	this->_workers_count = 0;
+}
+
+void
+ThreadPool::_push(TaskGroup* group, const boost::function<void()> &func)
+{
+	++ group->_pending;
+	// counted before it becomes visible, so that _queued never underflows
+	++ this->_queued;
+	{
+		WorkQueue &queue = *this->_queues[(worker_idx >= 0) ? worker_idx : this->_workers_count];
+		Task task;
+		task.group = group;
+		task.func  = func;
+		boost::lock_guard<boost::mutex> l(queue.mutex);
+		queue.tasks.push_back(task);
+	}
+	// taking the lock orders this push before the sleeping threads re-check _queued
+	{
+		boost::lock_guard<boost::mutex> l(this->_sleep_mutex);
+	}
+	this->_sleep_cond.notify_one();
+}
+
+bool
+ThreadPool::_pop(Task* task)
+{
+	if (this->_queued == 0) return false;
+
+	// own queue first, newest task first
+	if (worker_idx >= 0) {
+		WorkQueue &queue = *this->_queues[worker_idx];
+		boost::lock_guard<boost::mutex> l(queue.mutex);
+		if (!queue.tasks.empty()) {
+			*task = queue.tasks.back();
+			queue.tasks.pop_back();
+			-- this->_queued;
+			return true;
+		}
+	}
+	// then the injection queue and the other workers, oldest task first
+	const size_t n = this->_queues.size();
+	const size_t first = (worker_idx >= 0) ? size_t(worker_idx) + 1 : 0;
+	for (size_t i = 0; i < n; ++i) {
+		const size_t idx = (first + i) % n;
+		if (int(idx) == worker_idx) continue;
+		WorkQueue &queue = *this->_queues[idx];
+		boost::lock_guard<boost::mutex> l(queue.mutex);
+		if (!queue.tasks.empty()) {
+			*task = queue.tasks.front();
+			queue.tasks.pop_front();
+			-- this->_queued;
+			return true;
+		}
+	}
+	return false;
+}
+
+void
+ThreadPool::_execute(Task &task)
+{
+	TaskGroup* group = task.group;
+	try {
+		task.func();
+	} catch (...) {
+		boost::lock_guard<boost::mutex> l(group->_exception_mutex);
+		if (!group->_exception)
+			group->_exception = std::current_exception();
+	}
+	// release the functor before the group may be destroyed by its waiter
+	task.func.clear();
+	if (-- group->_pending == 0) {
+		// the group must not be touched anymore, wake up its waiter
+		{
+			boost::lock_guard<boost::mutex> l(this->_sleep_mutex);
+		}
+		this->_sleep_cond.notify_all();
+	}
+}
+
+void
+ThreadPool::_worker(size_t idx)
+{
+	worker_idx = int(idx);
+	Task task;
+	while (true) {
+		if (this->_pop(&task)) {
+			this->_execute(task);
+			continue;
+		}
+		boost::unique_lock<boost::mutex> lock(this->_sleep_mutex);
+		while (!this->_stopping && this->_queued == 0)
+			this->_sleep_cond.wait(lock);
+		if (this->_stopping) return;
+	}
+}
+
+TaskGroup::~TaskGroup()
+{
+	// never leave tasks behind referencing this group
+	try {
+		this->wait();
+	} catch (...) {
+	}
+}
+
+void
+TaskGroup::run(const boost::function<void()> &func)
+{
+	ThreadPool::instance()._push(this, func);
+}
+
+void
+TaskGroup::wait()
+{
+	ThreadPool &pool = ThreadPool::instance();
+	ThreadPool::Task task;
+	while (this->_pending > 0) {
+		// help with the queued tasks instead of just blocking, this keeps nested
+		// groups from deadlocking the bounded pool
+		if (pool._pop(&task)) {
+			pool._execute(task);
+			continue;
+		}
+		boost::unique_lock<boost::mutex> lock(pool._sleep_mutex);
+		while (this->_pending > 0 && pool._queued == 0)
+			pool._sleep_cond.wait(lock);
+	}
+	boost::lock_guard<boost::mutex> l(this->_exception_mutex);
+	if (this->_exception) {
+		std::exception_ptr exception = this->_exception;
+		this->_exception = std::exception_ptr();
+		std::rethrow_exception(exception);
+	}
+}
+
+}
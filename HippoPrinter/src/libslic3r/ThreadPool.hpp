@@ -0,0 +1,141 @@
+#ifndef slic3r_ThreadPool_hpp_
+#define slic3r_ThreadPool_hpp_
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+namespace Slic3r {
+
+class TaskGroup;
+
+// Persistent, process-wide pool of worker threads shared by all the parallel stages
+// of the slicing pipeline: the object level tasks of Print::Process() as well as the
+// per-layer and per-facet parallel_for() loops issued from inside them.
+//
+// Every worker owns a task deque. Tasks spawned by a worker are pushed to and popped
+// from the back of its own deque (LIFO, cache friendly), idle workers steal from the
+// front of the other deques (FIFO, so they pick the largest pieces of a split range).
+// Threads not belonging to the pool submit their tasks to a shared injection queue.
+class ThreadPool
+{
+	public:
+	static ThreadPool& instance();
+	size_t size() const { return this->_workers_count; }
+	// Changes the number of worker threads.
+	// Must not be called while there are tasks running on the pool.
+	void resize(size_t threads);
+
+	private:
+	friend class TaskGroup;
+	struct Task {
+		TaskGroup* group;
+		boost::function<void()> func;
+	};
+	struct WorkQueue {
+		boost::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	ThreadPool(size_t threads);
+	~ThreadPool();
+	void _start(size_t threads);
+	void _stop();
+	void _push(TaskGroup* group, const boost::function<void()> &func);
+	// Takes a task from the own queue, then from the injection queue, then steals
+	// from the other workers. Returns false if all the queues are empty.
+	bool _pop(Task* task);
+	void _execute(Task &task);
+	void _worker(size_t idx);
+
+	size_t _workers_count;
+	// one queue per worker, followed by the injection queue of the external threads
+	std::vector<WorkQueue*> _queues;
+	std::vector<boost::thread*> _workers;
+	// number of tasks waiting in any of the queues
+	std::atomic<size_t> _queued;
+	bool _stopping;
+	// idle threads sleep here until a task is queued or a group is finished
+	boost::mutex _sleep_mutex;
+	boost::condition_variable _sleep_cond;
+};
+
+// A set of tasks submitted to the ThreadPool and waited for together.
+// wait() keeps executing queued tasks instead of blocking, therefore a task may
+// itself run a nested TaskGroup (or parallel_for) and wait for it without
+// starving the pool.
+class TaskGroup
+{
+	public:
+	TaskGroup() : _pending(0) {};
+	~TaskGroup();
+	void run(const boost::function<void()> &func);
+	// Blocks until all the tasks of this group are finished.
+	// Rethrows the first exception thrown by any of the tasks.
+	void wait();
+
+	private:
+	friend class ThreadPool;
+	std::atomic<size_t> _pending;
+	boost::mutex _exception_mutex;
+	std::exception_ptr _exception;
+};
+
+template <class Index, class Func>
+void
+_parallel_for_split(TaskGroup &group, Index begin, Index end, size_t grain, const Func &func)
+{
+	// Keep the lower half for this thread and offer the upper half to the other
+	// workers, until the range is small enough to be processed in one go.
+	while (size_t(end - begin) > grain) {
+		Index middle = begin + Index((end - begin) / 2);
+		group.run([&group, middle, end, grain, &func]() {
+			_parallel_for_split(group, middle, end, grain, func);
+		});
+		end = middle;
+	}
+	func(begin, end);
+}
+
+// Calls func(chunk_begin, chunk_end) on sub-ranges of [begin, end) holding at most
+// grain items each. The sub-ranges are processed in parallel on the ThreadPool.
+// With grain == 0 the chunk size is chosen so that every worker gets a few chunks.
+// Exceptions thrown by func are rethrown to the caller once all chunks are finished.
+template <class Index, class Func>
+void
+parallel_for_chunks(Index begin, Index end, const Func &func, size_t grain = 0)
+{
+	if (end <= begin) return;
+	size_t count = size_t(end - begin);
+	if (grain == 0)
+		grain = std::max<size_t>(1, count / (4 * (ThreadPool::instance().size() + 1)));
+	if (count <= grain) {
+		func(begin, end);
+		return;
+	}
+	// If the chunk processed by this thread throws, ~TaskGroup() still waits
+	// for the already spawned chunks before the exception leaves this scope.
+	TaskGroup group;
+	_parallel_for_split(group, begin, end, grain, func);
+	group.wait();
+}
+
+// Calls func(i) for every i in [begin, end), in parallel on the ThreadPool.
+// See parallel_for_chunks() for the meaning of grain.
+template <class Index, class Func>
+void
+parallel_for(Index begin, Index end, const Func &func, size_t grain = 0)
+{
+	parallel_for_chunks(begin, end, [&func](Index chunk_begin, Index chunk_end) {
+		for (Index i = chunk_begin; i < chunk_end; ++ i)
+			func(i);
+	}, grain);
+}
+
+}
+
+#endif
@@ -19,6 +19,12 @@
 #include "SVG.hpp"
 #endif
 
+// SSE2 is part of the x86-64 baseline, so it needs no runtime detection
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SLIC3R_SLICE_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace Slic3r {
 
 TriangleMesh::TriangleMesh()
@@ -750,61 +756,155 @@ TriangleMeshSlicer<A>::slice(const std::vector<float> &z, std::vector<Polygons>*
 		type is float.
 	*/
 	
+	// Every range of layers is swept by a single thread writing only to its own
+	// layers, so no locking is needed. The lines of a layer always come in the
+	// order of the sorted facets, independently of the split of the layer ranges.
 	std::vector<IntersectionLines> lines(z.size());
-	{
-		boost::mutex lines_mutex;
-		parallelize<int>(
-			0,
-			this->mesh->stl.stats.number_of_facets-1,
-			boost::bind(&TriangleMeshSlicer<A>::_slice_do, this, _1, &lines, &lines_mutex, z)
-		);
-	}
+	parallel_for_chunks(size_t(0), z.size(),
+		[this, &z, &lines](size_t layer_begin, size_t layer_end) {
+			this->_slice_do(z, layer_begin, layer_end, &lines);
+		}
+	);
 	
 	// v_scaled_shared could be freed here
 	
 	// build loops
 	layers->resize(z.size());
-	parallelize<size_t>(
-		0,
-		lines.size()-1,
-		boost::bind(&TriangleMeshSlicer<A>::_make_loops_do, this, _1, &lines, layers)
+	parallel_for(size_t(0), lines.size(),
+		[this, &lines, layers](size_t layer_idx) {
+			this->_make_loops_do(layer_idx, &lines, layers);
+		},
+		1
 	);
 }
 
 template <Axis A>
 void
-TriangleMeshSlicer<A>::_slice_do(size_t facet_idx, std::vector<IntersectionLines>* lines, boost::mutex* lines_mutex, 
-	const std::vector<float> &z) const
+TriangleMeshSlicer<A>::_slice_do(const std::vector<float> &z, size_t layer_begin, size_t layer_end,
+	std::vector<IntersectionLines>* lines) const
 {
-	const stl_facet &facet = this->mesh->stl.facet_start[facet_idx];
-	
-	// find facet extents
-	const float min_z = fminf(_z(facet.vertex[0]), fminf(_z(facet.vertex[1]), _z(facet.vertex[2])));
-	const float max_z = fmaxf(_z(facet.vertex[0]), fmaxf(_z(facet.vertex[1]), _z(facet.vertex[2])));
-	
-	#ifdef SLIC3R_DEBUG
-	printf("\n==> FACET %zu (%f,%f,%f - %f,%f,%f - %f,%f,%f):\n", facet_idx,
-		_x(facet.vertex[0]), _y(facet.vertex[0]), _z(facet.vertex[0]),
-		_x(facet.vertex[1]), _y(facet.vertex[1]), _z(facet.vertex[1]),
-		_x(facet.vertex[2]), _y(facet.vertex[2]), _z(facet.vertex[2]));
-	printf("z: min = %.2f, max = %.2f\n", min_z, max_z);
-	#endif
-	
-	// find layer extents
-	std::vector<float>::const_iterator min_layer, max_layer;
-	min_layer = std::lower_bound(z.begin(), z.end(), min_z); // first layer whose slice_z is >= min_z
-	//max_layer = std::upper_bound(z.begin() + (min_layer - z.begin()), z.end(), max_z) - 1; // last layer whose slice_z is <= max_z
-	max_layer = std::upper_bound(min_layer, z.end(), max_z);
-	if (max_layer == z.end() || max_layer <= min_layer)
-		return;
-	--max_layer;
-	#ifdef SLIC3R_DEBUG
-	printf("layers: min = %d, max = %d\n", (int)(min_layer - z.begin()), (int)(max_layer - z.begin()));
-	#endif
+	// facets crossing the current plane, kept in the order of facets_z
+	std::vector<const FacetZSpan*> active;
+	typename std::vector<FacetZSpan>::const_iterator next = this->facets_z.begin();
 	
-	for (std::vector<float>::const_iterator it = min_layer; it != max_layer + 1; ++it) {
-		std::vector<float>::size_type layer_idx = it - z.begin();
-		this->slice_facet(*it / SCALING_FACTOR, facet, facet_idx, min_z, max_z, &(*lines)[layer_idx], lines_mutex);
+	for (size_t layer_idx = layer_begin; layer_idx < layer_end; ++layer_idx) {
+		const float slice_z = z[layer_idx];
+		
+		// drop the facets lying below the plane and add the ones reaching it
+		active.erase(std::remove_if(active.begin(), active.end(),
+			[slice_z](const FacetZSpan* span) { return span->max_z < slice_z; }), active.end());
+		for (; next != this->facets_z.end() && next->min_z <= slice_z; ++next)
+			if (next->max_z >= slice_z)
+				active.push_back(&*next);
+		
+		#ifdef SLIC3R_DEBUG
+		printf("\n==> LAYER %zu (z = %f): %zu facets\n", layer_idx, slice_z, active.size());
+		#endif
+		
+		IntersectionLines &layer_lines = (*lines)[layer_idx];
+		layer_lines.reserve(active.size());
+		this->_slice_facets(active, slice_z / SCALING_FACTOR, &layer_lines);
+	}
+}
+
+// Intersects the three edges of four facets with the plane at slice_z.
+// Arrays are indexed [vertex][lane], edge k going from vertex k to vertex k+1.
+// The operations are the ones of slice_facet(), in the same order, so the
+// results are bit-identical to the scalar ones. The values computed for the
+// edges not crossing the plane are meaningless.
+static inline void
+intersect_edges4(const float x[3][4], const float y[3][4], const float z[3][4], float slice_z,
+	float ex[3][4], float ey[3][4])
+{
+	for (int k = 0; k < 3; ++k) {
+		const int l = (k + 1) % 3;
+		#ifdef SLIC3R_SLICE_SSE2
+		const __m128 xb = _mm_loadu_ps(x[l]);
+		const __m128 yb = _mm_loadu_ps(y[l]);
+		const __m128 zb = _mm_loadu_ps(z[l]);
+		const __m128 dz = _mm_sub_ps(_mm_loadu_ps(z[k]), zb);
+		const __m128 t  = _mm_sub_ps(_mm_set1_ps(slice_z), zb);
+		_mm_storeu_ps(ex[k], _mm_add_ps(xb, _mm_div_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(x[k]), xb), t), dz)));
+		_mm_storeu_ps(ey[k], _mm_add_ps(yb, _mm_div_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(y[k]), yb), t), dz)));
+		#else
+		for (int lane = 0; lane < 4; ++lane) {
+			ex[k][lane] = x[l][lane] + (x[k][lane] - x[l][lane]) * (slice_z - z[l][lane]) / (z[k][lane] - z[l][lane]);
+			ey[k][lane] = y[l][lane] + (y[k][lane] - y[l][lane]) * (slice_z - z[l][lane]) / (z[k][lane] - z[l][lane]);
+		}
+		#endif
+	}
+}
+
+template <Axis A>
+void
+TriangleMeshSlicer<A>::_slice_facets(const std::vector<const FacetZSpan*> &facets, float slice_z,
+	std::vector<IntersectionLine>* lines) const
+{
+	/*  The facets are processed in batches of four. Their vertices are gathered
+		from the SoA copy in the order slice_facet() walks them. The facets having
+		a vertex on the plane take the generic slice_facet() path, all the others
+		cross the plane on two edges (or not at all) and are handled by the vector
+		kernel. The lines are appended in the order of the facets.  */
+	float x[3][4], y[3][4], z[3][4], ex[3][4], ey[3][4];
+	int edge_ids[3][4];
+	bool on_plane[4];
+	for (size_t first = 0; first < facets.size(); first += 4) {
+		const size_t count = std::min<size_t>(4, facets.size() - first);
+		for (size_t lane = 0; lane < 4; ++lane) {
+			if (lane >= count) {
+				for (int k = 0; k < 3; ++k)
+					x[k][lane] = y[k][lane] = z[k][lane] = 0;
+				continue;
+			}
+			const FacetZSpan &span = *facets[first + lane];
+			const stl_facet &facet = this->mesh->stl.facet_start[span.facet_idx];
+			
+			// start from the vertex with lowest Z, like slice_facet() does
+			int i = 0;
+			if (_z(facet.vertex[1]) == span.min_z) {
+				i = 1;
+			} else if (_z(facet.vertex[2]) == span.min_z) {
+				i = 2;
+			}
+			on_plane[lane] = false;
+			for (int k = 0; k < 3; ++k) {
+				const int v_id = this->mesh->stl.v_indices[span.facet_idx].vertex[(i + k) % 3];
+				x[k][lane] = this->v_scaled_x[v_id];
+				y[k][lane] = this->v_scaled_y[v_id];
+				z[k][lane] = this->v_scaled_z[v_id];
+				edge_ids[k][lane] = this->facets_edges[span.facet_idx][(i + k) % 3];
+				if (z[k][lane] == slice_z) on_plane[lane] = true;
+			}
+		}
+		
+		intersect_edges4(x, y, z, slice_z, ex, ey);
+		
+		for (size_t lane = 0; lane < count; ++lane) {
+			const FacetZSpan &span = *facets[first + lane];
+			if (on_plane[lane]) {
+				this->slice_facet(slice_z, this->mesh->stl.facet_start[span.facet_idx], span.facet_idx,
+					span.min_z, span.max_z, lines);
+				continue;
+			}
+			int crossing[3];
+			int crossing_count = 0;
+			for (int k = 0; k < 3; ++k) {
+				const float za = z[k][lane];
+				const float zb = z[(k + 1) % 3][lane];
+				if ((za < slice_z && zb > slice_z) || (zb < slice_z && za > slice_z))
+					crossing[crossing_count++] = k;
+			}
+			assert(crossing_count == 0 || crossing_count == 2); // facets must intersect each plane 0 or 2 times
+			if (crossing_count < 2) continue;
+			IntersectionLine line;
+			line.a.x        = ex[crossing[1]][lane];
+			line.a.y        = ey[crossing[1]][lane];
+			line.b.x        = ex[crossing[0]][lane];
+			line.b.y        = ey[crossing[0]][lane];
+			line.edge_a_id  = edge_ids[crossing[1]][lane];
+			line.edge_b_id  = edge_ids[crossing[0]][lane];
+			lines->push_back(line);
+		}
 	}
 }
 
@@ -840,11 +940,12 @@ TriangleMeshSlicer<A>::slice(float z, ExPolygons* slices) const
 template <Axis A>
 void
 TriangleMeshSlicer<A>::slice_facet(float slice_z, const stl_facet &facet, const int &facet_idx,
-	const float &min_z, const float &max_z, std::vector<IntersectionLine>* lines,
-	boost::mutex* lines_mutex) const
+	const float &min_z, const float &max_z, std::vector<IntersectionLine>* lines) const
 {
-	std::vector<IntersectionPoint> points;
-	std::vector< std::vector<IntersectionPoint>::size_type > points_on_layer;
+	// a facet has three edges, so there are at most three points
+	IntersectionPoint points[3];
+	size_t points_on_layer[3];
+	size_t points_count = 0, points_on_layer_count = 0;
 	bool found_horizontal_edge = false;
 	
 	/* reorder vertices so that the first one is the one with lowest Z
@@ -893,12 +994,7 @@ TriangleMeshSlicer<A>::slice_facet(float slice_z, const stl_facet &facet, const
 			line.b.y    = _y(*b);
 			line.a_id   = a_id;
 			line.b_id   = b_id;
-			if (lines_mutex != NULL) {
-				boost::lock_guard<boost::mutex> l(*lines_mutex);
-				lines->push_back(line);
-			} else {
-				lines->push_back(line);
-			}
+			lines->push_back(line);
 			
 			found_horizontal_edge = true;
 			
@@ -911,15 +1007,15 @@ TriangleMeshSlicer<A>::slice_facet(float slice_z, const stl_facet &facet, const
 			point.x         = _x(*a);
 			point.y         = _y(*a);
 			point.point_id  = a_id;
-			points.push_back(point);
-			points_on_layer.push_back(points.size()-1);
+			points_on_layer[points_on_layer_count++] = points_count;
+			points[points_count++] = point;
 		} else if (_z(*b) == slice_z) {
 			IntersectionPoint point;
 			point.x         = _x(*b);
 			point.y         = _y(*b);
 			point.point_id  = b_id;
-			points.push_back(point);
-			points_on_layer.push_back(points.size()-1);
+			points_on_layer[points_on_layer_count++] = points_count;
+			points[points_count++] = point;
 		} else if ((_z(*a) < slice_z && _z(*b) > slice_z) || (_z(*b) < slice_z && _z(*a) > slice_z)) {
 			// edge intersects the current layer; calculate intersection
 			
@@ -927,23 +1023,24 @@ TriangleMeshSlicer<A>::slice_facet(float slice_z, const stl_facet &facet, const
 			point.x         = _x(*b) + (_x(*a) - _x(*b)) * (slice_z - _z(*b)) / (_z(*a) - _z(*b));
 			point.y         = _y(*b) + (_y(*a) - _y(*b)) * (slice_z - _z(*b)) / (_z(*a) - _z(*b));
 			point.edge_id   = edge_id;
-			points.push_back(point);
+			points[points_count++] = point;
 		}
 	}
 	if (found_horizontal_edge) return;
 	
-	if (!points_on_layer.empty()) {
+	if (points_on_layer_count > 0) {
 		// we can't have only one point on layer because each vertex gets detected
 		// twice (once for each edge), and we can't have three points on layer because
 		// we assume this code is not getting called for horizontal facets
-		assert(points_on_layer.size() == 2);
+		assert(points_on_layer_count == 2);
 		assert( points[ points_on_layer[0] ].point_id == points[ points_on_layer[1] ].point_id );
-		if (points.size() < 3) return;  // no intersection point, this is a V-shaped facet tangent to plane
-		points.erase( points.begin() + points_on_layer[1] );
+		if (points_count < 3) return;  // no intersection point, this is a V-shaped facet tangent to plane
+		std::copy(points + points_on_layer[1] + 1, points + points_count, points + points_on_layer[1]);
+		--points_count;
 	}
 	
-	if (!points.empty()) {
-		assert(points.size() == 2); // facets must intersect each plane 0 or 2 times
+	if (points_count > 0) {
+		assert(points_count == 2); // facets must intersect each plane 0 or 2 times
 		IntersectionLine line;
 		line.a          = (Point)points[1];
 		line.b          = (Point)points[0];
@@ -951,12 +1048,7 @@ TriangleMeshSlicer<A>::slice_facet(float slice_z, const stl_facet &facet, const
 		line.b_id       = points[0].point_id;
 		line.edge_a_id  = points[1].edge_id;
 		line.edge_b_id  = points[0].edge_id;
-		if (lines_mutex != NULL) {
-			boost::lock_guard<boost::mutex> l(*lines_mutex);
-			lines->push_back(line);
-		} else {
-			lines->push_back(line);
-		}
+		lines->push_back(line);
 		return;
 	}
 }
@@ -1432,6 +1524,30 @@ TriangleMeshSlicer<A>::TriangleMeshSlicer(TriangleMesh* _mesh) : mesh(_mesh), v_
 		this->v_scaled_shared[i].y /= SCALING_FACTOR;
 		this->v_scaled_shared[i].z /= SCALING_FACTOR;
 	}
+	
+	// structure-of-arrays copy in the slicing frame for _slice_facets()
+	this->v_scaled_x.resize(this->mesh->stl.stats.shared_vertices);
+	this->v_scaled_y.resize(this->mesh->stl.stats.shared_vertices);
+	this->v_scaled_z.resize(this->mesh->stl.stats.shared_vertices);
+	for (int i = 0; i < this->mesh->stl.stats.shared_vertices; i++) {
+		this->v_scaled_x[i] = _x(this->v_scaled_shared[i]);
+		this->v_scaled_y[i] = _y(this->v_scaled_shared[i]);
+		this->v_scaled_z[i] = _z(this->v_scaled_shared[i]);
+	}
+	
+	// Sort the facets by their lowest Z, so that slice() can sweep the layers bottom-up
+	// keeping just the set of the facets crossing the current plane, instead of
+	// searching the Z list for the layer range of every facet. The index is built
+	// once and shared by all the slice() calls.
+	this->facets_z.resize(this->mesh->stl.stats.number_of_facets);
+	for (size_t facet_idx = 0; facet_idx < this->facets_z.size(); ++facet_idx) {
+		stl_facet &facet = this->mesh->stl.facet_start[facet_idx];
+		FacetZSpan &span = this->facets_z[facet_idx];
+		span.facet_idx = int(facet_idx);
+		span.min_z = fminf(_z(facet.vertex[0]), fminf(_z(facet.vertex[1]), _z(facet.vertex[2])));
+		span.max_z = fmaxf(_z(facet.vertex[0]), fmaxf(_z(facet.vertex[1]), _z(facet.vertex[2])));
+	}
+	std::sort(this->facets_z.begin(), this->facets_z.end());
 }
 
 template <Axis A>
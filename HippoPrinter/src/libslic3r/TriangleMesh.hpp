@@ -109,8 +109,7 @@ class TriangleMeshSlicer
     void slice(const std::vector<float> &z, std::vector<ExPolygons>* layers) const;
     void slice(float z, ExPolygons* slices) const;
     void slice_facet(float slice_z, const stl_facet &facet, const int &facet_idx,
-        const float &min_z, const float &max_z, std::vector<IntersectionLine>* lines,
-        boost::mutex* lines_mutex = NULL) const;
+        const float &min_z, const float &max_z, std::vector<IntersectionLine>* lines) const;
     
     void cut(float z, TriangleMesh* upper, TriangleMesh* lower) const;
     
@@ -118,7 +117,23 @@ class TriangleMeshSlicer
     typedef std::vector< std::vector<int> > t_facets_edges;
     t_facets_edges facets_edges;
     stl_vertex* v_scaled_shared;
-    void _slice_do(size_t facet_idx, std::vector<IntersectionLines>* lines, boost::mutex* lines_mutex, const std::vector<float> &z) const;
+    // v_scaled_shared as separate arrays, already mapped through _x(), _y() and _z()
+    std::vector<float> v_scaled_x, v_scaled_y, v_scaled_z;
+    // Z extents of a facet, ordered by the lowest Z
+    struct FacetZSpan {
+        int   facet_idx;
+        float min_z;
+        float max_z;
+        bool operator<(const FacetZSpan &other) const {
+            return this->min_z < other.min_z || (this->min_z == other.min_z && this->facet_idx < other.facet_idx);
+        };
+    };
+    // facets ordered by their lowest Z, built by the constructor
+    std::vector<FacetZSpan> facets_z;
+    void _slice_do(const std::vector<float> &z, size_t layer_begin, size_t layer_end,
+        std::vector<IntersectionLines>* lines) const;
+    void _slice_facets(const std::vector<const FacetZSpan*> &facets, float slice_z,
+        std::vector<IntersectionLine>* lines) const;
     void _make_loops_do(size_t i, std::vector<IntersectionLines>* lines, std::vector<Polygons>* layers) const;
     void make_loops(std::vector<IntersectionLine> &lines, Polygons* loops) const;
     void make_expolygons(const Polygons &loops, ExPolygons* slices) const;
@@ -10,6 +10,8 @@
 #include <vector>
 #include <boost/thread.hpp>
 
+#include "ThreadPool.hpp"
+
 #include <QDebug>
 
 /* Implementation of CONFESS("foo"): */
@@ -40,7 +42,9 @@ namespace Slic3r {
 
 constexpr auto SLIC3R_VERSION = "1.3.0-dev";
 
-typedef long coord_t;
+// 64bit on every platform like ClipperLib::cInt, so that Point shares its layout
+// with ClipperLib::IntPoint and paths are handed to Clipper without a conversion
+typedef long long coord_t;
 typedef double coordf_t;
 
 // Scaling factor for a conversion from coord_t to coordf_t: 10e-6
@@ -76,46 +80,6 @@ inline void append_to(std::vector<T> &dst, const std::vector<T> &src)
 	dst.insert(dst.end(), src.begin(), src.end());
 }
 
-template <class T> void
-_parallelize_do(std::queue<T>* queue, boost::mutex* queue_mutex, boost::function<void(T)> func)
-{
-	//std::cout << "THREAD STARTED: " << boost::this_thread::get_id() << std::endl;
-	while (true) {
-		T i;
-		{
-			boost::lock_guard<boost::mutex> l(*queue_mutex);
-			if (queue->empty()) return;
-			i = queue->front();
-			queue->pop();
-		}
-		//std::cout << "  Thread " << boost::this_thread::get_id() << " processing item " << i << std::endl;
-		func(i);
-		boost::this_thread::interruption_point();
-	}
-}
-
-template <class T> void
-parallelize(std::queue<T> queue, boost::function<void(T)> func,
-	int threads_count = boost::thread::hardware_concurrency())
-{
-	//qDebug() <<"The size of parallel queue is :"<< queue.size();
-	if (threads_count == 0) threads_count = 2;
-	boost::mutex queue_mutex;
-	boost::thread_group workers;
-	for (int i = 0; i < std::min(threads_count, (int)queue.size()); i++)
-		workers.add_thread(new boost::thread(&_parallelize_do<T>, &queue, &queue_mutex, func));
-	workers.join_all();
-}
-
-template <class T> void
-parallelize(T start, T end, boost::function<void(T)> func,
-	int threads_count = boost::thread::hardware_concurrency())
-{
-	std::queue<T> queue;
-	for (T i = start; i <= end; ++i) queue.push(i);
-	parallelize(queue, func, threads_count);
-}
-
 } // namespace Slic3r
 
 using namespace Slic3r;